@@ -57,6 +57,8 @@ static const wchar_t
     *spotify_client_id_opt              = L"SpotifyClientID",
     *spotify_client_secret_opt          = L"SpotifyClientSecret",
     *localhost_service_port_opt         = L"LocalhostServicePort",
+    *http_cache_disk_limit_opt          = L"HttpCacheDiskLimit",
+    *http_cache_memory_limit_opt        = L"HttpCacheMemoryLimit",
     *playback_backend_enabled_opt       = L"PlaybackBackendEnabled",
     *volume_normalisation_enabled_opt   = L"VolumeNormalisationEnabled",
     *playback_autoplay_enabled_opt      = L"PlaybackAutoplayEnabled",
@@ -231,6 +233,13 @@ void settings_context::fire_events()
             _settings.filters.albums_lps, _settings.filters.albums_eps,
             _settings.filters.albums_appears_on, _settings.filters.albums_compilations);
 
+    if (
+        (_settings.http_cache_disk_limit != settings_copy.http_cache_disk_limit) ||
+        (_settings.http_cache_memory_limit != settings_copy.http_cache_memory_limit)
+    )
+        dispatch_event(&config_observer::on_http_cache_limits_changed,
+            get_http_cache_disk_limit(), get_http_cache_memory_limit());
+
     settings_copy = _settings;
 }
 
@@ -380,6 +389,10 @@ void read(const PluginStartupInfo *info)
     _settings.spotify_client_secret = ctx->get_wstr(spotify_client_secret_opt, L"");
     _settings.localhost_service_port = ctx->get_int(localhost_service_port_opt, 5050);
 
+    // http cache
+    _settings.http_cache_disk_limit = ctx->get_int(http_cache_disk_limit_opt, 256);
+    _settings.http_cache_memory_limit = ctx->get_int(http_cache_memory_limit_opt, 32);
+
     // notifications
     _settings.track_changed_notification_enabled = ctx->get_bool(track_changed_notification_enabled_opt, true);
     _settings.is_circled_notification_image = ctx->get_bool(is_circled_notification_image_opt, false);
@@ -448,6 +461,10 @@ void write()
     ctx->set_wstr(spotify_client_secret_opt, _settings.spotify_client_secret);
     ctx->set_int(localhost_service_port_opt, _settings.localhost_service_port);
 
+    // http cache
+    ctx->set_int(http_cache_disk_limit_opt, _settings.http_cache_disk_limit);
+    ctx->set_int(http_cache_memory_limit_opt, _settings.http_cache_memory_limit);
+
     // notifications
     ctx->set_bool(track_changed_notification_enabled_opt, _settings.track_changed_notification_enabled);
     ctx->set_bool(is_circled_notification_image_opt, _settings.is_circled_notification_image);
@@ -525,6 +542,16 @@ int get_localhost_port()
     return _settings.localhost_service_port;
 }
 
+uint64_t get_http_cache_disk_limit()
+{
+    return (uint64_t)std::max(_settings.http_cache_disk_limit, 0) * 1024 * 1024;
+}
+
+size_t get_http_cache_memory_limit()
+{
+    return (size_t)std::max(_settings.http_cache_memory_limit, 0) * 1024 * 1024;
+}
+
 const wstring& get_plugin_launch_folder()
 {
     return _settings.plugin_startup_folder;
@@ -153,6 +153,10 @@ struct settings
     wstring spotify_client_secret;
     int localhost_service_port;
 
+    // http cache budgets, megabytes
+    int http_cache_disk_limit;
+    int http_cache_memory_limit;
+
     // notifications
     bool track_changed_notification_enabled;
     bool is_circled_notification_image;
@@ -203,6 +207,9 @@ struct config_observer: public BaseObserverProtocol
 
     /// @brief The event is called when the albums filtes have been changed
     virtual void on_album_filters_changed(bool lps, bool eps, bool appears_on, bool comp) {}
+
+    /// @brief The event is called when the http cache budgets have been changed, in bytes
+    virtual void on_http_cache_limits_changed(uint64_t disk_limit, size_t memory_limit) {}
 };
 
 class settings_context
@@ -280,6 +287,12 @@ auto get_client_secret() -> string;
 /// @brief Returns the localhost service port, set by user
 auto get_localhost_port() -> int;
 
+/// @brief Returns the disk budget of the http responses cache in bytes
+auto get_http_cache_disk_limit() -> uint64_t;
+
+/// @brief Returns the memory budget of the http responses cache in bytes
+auto get_http_cache_memory_limit() -> size_t;
+
 /// @brief The absolute folder path, containing plugin files
 auto get_plugin_launch_folder() -> const wstring&;
 
@@ -115,6 +115,9 @@ namespace spotifar
         MCfgCredentialsClearBtn,
         MCfgHttpCache,
         MCfgHttpCacheClearBtn,
+        MCfgHttpCacheLimits,
+        MCfgHttpCacheEvicted,
+        MCfgHttpCacheEvictedValue,
         MCfgClearAllCaches,
         MCfgReleases,
         MCfgReleasesSyncStatus,
@@ -18,6 +18,23 @@ using namespace utils;
 
 const string spotify_api_url = "https://api.spotify.com";
 
+/// @brief A maximum number of simultaneously opened connections to the API server,
+/// matches the total amount of the threads performing requests: requests and resyncs
+/// pools, releases crawler and the main one, so the user's requests never wait for a connection
+static const size_t max_connections_per_host = 10;
+
+/// @brief An idle connection is closed after this time; Spotify servers drop
+/// keep-alive connections themselves after some period of inactivity anyway
+static const auto connection_idle_timeout = 60s;
+
+/// @brief Spotify calculates the rate limit in a rolling 30 seconds window for the whole
+/// application, the exact numbers are not published. The pace starts from the moderate
+/// values and adapts itself to the received 429 responses. A part of the budget is reserved
+/// for the user's requests, the background syncs cannot spend it
+static const token_bucket::settings_t
+    global_bucket_settings{ .rate = 10., .capacity = 20., .min_rate = 1., .max_rate = 25., .reserve = 6. },
+    endpoint_bucket_settings{ .rate = 5., .capacity = 10., .min_rate = .5, .max_rate = 15., .reserve = 3. };
+
 // std::random_device rd;                  // get a random seed from hardware
 // std::mt19937 gen(rd());                 // Mersenne Twister PRNG seeded with rd
 // std::bernoulli_distribution d(0.85);    // 50% chance for true, 50% for false
@@ -31,9 +48,14 @@ static auto request_item(R &&requester, api_weak_ptr_t api, std::set<size_t> ign
     if (requester.execute(api))
         return requester.get();
     
-    if (!ignore_errors.contains(requester.get_response()->status))
+    // there is no response, if the request was not even made
+    if (const auto &response = requester.get_response(); !response || !ignore_errors.contains(response->status))
         dispatch_event(&api_requests_observer::on_collection_fetching_failed, get_fetching_error(&requester));
 
+    // the items of the chunks requested well are still shown
+    if constexpr (requires { requester.get_failed_chunks(); })
+        return requester.get();
+
     return {};
 }
 
@@ -56,6 +78,13 @@ static httplib::Result get_rate_limited_response(const utils::clock_t::time_poin
     return res;
 }
 
+static httplib::Result get_cancelled_response()
+{
+    Result res(std::make_unique<Response>(), Error::Success);
+    res->status = http::CancelledByUser_470;
+    return res;
+}
+
 //----------------------------------------------------------------------------------------------
 
 /// @brief Returns an endpoint's name by the given http url. In practise it is the first
@@ -81,9 +110,10 @@ void endpoint_guard::wait(std::function<bool()> predicate)
     }
 }
 
-void endpoint_guard::set_expires_at(const clock_t::time_point &tp)
+void endpoint_guard::on_throttled(const clock_t::duration &retry_after)
 {
-    expires_at = tp;
+    expires_at = clock_t::now() + retry_after;
+    bucket.on_throttled(retry_after);
 }
 
 const utils::clock_t::time_point& endpoint_guard::get_expires_at() const
@@ -95,23 +125,77 @@ endpoint_guard& api::get_endpoint(const string &url)
 {
     const auto &ep_name = get_endpoint_name(url);
 
-    std::mutex m;
-    std::lock_guard guard(m);
+    std::lock_guard guard(guards_access);
 
     // we create a new guard if there is no such exists for the given `ep_name`
-    const auto it = guards.try_emplace(ep_name, ep_name);
+    const auto it = guards.try_emplace(ep_name, ep_name, endpoint_bucket_settings);
     return it.first->second;
 }
 
+bool api::pace_request(endpoint_guard &ep)
+{
+    auto is_cancelled = [this] { return cancel_flag; };
+    auto priority = request_priority_scope::get_current();
+
+    return ep.acquire(is_cancelled, priority) && global_bucket.acquire(is_cancelled, priority);
+}
+
+void api::update_rate_limits(const string &url, const httplib::Result &res)
+{
+    if (!res) return;
+
+    auto &ep = get_endpoint(url);
+
+    if (res->status == TooManyRequests_429)
+    {
+        auto retry_after = 3s; // default retry delay in case it is not present in the headers
+        
+        if (res->has_header("retry-after"))
+            // +1s just in case
+            retry_after = std::chrono::seconds(std::stoi(res->get_header_value("retry-after", 0))) + 1s;
+
+        // in any case we update the endpoint's expiration time, so all the subsequent requests
+        // will not bother API server; the limits are applied to the whole application, so
+        // the global pace is slowed down as well
+        ep.on_throttled(retry_after);
+        global_bucket.on_throttled({});
+
+        auto state = ep.get_bucket_state();
+        log::api->warn("The endpoint \"{}\" is rate limited for {}, the pace is lowered to {:.1f} requests/s",
+            ep.get_name(), utils::format("{:%T}", retry_after), state.rate);
+    }
+    else
+    {
+        ep.on_success();
+        global_bucket.on_success();
+    }
+}
+
 
 //----------------------------------------------------------------------------------------------
-api::api(): requests_pool(5), resyncs_pool(3)
+api::api(): requests_pool(5), resyncs_pool(3), global_bucket(global_bucket_settings)
 {
+    clients = std::make_unique<clients_pool>(max_connections_per_host, connection_idle_timeout,
+        [](httplib::Client &client)
+        {
+            client.set_logger(http_logger);
+            client.set_default_headers({
+                {"Content-Type", "application/json; charset=utf-8"},
+                {"Accept-Encoding", "gzip, deflate"},
+            });
+            // the compressed responses are decoded by the client transparently
+            client.set_decompress(true);
+        });
+
     api_responses_cache = std::make_unique<http_cache>();
+    parsed_objects = std::make_unique<objects_cache>(*api_responses_cache);
+    collections = std::make_unique<collections_registry>(*api_responses_cache);
 }
 
 api::~api()
 {
+    collections.reset();
+    parsed_objects.reset();
     api_responses_cache.reset();
 }
 
@@ -133,11 +217,13 @@ bool api::start()
     std::for_each(caches.begin(), caches.end(), [ctx](auto &c) { c->read(*ctx); });
 
     // initializing http responses cache
+    api_responses_cache->set_limits(config::get_http_cache_disk_limit(), config::get_http_cache_memory_limit());
     api_responses_cache->start();
 
+    utils::events::start_listening<config::config_observer>(this);
+
     // for debugging, marks some endpoints as rate limited from the start of the app
-    // auto it = guards.try_emplace("me", "me");
-    // it.first->second.set_expires_at(utils::clock_t::now() + 60min);
+    // get_endpoint("/v1/me/").on_throttled(60min);
 
     return true;
 }
@@ -153,7 +239,31 @@ void api::shutdown()
     requests_pool.purge();
     resyncs_pool.purge();
 
+    utils::events::stop_listening<config::config_observer>(this);
+
+    auto cache_stats = api_responses_cache->get_stats();
+    log::api->info("Closing http cache, responses {}, evicted {} ({} bytes), bodies unloaded {}",
+        cache_stats.entries, cache_stats.evicted, cache_stats.evicted_size, cache_stats.unloaded);
+
     api_responses_cache->shutdown();
+
+    auto stats = clients->get_stats();
+    log::api->info("Closing API connections, created {}, reused {}, expired {}",
+        stats.created, stats.reused, stats.expired);
+
+    auto inflight_stats = inflight_requests.get_stats();
+    log::api->info("GET requests performed {}, collapsed into in-flight ones {}",
+        inflight_stats.requests, inflight_stats.collapsed);
+
+    auto objects_stats = parsed_objects->get_stats();
+    log::api->info("Parsed objects cache, objects {}, hits {}, misses {}",
+        objects_stats.objects, objects_stats.hits, objects_stats.misses);
+
+    auto collections_stats = collections->get_stats();
+    log::api->info("Collections registry, snapshots {}, hits {}, misses {}",
+        collections_stats.snapshots, collections_stats.hits, collections_stats.misses);
+
+    clients->shutdown();
     
     caches.clear();
 
@@ -168,15 +278,29 @@ void api::shutdown()
     releases.reset();*/
 }
 
+void api::on_http_cache_limits_changed(uint64_t disk_limit, size_t memory_limit)
+{
+    api_responses_cache->set_limits(disk_limit, memory_limit);
+}
+
 void api::tick()
 {
     auto future = resyncs_pool.submit_loop<size_t>(0, caches.size(),
         [&caches = this->caches](const std::size_t idx)
         {
             if (idx < caches.size() && caches[idx])
+            {
+                request_priority_scope scope(caches[idx]->get_resync_priority());
                 caches[idx]->resync();
+            }
         });
     future.get();
+
+    // closing the connections, which have not been used for a while
+    clients->cleanup();
+
+    api_responses_cache->checkpoint_if_needed();
+    api_responses_cache->compact_if_needed();
 }
 
 const playback_cache::data_t& api::get_playback_state(bool force_resync)
@@ -371,7 +495,7 @@ void api::resume_playback(const item_id_t &device_id)
 
 void api::pause_playback(const item_id_t &device_id)
 {
-    requests_pool.detach_task(
+    detach_prioritized_task(requests_pool, request_priority::playback,
         [&cache = *playback, dev_id = std::as_const(device_id), this]
         {
             Params params = {};
@@ -391,7 +515,7 @@ void api::pause_playback(const item_id_t &device_id)
 
 void api::skip_to_next(const item_id_t &device_id)
 {
-    requests_pool.detach_task(
+    detach_prioritized_task(requests_pool, request_priority::playback,
         [this, dev_id = std::as_const(device_id)]
         {
             http::json_body_builder body;
@@ -409,7 +533,7 @@ void api::skip_to_next(const item_id_t &device_id)
 
 void api::skip_to_previous(const item_id_t &device_id)
 {
-    requests_pool.detach_task(
+    detach_prioritized_task(requests_pool, request_priority::playback,
         [this, dev_id = std::as_const(device_id)]
         {
             http::json_body_builder body;
@@ -427,7 +551,7 @@ void api::skip_to_previous(const item_id_t &device_id)
 
 void api::seek_to_position(int position_ms, const item_id_t &device_id)
 {
-    requests_pool.detach_task(
+    detach_prioritized_task(requests_pool, request_priority::playback,
         [
             position_ms, &cache = *playback,
             dev_id = std::as_const(device_id), this
@@ -457,7 +581,7 @@ void api::seek_to_position(int position_ms, const item_id_t &device_id)
 
 void api::toggle_shuffle(bool is_on, const item_id_t &device_id)
 {
-    requests_pool.detach_task(
+    detach_prioritized_task(requests_pool, request_priority::playback,
         [is_on, &cache = *playback, dev_id = std::as_const(device_id), this]
         {
             Params params = {
@@ -480,7 +604,7 @@ void api::toggle_shuffle(bool is_on, const item_id_t &device_id)
 
 void api::set_repeat_state(const string &mode, const item_id_t &device_id)
 {
-    requests_pool.detach_task(
+    detach_prioritized_task(requests_pool, request_priority::playback,
         [mode, &cache = *playback, dev_id = std::as_const(device_id), this]
         {
             Params params = {
@@ -503,7 +627,7 @@ void api::set_repeat_state(const string &mode, const item_id_t &device_id)
 
 void api::set_playback_volume(int volume_percent, const item_id_t &device_id)
 {
-    requests_pool.detach_task(
+    detach_prioritized_task(requests_pool, request_priority::playback,
         [volume_percent, &cache = *playback, dev_id = std::as_const(device_id), this]
         {
             Params params = {
@@ -530,7 +654,7 @@ void api::start_playback_base(const string &body, const item_id_t &device_id)
     if (!device_id.empty())
         params.insert({ "device_id", device_id });
 
-    requests_pool.detach_task(
+    detach_prioritized_task(requests_pool, request_priority::playback,
         [
             this, &cache = *playback, dev_id = std::as_const(device_id),
             request_url = append_query_params("/v1/me/player/play", params), body
@@ -610,7 +734,7 @@ string api::get_lyrics(const track_t &track)
 
     const wstring filename = utils::strip_invalid_filename_chars(utils::format(
         L"{} - {} - {} [{}]",
-        track.get_artist().name, track.album.name, track.name,
+        track.get_artist().name, track.album->name, track.name,
         utils::to_wstring(track.id)));
     
     const std::filesystem::path filepath = utils::format(L"{}\\{}.lrc", cache_folder, filename);
@@ -625,7 +749,7 @@ string api::get_lyrics(const track_t &track)
 
     auto url = httplib::append_query_params("/api/get", {
         { "artist_name", utils::utf8_encode(track.get_artist().name) },
-        { "album_name", utils::utf8_encode(track.album.name) },
+        { "album_name", utils::utf8_encode(track.album->name) },
         { "track_name", utils::utf8_encode(track.name) },
         { "duration", std::to_string(track.duration) },
     });
@@ -676,15 +800,22 @@ string api::get_lyrics(const track_t &track)
     return "";
 }
 
-bool api::is_request_cached(const string &url) const
+bool api::is_request_cached(const string &url, bool allow_stale) const
 {
     string u = http::trim_domain(url);
-    return api_responses_cache->is_cached(u) && api_responses_cache->get(u).is_valid();
+    return api_responses_cache->is_valid(u) || (allow_stale && api_responses_cache->is_cached(u));
 }
 
 bool api::is_endpoint_rate_limited(const string &endpoint_name) const
 {
-    return guards.contains(endpoint_name) && guards.at(endpoint_name).is_rate_limited();
+    std::lock_guard guard(guards_access);
+
+    // the endpoint is either blocked by the server or has exhausted its requests budget
+    // for now, in both cases the background activity should be postponed
+    if (const auto it = guards.find(endpoint_name); it != guards.end())
+        return it->second.is_rate_limited() || it->second.is_exhausted();
+
+    return false;
 }
 
 void api::cancel_pending_requests(bool wait_for_result)
@@ -692,8 +823,12 @@ void api::cancel_pending_requests(bool wait_for_result)
     cancel_flag = true;
 
     // notifying all the threads to checks their statuses
-    for (auto &guard: guards)
-        guard.second.notify_all();
+    {
+        std::lock_guard guard(guards_access);
+        for (auto &[name, ep]: guards)
+            ep.notify_all();
+    }
+    global_bucket.notify_all();
     
     log::api->debug("Cancelling pending API requests, wait for result: {}", wait_for_result);
 
@@ -709,34 +844,74 @@ void api::cancel_pending_requests(bool wait_for_result)
     }
 }
 
-httplib::Result api::get(const string &request_url, clock_t::duration cache_for, bool retry_429)
+httplib::Result api::get(const string &request_url, clock_t::duration cache_for, bool retry_429, bool allow_stale)
 {
-    string cached_etag = "";
     string url = http::trim_domain(request_url);
 
-    if (api_responses_cache->is_cached(url))
+    // we have a cache for the requested url and it is still valid, or the caller is fine
+    // with the expired one, while it is being revalidated in the background
+    if (bool is_valid = api_responses_cache->is_valid(url); is_valid || allow_stale)
     {
-        // we have a cache for the requested url and it is still valid
-        if (const auto &cache = api_responses_cache->get(url))
+        try
         {
-            Result res(std::make_unique<Response>(), Error::Success);
-            res->status = OK_200;
-            res->body = cache.body;
-            return res;
+            // the broken entries, dropped earlier, have no body and are not served stale
+            if (auto cache = api_responses_cache->get(url); cache && (is_valid || !cache->body.empty()))
+            {
+                Result res(std::make_unique<Response>(), Error::Success);
+                res->status = OK_200;
+                res->body = cache->get_body();
+
+                // the stale body is the same the client got the last time, so it is
+                // reported as not modified
+                if (!is_valid)
+                {
+                    res->status = NotModified_304;
+                    res->set_header("Warning", http::stale_warning);
+                }
+                return res;
+            }
+        }
+        catch (const std::exception &ex)
+        {
+            // the entry is broken, dropping it and requesting the response from scratch
+            log::api->warn("The cached response is corrupted, {}, url {}", ex.what(), url);
+            api_responses_cache->store(url, http_cache::cache_entry{});
         }
-        // ..or it is invalid already, so we use its ETag to refresh the response
-        else
+    }
+
+    while (1)
+    {
+        // the identical requests, coming from the different threads at the same time,
+        // are collapsed into one network round-trip; the leader stores the response for
+        // its own `cache_for`, so only the requests caching it for the same time are joined
+        auto res = inflight_requests.execute(utils::format("{}#{}", url, cache_for.count()),
+            [this, &url, cache_for, retry_429] { return request_get(url, cache_for, retry_429); });
+
+        // the shared request was performed by a caller without retries, but this one
+        // wants to wait for the endpoint to get released and try again
+        if (retry_429 && res && res->status == TooManyRequests_429 && !cancel_flag)
         {
-            cached_etag = cache.etag;
+            get_endpoint(url).wait([this] { return cancel_flag; });
+            continue;
         }
+
+        return res;
     }
+}
+
+httplib::Result api::request_get(const string &url, clock_t::duration cache_for, bool retry_429)
+{
+    // the cache is invalid already, so we use its ETag to refresh the response
+    string cached_etag = api_responses_cache->get_etag(url);
 
     Result res(std::make_unique<Response>(), Error::Success);
 
     while (1)
     {
+        auto &ep = get_endpoint(url);
+
         // the target endpoint is rate limited...
-        if (auto &ep = get_endpoint(url); ep.is_rate_limited())
+        if (ep.is_rate_limited())
         {
             // in case the request specifies `retry` flag, we lock the thread and wait for
             // the endpoint to get released
@@ -753,8 +928,9 @@ httplib::Result api::get(const string &request_url, clock_t::duration cache_for,
 
         // if we get here with the `cancel_flag` is `true`, this means that user requested to
         // cancel all the current pending requests via Escape on Waiting splash dialog, all the
-        // pending thread woke up and reached this codepoint with the activated flag
-        if (cancel_flag)
+        // pending thread woke up and reached this codepoint with the activated flag; the same
+        // happens, if the request is cancelled while waiting for the pace budget
+        if (!pace_request(ep) || cancel_flag)
         {
             log::api->warn("The request is cancelled by user: {}", url);
             res->status = http::CancelledByUser_470;
@@ -778,27 +954,13 @@ httplib::Result api::get(const string &request_url, clock_t::duration cache_for,
         if (res = get_client()->Get(url, {{ "If-None-Match", cached_etag }}); !res)
             return res;
 
+        update_rate_limits(url, res);
+
         // in case we were rate-limited, we retry the request a bit postponed
-        if (res->status == TooManyRequests_429)
+        if (res->status == TooManyRequests_429 && retry_429)
         {
-            auto retry_after = 3s; // default retry delay in case it is not present in the headers
-            
-            if (res->has_header("retry-after"))
-                // +1s just in case
-                retry_after = std::chrono::seconds(std::stoi(res->get_header_value("retry-after", 0))) + 1s;
-
-            // in any case we update the endpoint's expiration time, so all the subsequent requests
-            // will not bother API server
-            auto &ep = get_endpoint(url);
-            ep.set_expires_at(utils::clock_t::now() + retry_after);
-
-            log::api->warn("The endpoint \"{}\" is rate limited for {}", ep.get_name(), utils::format("{:%T}", retry_after));
-
-            if (retry_429)
-            {
-                log::api->warn("The request is put into the queue for retry in {} seconds: {}", retry_after.count(), url);
-                continue;
-            }
+            log::api->warn("The request is put into the queue for retry: {}", url);
+            continue;
         }
 
         // ...in all other cases - just process and return the result
@@ -815,16 +977,30 @@ httplib::Result api::get(const string &request_url, clock_t::duration cache_for,
     }
     else if (res->status == NotModified_304)
     {
-        const auto &cache = api_responses_cache->get(url);
-
         // replacing empty body with the cached one, so the client
         // does not see the difference
-        res->body = cache.body;
+        try
+        {
+            auto cache = api_responses_cache->get(url);
+            if (cache == nullptr)
+                throw std::runtime_error("the response is not cached anymore");
+
+            res->body = cache->get_body();
+        }
+        catch (const std::exception &ex)
+        {
+            // the entry is broken, it is dropped and the response is requested once more
+            // without ETag, so the server sends the full body this time
+            log::api->warn("The cached response is corrupted, {}, url {}", ex.what(), url);
+            api_responses_cache->store(url, http_cache::cache_entry{});
+
+            return request_get(url, cache_for, retry_429);
+        }
 
         // the response is still valid, so caching for a session or any other
         // time if needed
         if (cache_for != clock_t::duration::zero())
-            api_responses_cache->store(url, cache.body, cache.etag, cache_for);
+            api_responses_cache->prolong(url, cache_for);
     }
     return res;
 }
@@ -832,9 +1008,13 @@ httplib::Result api::get(const string &request_url, clock_t::duration cache_for,
 httplib::Result api::put(const string &request_url, const string &body)
 {
     // checking if the target endpoint is available
-    if (auto &ep = get_endpoint(request_url); ep.is_rate_limited())
+    auto &ep = get_endpoint(request_url);
+    if (ep.is_rate_limited())
         return get_rate_limited_response(ep.get_expires_at());
 
+    if (!pace_request(ep))
+        return get_cancelled_response();
+
     httplib::Result res;
     auto client = get_client();
 
@@ -842,6 +1022,8 @@ httplib::Result api::put(const string &request_url, const string &body)
         res = client->Put(request_url, body, "application/json");
     else
         res = client->Put(request_url);
+
+    update_rate_limits(request_url, res);
     
     if (http::is_success(res))
     {
@@ -855,10 +1037,16 @@ httplib::Result api::put(const string &request_url, const string &body)
 httplib::Result api::del(const string &request_url, const string &body)
 {
     // checking if the target endpoint is available
-    if (auto &ep = get_endpoint(request_url); ep.is_rate_limited())
+    auto &ep = get_endpoint(request_url);
+    if (ep.is_rate_limited())
         return get_rate_limited_response(ep.get_expires_at());
     
+    if (!pace_request(ep))
+        return get_cancelled_response();
+    
     auto res = get_client()->Delete(request_url, body, "application/json");
+
+    update_rate_limits(request_url, res);
     
     if (http::is_success(res))
     {
@@ -872,10 +1060,16 @@ httplib::Result api::del(const string &request_url, const string &body)
 httplib::Result api::post(const string &request_url, const string &body)
 {
     // checking if the target endpoint is available
-    if (auto &ep = get_endpoint(request_url); ep.is_rate_limited())
+    auto &ep = get_endpoint(request_url);
+    if (ep.is_rate_limited())
         return get_rate_limited_response(ep.get_expires_at());
     
+    if (!pace_request(ep))
+        return get_cancelled_response();
+    
     auto res = get_client()->Post(request_url, body, "application/json");
+
+    update_rate_limits(request_url, res);
     
     if (http::is_success(res))
     {
@@ -888,13 +1082,11 @@ httplib::Result api::post(const string &request_url, const string &body)
 
 std::shared_ptr<httplib::Client> api::get_client() const
 {
-    auto client = std::make_shared<httplib::Client>(spotify_api_url);
+    auto client = clients->acquire(spotify_api_url);
 
-    client->set_logger(http_logger);    
+    // the token is attached to each request separately, so refreshing it
+    // does not force the connection to be re-established
     client->set_bearer_token_auth(auth->get_access_token());
-    client->set_default_headers({
-        {"Content-Type", "application/json; charset=utf-8"},
-    });
 
     return client;
 }
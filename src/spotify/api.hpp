@@ -2,13 +2,15 @@
 #define API_HPP_DFF0C34C_5CB3_4F4E_B23A_906584C67C66
 #pragma once
 
+#include "config.hpp"
 #include "interfaces.hpp"
+#include "transport.hpp"
 
 namespace spotifar { namespace spotify {
 
-/// @brief A class-helper to guard an endpoint from spam requests. Implemets the logic
-/// to track endpoint's busy (retry after) time and blocks accessing threads until the
-/// delay is expired. The algorithm is built on the conditional variables and mutexes:
+/// @brief A class-helper to guard an endpoint from spam requests. Paces the requests
+/// proactively with a token bucket, which rate adapts to the server's responses, and tracks
+/// endpoint's busy (retry after) time, blocking accessing threads until the delay is expired.
 /// API receiving 429 http error marks an endpoint as busy and all the further requests
 /// can check its status to avoid spamming or get into the waiting queue until it is free
 ///
@@ -17,14 +19,27 @@ namespace spotifar { namespace spotify {
 class endpoint_guard
 {
 public:
-    endpoint_guard(const string &name): name(name) {}
+    endpoint_guard(const string &name, const token_bucket::settings_t &settings):
+        name(name), bucket(settings) {}
 
     /// @brief Blocks an accessing thread until the delay time is expired or
     /// `predicate` returns `true`
     void wait(std::function<bool()> predicate);
 
-    /// @brief Set the busy expiration time
-    void set_expires_at(const utils::clock_t::time_point &);
+    /// @brief Blocks an accessing thread until the endpoint's bucket gives a token for
+    /// the next request of the given `priority`. Returns `false` if the waiting was
+    /// cancelled by `is_cancelled`
+    bool acquire(std::function<bool()> is_cancelled, request_priority priority)
+    {
+        return bucket.acquire(is_cancelled, priority);
+    }
+
+    /// @brief The server has throttled the endpoint: marks it busy for `retry_after`
+    /// and slows down the requests pace
+    void on_throttled(const utils::clock_t::duration &retry_after);
+
+    /// @brief The request was served well, the requests pace can be increased a bit
+    void on_success() { bucket.on_success(); }
 
     /// @brief Returns the busy status expiration time point
     auto get_expires_at() const -> const utils::clock_t::time_point&;
@@ -33,8 +48,14 @@ public:
     /// until the expiration time
     bool is_rate_limited() const { return expires_at > utils::clock_t::now(); }
 
+    /// @brief Returns the current state of the endpoint's requests pacing bucket
+    auto get_bucket_state() const -> token_bucket::state_t { return bucket.get_state(); }
+
+    /// @brief Whether the endpoint's bucket has no tokens left for now
+    bool is_exhausted() const { return bucket.is_exhausted(); }
+
     /// @brief Notifies all the blocked (pending) threads to wake up and check their statuses
-    void notify_all() { cv.notify_all(); }
+    void notify_all() { cv.notify_all(); bucket.notify_all(); }
 
     /// @brief The endpoint's name
     auto get_name() const -> const string& { return name; }
@@ -43,11 +64,13 @@ private:
     std::mutex guard;
     utils::clock_t::time_point expires_at{};
     string name;
+    token_bucket bucket;
 };
 
 
 class api:
     public api_interface,
+    public config::config_observer,
     public std::enable_shared_from_this<api>
 {
 public:
@@ -67,6 +90,9 @@ public:
     auto get_releases() -> recent_releases_interface* override;
     auto get_auth_cache() -> auth_cache_interface* override;
     auto get_devices_cache(bool resync = false) -> devices_cache_interface* override;
+    auto get_http_cache() -> http_cache* override { return api_responses_cache.get(); }
+    auto get_objects_cache() -> objects_cache* override { return parsed_objects.get(); }
+    auto get_collections() -> collections_registry* override { return collections.get(); }
     
     // library api interface
 
@@ -102,12 +128,22 @@ public:
     void set_repeat_state(const string &mode, const item_id_t &device_id = "") override;
     void set_playback_volume(int volume_percent, const item_id_t &device_id = "") override;
 protected:
-    /// @brief Creates a new http-client instance with the Spotify web API domain address,
-    /// fills up all the default attributes and token, and returns it
+    /// @brief Leases a keep-alive http-client instance with the Spotify web API domain address
+    /// from the clients pool, refreshes its bearer token and returns it. The client gets back
+    /// to the pool once the returned pointer is released
     auto get_client() const -> std::shared_ptr<httplib::Client>;
 
     /// @brief Returns the endpoint guard, depending on the given `url`
     auto get_endpoint(const string &url) -> endpoint_guard&;
+
+    /// @brief Blocks the calling thread until both the global and the given endpoint's
+    /// request budgets allow to perform one more request with the calling thread's
+    /// priority. Returns `false` in case the pending requests were cancelled while waiting
+    bool pace_request(endpoint_guard &ep);
+
+    /// @brief Adapts the requests pace of the `url` endpoint to the server's response:
+    /// slows it down and marks the endpoint as busy on 429, speeds it up otherwise
+    void update_rate_limits(const string &url, const httplib::Result &res);
     
     /// @brief A raw low level start-playback method, receives a http POST request json body string,
     /// in the certain format
@@ -115,20 +151,40 @@ protected:
     /// https://developer.spotify.com/documentation/web-api/reference/start-a-users-playback
     void start_playback_base(const string &body, const item_id_t &device_id);
     
-    auto get(const string &url, utils::clock_t::duration cache_for = {}, bool retry_429 = false) -> httplib::Result override;
+    /// @brief Performs a real network GET request for the domain-trimmed `url`, revalidating
+    /// an expired cached response if any, and stores the result in the http cache
+    auto request_get(const string &url, utils::clock_t::duration cache_for, bool retry_429) -> httplib::Result;
+
+    auto get(const string &url, utils::clock_t::duration cache_for = {}, bool retry_429 = false,
+        bool allow_stale = false) -> httplib::Result override;
     auto put(const string &url, const string &body = "") -> httplib::Result override;
     auto del(const string &url, const string &body = "") -> httplib::Result override;
     auto post(const string &url, const string &body = "") -> httplib::Result override;
     
-    auto get_pool() -> BS::light_thread_pool& override { return requests_pool; };
-    bool is_request_cached(const string &url) const override;
+    auto get_pool() -> BS::priority_thread_pool& override { return requests_pool; };
+    bool is_request_cached(const string &url, bool allow_stale = false) const override;
     bool is_endpoint_rate_limited(const string &endpoint_name) const override;
     void cancel_pending_requests(bool wait_for_result = true) override;
+
+    // config_observer
+    void on_http_cache_limits_changed(uint64_t disk_limit, size_t memory_limit) override;
 private:
-    BS::light_thread_pool requests_pool;
+    /// @note the pool is shared by all the worker threads below, so it must outlive them
+    std::unique_ptr<clients_pool> clients;
+
+    /// @brief The user's requests and playback commands are queued with a higher priority
+    /// than the background ones, see `request_priority`
+    BS::priority_thread_pool requests_pool;
     BS::light_thread_pool resyncs_pool;
 
     std::unordered_map<string, endpoint_guard> guards;
+    mutable std::mutex guards_access;
+
+    /// @brief A global requests budget, shared by all the endpoints
+    token_bucket global_bucket;
+
+    /// @brief Collapses identical concurrent GET requests into one
+    requests_coalescer inflight_requests;
 
     /// @brief A pending requests cancellation flag, used by `cancel_pending_requests` method
     bool cancel_flag = false;
@@ -136,6 +192,8 @@ private:
     // caches
 
     std::unique_ptr<http_cache> api_responses_cache;
+    std::unique_ptr<objects_cache> parsed_objects;
+    std::unique_ptr<collections_registry> collections;
 
     std::unique_ptr<library> library;
     std::unique_ptr<playback_cache> playback;
@@ -4,186 +4,648 @@ namespace spotifar { namespace spotify {
 
 using namespace utils;
 
+/// @brief The bodies smaller than this are not worth compressing
+static const size_t min_compressed_body_size = 512;
+
 std::filesystem::path get_cache_filename()
 {
     return std::filesystem::path(utils::format("{}\\responses.cache", utils::to_string(
         config::get_plugin_data_folder())));
 }
 
-void from_json(const json::Value &j, http_cache::cache_entry &e)
+/// @brief Returns the time point, the response cached for `cache_for` time is valid until
+static clock_t::time_point get_cached_until(clock_t::duration cache_for)
 {
-    e.etag = j["etag"].GetString();
-    e.body = j["body"].GetString();
+    if (cache_for == http::session)
+        return clock_t::time_point::max();
+    return clock_t::now() + cache_for;
+}
 
-    std::int64_t cached_until = 0LL;
-    if (j.HasMember("cached-until"))
-        cached_until = j["cached-until"].GetInt64();
-    
-    e.cached_until = clock_t::time_point{ clock_t::duration(cached_until) };
+string http_cache::cache_entry::get_body() const
+{
+    return is_compressed ? gzip_decompress(body) : body;
 }
 
-void to_json(json::Value &result, const http_cache::cache_entry &e, json::Allocator allocator)
+void http_cache::start()
 {
-    result = json::Value(json::kObjectType);
+    std::lock_guard checkpoint_lock(checkpoint_guard);
+    std::lock_guard lock(storage_guard);
+
+    if (storage.open(get_cache_filename()))
+    {
+        storage.for_each([this](const string &url, const cache_storage::record_t &record)
+            {
+                auto entry = std::make_shared<cache_entry>();
+                entry->etag = record.etag;
+                entry->cached_until = record.cached_until;
+                entry->is_compressed = record.is_compressed;
+                entry->version = ++last_version;
+
+                auto &shard = get_shard(url);
+                publish(get_or_add_slot(shard, url), entry, false);
+            });
+
+        // session-only caches still can have a valid etag, so instead of removing
+        // them we just invalidating `cache-until` attribute
+        for (auto &shard: shards)
+        {
+            std::vector<string> session_urls;
+            for (const auto &[url, slot]: shard.slots)
+                if (slot.entry->is_cached_for_session())
+                    session_urls.push_back(url);
+
+            for (const auto &url: session_urls)
+                set_cached_until(shard, url, clock_t::time_point::min());
+        }
+
+        evict_if_needed();
 
-    result.AddMember("etag", json::Value(e.etag, allocator), allocator);
-    result.AddMember("body", json::Value(e.body, allocator), allocator);
-    result.AddMember("cached-until",
-        json::Value(e.cached_until.time_since_epoch().count()), allocator);
+        auto stats = storage.get_stats();
+        log::global->info("The http cache is loaded, {} responses, file size {}, dead space {}",
+            stats.entries, stats.file_size, stats.dead_size);
+    }
+
+    is_initialized = true;
 }
 
-void http_cache::start()
+void http_cache::shutdown()
+{
+    std::lock_guard checkpoint_lock(checkpoint_guard);
+    std::lock_guard lock(storage_guard);
+    storage.close();
+}
+
+http_cache::shard_t& http_cache::get_shard(const string &url) const
+{
+    return shards[std::hash<string>{}(url) % shards_count];
+}
+
+http_cache::entry_ptr http_cache::find_entry(const string &url, bool &has_body) const
+{
+    const auto &shard = get_shard(url);
+
+    std::shared_lock lock(shard.guard);
+    if (auto it = shard.slots.find(url); it != shard.slots.end())
+    {
+        it->second.last_used.store(++access_tick, std::memory_order_relaxed);
+        has_body = it->second.has_body;
+        return it->second.entry;
+    }
+    return nullptr;
+}
+
+void http_cache::publish(slot_t &slot, entry_ptr entry, bool has_body) const
+{
+    if (slot.has_body)
+        memory_size -= slot.entry->body.size();
+    if (has_body)
+        memory_size += entry->body.size();
+
+    slot.entry = std::move(entry);
+    slot.has_body = has_body;
+    slot.last_used.store(++access_tick, std::memory_order_relaxed);
+}
+
+http_cache::slot_t& http_cache::get_or_add_slot(shard_t &shard, const string &url)
+{
+    auto [it, is_added] = shard.slots.try_emplace(url);
+    if (is_added)
+        urls_index.insert(it->first);
+    return it->second;
+}
+
+bool http_cache::is_cached(const string &url) const
+{
+    bool has_body;
+    return find_entry(url, has_body) != nullptr;
+}
+
+bool http_cache::is_valid(const string &url) const
+{
+    bool has_body;
+    auto entry = find_entry(url, has_body);
+    return entry != nullptr && entry->is_valid();
+}
+
+string http_cache::get_etag(const string &url) const
+{
+    bool has_body;
+    if (auto entry = find_entry(url, has_body))
+        return entry->etag;
+    return "";
+}
+
+http_cache::entry_ptr http_cache::get(const string &url) const
+{
+    bool has_body = false;
+    if (auto entry = find_entry(url, has_body); entry == nullptr || has_body)
+        return entry;
+
+    // the body has not been read from the storage yet; the storage lock keeps
+    // the writers away, so the storage record and the published entry are the same
+    std::lock_guard storage_lock(storage_guard);
+
+    auto &shard = get_shard(url);
+    uint64_t version = 0;
+    {
+        std::shared_lock lock(shard.guard);
+        auto it = shard.slots.find(url);
+        if (it == shard.slots.end() || it->second.has_body)
+            return it == shard.slots.end() ? nullptr : it->second.entry;
+
+        version = it->second.entry->version;
+    }
+
+    const auto *record = storage.find(url);
+    if (record == nullptr)
+        return nullptr;
+
+    // the body is the same, so is the version
+    auto entry = std::make_shared<cache_entry>();
+    entry->etag = record->etag;
+    entry->body = storage.read_body(*record);
+    entry->cached_until = record->cached_until;
+    entry->is_compressed = record->is_compressed;
+    entry->version = version;
+
+    {
+        std::unique_lock lock(shard.guard);
+        publish(shard.slots[url], entry, true);
+    }
+
+    evict_if_needed();
+
+    return entry;
+}
+
+http_cache::entry_ptr http_cache::peek(const string &url) const
+{
+    bool has_body;
+    return find_entry(url, has_body);
+}
+
+void http_cache::store(const string &url, const string &body, const string &etag, clock_t::duration cache_for)
+{
+    cache_entry entry{ etag, body, get_cached_until(cache_for) };
+
+    // compressing outside of the lock
+    if (body.size() >= min_compressed_body_size)
+    {
+        try
+        {
+            entry.body = gzip_compress(body);
+            entry.is_compressed = true;
+        }
+        catch (const std::exception &ex)
+        {
+            log::global->warn("Could not compress the cached response, it is stored as is, {}", ex.what());
+        }
+    }
+
+    store(url, entry);
+}
+
+void http_cache::store(const string &url, const cache_entry &entry)
+{
+    auto snapshot = std::make_shared<cache_entry>(entry);
+    snapshot->version = ++last_version;
+
+    std::lock_guard storage_lock(storage_guard);
+
+    if (storage.is_open() && !storage.put(url, entry.etag, entry.body, entry.cached_until, entry.is_compressed))
+        log::global->warn("Could not store the response in the http cache, {}", url);
+
+    auto &shard = get_shard(url);
+    {
+        std::unique_lock lock(shard.guard);
+        publish(get_or_add_slot(shard, url), snapshot, true);
+    }
+
+    evict_if_needed();
+}
+
+void http_cache::set_cached_until(shard_t &shard, const string &url, clock_t::time_point cached_until)
+{
+    std::unique_lock lock(shard.guard);
+
+    auto it = shard.slots.find(url);
+    if (it == shard.slots.end() || it->second.entry->cached_until == cached_until)
+        return;
+
+    auto entry = std::make_shared<cache_entry>(*it->second.entry);
+    entry->cached_until = cached_until;
+    publish(it->second, entry, it->second.has_body);
+
+    if (storage.is_open())
+        storage.set_cached_until(url, cached_until);
+}
+
+void http_cache::prolong(const string &url, clock_t::duration cache_for)
 {
-    try
+    std::lock_guard storage_lock(storage_guard);
+    set_cached_until(get_shard(url), url, get_cached_until(cache_for));
+}
+
+void http_cache::invalidate(const string &url)
+{
+    // the cached urls are the domain-trimmed ones
+    const auto &prefix = utils::http::trim_params(url.starts_with("/") ? url : utils::http::trim_domain(url));
+    if (prefix.empty())
+        return;
+
+    std::lock_guard storage_lock(storage_guard);
+
+    // the writers are blocked by the storage lock, so the matched range stays the same
+    for (auto it = urls_index.lower_bound(prefix); it != urls_index.end() && it->starts_with(prefix); ++it)
     {
-        auto filepath = get_cache_filename();
+        string matched_url(*it);
+        set_cached_until(get_shard(matched_url), matched_url, {});
+    }
+}
 
-        HANDLE file = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
-            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
-        
-        // there is no cache for reading
-        if (file == INVALID_HANDLE_VALUE)
+void http_cache::clear_all()
+{
+    std::lock_guard storage_lock(storage_guard);
+
+    if (storage.is_open())
+        storage.clear();
+
+    urls_index.clear();
+    for (auto &shard: shards)
+    {
+        std::unique_lock lock(shard.guard);
+        shard.slots.clear();
+    }
+    memory_size = 0;
+}
+
+void http_cache::compact_if_needed()
+{
+    std::lock_guard checkpoint_lock(checkpoint_guard);
+
+    std::unique_ptr<cache_storage::compaction_t> compaction;
+    {
+        std::lock_guard storage_lock(storage_guard);
+        if (!storage.is_open() || !storage.is_compaction_needed())
             return;
 
-        // create a reading "file mapping" for the intire file
-        HANDLE fmap = CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0);
-        if (fmap == INVALID_HANDLE_VALUE)
+        compaction = storage.begin_compaction();
+    }
+
+    // the whole file is copied without the lock, so the bodies are read and the responses
+    // are stored meanwhile; only the ones stored after the snapshot are copied under it
+    cache_storage::write_compaction(*compaction);
+
+    std::lock_guard storage_lock(storage_guard);
+    storage.finish_compaction(*compaction);
+}
+
+void http_cache::checkpoint_if_needed()
+{
+    std::lock_guard checkpoint_lock(checkpoint_guard);
+
+    uint64_t index_offset = 0, generation = 0;
+    {
+        std::lock_guard storage_lock(storage_guard);
+        if (!storage.is_open() || !storage.is_checkpoint_needed())
             return;
 
-        // map the file into memory
-        const char *buffer = (const char*)MapViewOfFile(fmap, FILE_MAP_READ, 0, 0, 0);
-        if (buffer == nullptr)
-        {
-            log::global->warn("There is an unexpected empty cache file. "
-                "Skipping cache initialization");
+        generation = storage.get_generation();
+        index_offset = storage.append_index();
+        if (index_offset == 0)
             return;
-        }
+    }
 
-        // parsing json cache
-        json::parse_to(buffer, cached_responses);
+    // the slowest part is done without the lock, the responses are still stored meanwhile
+    storage.sync();
 
-        // close all handles
-        UnmapViewOfFile(buffer);
-        CloseHandle(fmap);
-        CloseHandle(file);
+    std::lock_guard storage_lock(storage_guard);
+    if (storage.is_open())
+        storage.commit_index(index_offset, generation);
+}
+
+void http_cache::set_limits(uint64_t disk_limit, size_t memory_limit)
+{
+    std::lock_guard storage_lock(storage_guard);
+
+    this->disk_limit = disk_limit;
+    this->memory_limit = memory_limit;
+
+    evict_if_needed();
+}
+
+http_cache::stats_t http_cache::get_stats() const
+{
+    std::lock_guard storage_lock(storage_guard);
+
+    stats_t stats;
+    for (const auto &shard: shards)
+    {
+        std::shared_lock lock(shard.guard);
+        stats.entries += shard.slots.size();
     }
-    catch (const std::exception &ex)
+
+    if (storage.is_open())
     {
-        log::global->error("There is an error while reading http responses "
-            "cache, {}", ex.what());
+        auto storage_stats = storage.get_stats();
+        stats.disk_size = storage_stats.live_size;
+        stats.file_size = storage_stats.file_size;
     }
 
-    is_initialized = true;
+    stats.memory_size = memory_size;
+    stats.evicted = evicted;
+    stats.evicted_size = evicted_size;
+    stats.unloaded = unloaded;
+
+    return stats;
 }
 
-void http_cache::shutdown()
+void http_cache::evict_if_needed() const
 {
-    // session-only caches still can have a valid etag, so instead of removing
-    // them we just invalidating `cache-until` attribute
-    for (auto &[url, cache]: cached_responses)
-        if (cache.is_cached_for_session())
-            cache.cached_until = utils::clock_t::time_point::min();
+    auto get_disk_size = [this] { return storage.is_open() ? storage.get_stats().live_size : 0; };
+
+    bool is_disk_over = disk_limit > 0 && get_disk_size() > disk_limit;
+    bool is_memory_over = memory_limit > 0 && memory_size > memory_limit;
+    if (!is_disk_over && !is_memory_over)
+        return;
+
+    // the cache is trimmed a bit below the budget, so the eviction does not run on every store
+    auto disk_target = disk_limit / 10 * 9;
+    auto memory_target = memory_limit / 10 * 9;
 
-    try
+    struct candidate_t
     {
-        auto filepath = get_cache_filename();
+        int rank; // the lower ones are evicted first
+        uint64_t last_used;
+        shard_t *shard;
+        string url;
+    };
+
+    auto now = clock_t::now();
+    auto get_rank = [&now](const cache_entry &entry)
+    {
+        if (entry.cached_until <= now)
+            return 0; // expired, only the etag is still of some use
+        if (entry.is_cached_for_session())
+            return 1;
+        return 2;
+    };
+
+    std::vector<candidate_t> candidates;
+    for (auto &shard: shards)
+    {
+        std::shared_lock lock(shard.guard);
+        for (const auto &[url, slot]: shard.slots)
+            if (is_disk_over || slot.has_body)
+                candidates.push_back({ get_rank(*slot.entry), slot.last_used.load(std::memory_order_relaxed), &shard, url });
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b)
+        {
+            return std::tie(a.rank, a.last_used) < std::tie(b.rank, b.last_used);
+        });
+
+    for (const auto &c: candidates)
+    {
+        bool is_disk_eviction = is_disk_over && get_disk_size() > disk_target;
+        bool is_memory_eviction = is_memory_over && memory_size > memory_target;
+        if (!is_disk_eviction && !is_memory_eviction)
+            break;
 
-        auto sbuffer = json::dump(cached_responses);
-        DWORD totalSize = (DWORD)sbuffer->GetLength();
+        std::unique_lock lock(c.shard->guard);
 
-        HANDLE file = CreateFileW(filepath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0,
-            CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, 0);
-            
-        if (file == INVALID_HANDLE_VALUE)
+        auto it = c.shard->slots.find(c.url);
+        if (it == c.shard->slots.end())
+            continue;
+
+        auto &slot = it->second;
+
+        // without the storage, the body cannot be read again, so the response is evicted anyway
+        if (is_disk_eviction || !storage.is_open())
         {
-            log::global->error("An error occured while opening a file for dumping an "
-                "http cache, {}", get_last_system_error());
-            return;
-        }
+            const auto *record = storage.is_open() ? storage.find(c.url) : nullptr;
 
-        // create a "file mapping" for the file. Grows it to toalSize
-        HANDLE fmap = CreateFileMapping(file, 0, PAGE_READWRITE, 0, totalSize, 0);
-        if (file == INVALID_HANDLE_VALUE)
+            evicted++;
+            evicted_size += record != nullptr ? record->body_size : slot.entry->body.size();
+
+            if (record != nullptr)
+                storage.remove(c.url);
+
+            publish(slot, nullptr, false);
+            urls_index.erase(it->first);
+            c.shard->slots.erase(it);
+        }
+        else if (slot.has_body)
         {
-            log::global->error("An error occured while creating a mapped cache file, {}",
-                get_last_system_error());
-            return;
+            auto entry = std::make_shared<cache_entry>(*slot.entry);
+            entry->body.clear();
+            entry->body.shrink_to_fit();
+
+            unloaded++;
+            publish(slot, entry, false);
         }
+    }
+
+    log::global->info("The http cache is trimmed to fit the budget, evicted {}, unloaded {}, "
+        "memory size {}, disk size {}", evicted, unloaded, memory_size.load(), get_disk_size());
+}
+
+
+//----------------------------------------------------------------------------------------------
+/// @brief The http cache keys are the domain-trimmed urls, while the cursor pages are
+/// requested by their full `next` urls
+static auto get_response_key(const string &url) -> string
+{
+    return url.starts_with("/") ? url : utils::http::trim_domain(url);
+}
+
+objects_cache::objects_cache(const http_cache &responses, size_t capacity):
+    responses(responses), capacity(capacity)
+{
+}
+
+uint64_t objects_cache::get_version(const string &url) const
+{
+    auto entry = responses.peek(get_response_key(url));
+    return entry != nullptr ? entry->version : 0;
+}
 
-        // map the file into memory
-        void *buffer = MapViewOfFile(fmap, FILE_MAP_WRITE, 0, 0, totalSize);
+objects_cache::object_ptr objects_cache::get(const string &url, std::type_index type)
+{
+    const auto key = get_response_key(url);
 
-        std::memcpy(buffer, sbuffer->GetString(), totalSize);
+    // the response is checked first, so the lock is not held while the http cache is accessed
+    auto entry = responses.peek(key);
 
-        // close all handles etc.
-        UnmapViewOfFile(buffer);
-        CloseHandle(fmap);
-        CloseHandle(file);
+    std::lock_guard lock(guard);
+
+    auto it = objects.find({ key, type });
+    if (it == objects.end())
+    {
+        misses++;
+        return nullptr;
     }
-    catch (const std::exception &ex)
+
+    // the response is gone, replaced or expired, so is the object parsed from it
+    if (entry == nullptr || entry->version != it->second.version || !entry->is_valid())
     {
-        log::global->error("There is an error while storing http responses "
-            "cache, {}", ex.what());
+        misses++;
+        objects.erase(it);
+        return nullptr;
     }
+
+    hits++;
+    it->second.last_used = ++access_tick;
+    return it->second.object;
 }
 
-bool http_cache::is_cached(const string &url) const
+void objects_cache::put(const string &url, std::type_index type, uint64_t version, object_ptr object)
 {
+    if (version == 0 || object == nullptr)
+        return;
+
     std::lock_guard lock(guard);
-    return cached_responses.contains(url);
+
+    auto &slot = objects.insert_or_assign({ get_response_key(url), type }, slot_t{ version, std::move(object) }).first->second;
+    slot.last_used = ++access_tick;
+
+    evict_if_needed();
 }
 
-const http_cache::cache_entry& http_cache::get(const string &url) const
+void objects_cache::clear()
 {
     std::lock_guard lock(guard);
-    return cached_responses.at(url);
+    objects.clear();
 }
 
-void http_cache::store(const string &url, string body, const string &etag, clock_t::duration cache_for)
+objects_cache::stats_t objects_cache::get_stats() const
 {
-    clock_t::time_point cached_until = clock_t::now() + cache_for;
+    std::lock_guard lock(guard);
+    return { objects.size(), hits, misses };
+}
+
+void objects_cache::evict_if_needed()
+{
+    if (objects.size() <= capacity)
+        return;
+
+    // trimming a bit below the capacity, so the eviction does not run on every put
+    std::vector<uint64_t> ticks;
+    ticks.reserve(objects.size());
+    for (const auto &[key, slot]: objects)
+        ticks.push_back(slot.last_used);
+
+    auto target = capacity / 10 * 9;
+    auto threshold = ticks.begin() + (ticks.size() - target);
+    std::nth_element(ticks.begin(), threshold, ticks.end());
+
+    std::erase_if(objects, [min_tick = *threshold](const auto &item) { return item.second.last_used < min_tick; });
+}
 
-    if (cache_for == http::session)
-        cached_until = clock_t::time_point::max();
 
+//----------------------------------------------------------------------------------------------
+collections_registry::collections_registry(const http_cache &responses, size_t retained_count):
+    responses(responses), retained_count(retained_count)
+{
+}
+
+collections_registry::snapshot_ptr collections_registry::find(const string &key, std::type_index type,
+    uint64_t &version, std::vector<string> *stale_urls)
+{
+    std::vector<source_t> sources;
+    snapshot_ptr snapshot;
     {
         std::lock_guard lock(guard);
-        cached_responses[url] = { etag, body, cached_until };
+
+        auto it = slots.find({ key, type });
+        if (it == slots.end() || (snapshot = it->second.snapshot.lock()) == nullptr)
+        {
+            misses++;
+            return nullptr;
+        }
+        sources = it->second.sources;
+        version = it->second.version;
     }
-}
 
-void http_cache::store(const string &url, const cache_entry &entry)
-{
+    // the responses are checked without the lock, the http cache has its own ones
+    std::vector<string> expired;
+    for (const auto &source: sources)
+    {
+        auto entry = responses.peek(source.url);
+        if (entry == nullptr || entry->version != source.version || (!entry->is_valid() && stale_urls == nullptr))
+        {
+            std::lock_guard lock(guard);
+            misses++;
+            return nullptr;
+        }
+
+        if (!entry->is_valid())
+            expired.push_back(source.url);
+    }
+
+    if (stale_urls != nullptr)
+        stale_urls->insert(stale_urls->end(), expired.begin(), expired.end());
+
     std::lock_guard lock(guard);
-    cached_responses[url] = entry;
+    hits++;
+    retain(snapshot);
+    return snapshot;
 }
 
-void http_cache::invalidate(const string &url)
+uint64_t collections_registry::publish(const string &key, std::type_index type,
+    std::vector<source_t> sources, snapshot_ptr snapshot)
 {
-    const auto &trimmed_url = utils::http::trim_params(url);
+    if (sources.empty() || snapshot == nullptr ||
+        std::any_of(sources.begin(), sources.end(), [](const auto &s) { return s.version == 0; }))
+        return 0;
 
     std::lock_guard lock(guard);
-    for (auto it = cached_responses.begin(); it != cached_responses.end(); ++it)
+
+    // the slots of the gone snapshots are purged, once there are twice as many slots as
+    // there were left the last time
+    if (slots.size() >= std::max(purged_size * 2, retained_count))
     {
-        auto pos = it->first.find(trimmed_url);
-        if (pos != string::npos)
-            it->second.cached_until = {};
+        std::erase_if(slots, [](const auto &item) { return item.second.snapshot.expired(); });
+        purged_size = slots.size();
     }
-    // for (auto it = cached_responses.begin(); it != cached_responses.end();)
-    // {
-    //     auto pos = it->first.find(trimmed_url);
-    //     if (pos != string::npos)
-    //         cached_responses.erase(it++);
-    //     else
-    //         ++it;
-    // }
+
+    auto version = ++last_version;
+    slots.insert_or_assign({ key, type }, slot_t{ snapshot, std::move(sources), version });
+    retain(snapshot);
+
+    return version;
 }
 
-void http_cache::clear_all()
+void collections_registry::clear()
 {
     std::lock_guard lock(guard);
-    cached_responses.clear();
+    slots.clear();
+    retained.clear();
+    purged_size = 0;
+}
+
+collections_registry::stats_t collections_registry::get_stats() const
+{
+    std::lock_guard lock(guard);
+
+    auto alive = std::count_if(slots.begin(), slots.end(),
+        [](const auto &item) { return !item.second.snapshot.expired(); });
+
+    return { (size_t)alive, hits, misses };
+}
+
+void collections_registry::retain(const snapshot_ptr &snapshot)
+{
+    if (retained_count == 0)
+        return;
+
+    if (auto it = std::find(retained.begin(), retained.end(), snapshot); it != retained.end())
+        retained.erase(it);
+
+    retained.push_back(snapshot);
+    if (retained.size() > retained_count)
+        retained.pop_front();
 }
 
 } // namespace spotify
-} // namespace spotifar
\ No newline at end of file
+} // namespace spotifar
@@ -5,6 +5,8 @@
 #include "stdafx.h"
 #include "utils.hpp"
 #include "config.hpp"
+#include "transport.hpp"
+#include "cache_storage.hpp"
 
 namespace spotifar { namespace spotify {
 
@@ -30,6 +32,9 @@ struct cached_data_abstract: public config::persistent_data_abstract
 
     /// @brief Return true if the cache should not be resynced
     virtual bool is_active() const { return true; }
+
+    /// @brief The priority of the requests, performed by the periodic resyncs
+    virtual auto get_resync_priority() const -> request_priority { return request_priority::background; }
 };
 
 
@@ -295,27 +300,54 @@ void json_cache<T>::apply_patches(T &item)
 
 
 /// @brief A class-helper for caching http responses from spotify server. Holds
-/// the information about ETags and validity time of the responses
-class http_cache
+/// the information about ETags and validity time of the responses. The responses are
+/// written through to the on-disk `cache_storage`, only their metadata is kept in memory,
+/// the gzip-compressed bodies are read from the mapped file on the first demand.
+///
+/// The entries are kept in a number of shards with their own locks, so the lookups from
+/// the different request threads do not contend with each other. An entry is an immutable
+/// snapshot: the readers get a shared handle to it, the writers publish a new version
+/// instead of changing the existing one, so the handle stays valid and consistent
+/// regardless of the following updates.
+///
+/// The cache is bounded by the disk and memory budgets. Above the disk one, the responses
+/// are evicted from the cache completely; above the memory one, only their bodies are
+/// dropped from memory, they are read from the storage again on demand. The expired
+/// responses go first, the session-only ones next, the rest - least recently used first
+class TEST_API http_cache
 {
 public:
     /// @brief A calss for storing one entry of a cache
     struct cache_entry
     {
         string etag = "";
-        string body = "";
+        string body = ""; // the body as it is stored, see `is_compressed`
         clock_t::time_point cached_until{};
-        
+        bool is_compressed = false;
+        uint64_t version = 0; // changes every time a new body is stored for the url
+
+        /// @brief Returns the original response body, decompressing it if needed
+        auto get_body() const -> string;
+
         /// @brief Is cached value still valid or expired
         inline bool is_valid() const { return clock_t::now() < cached_until; }
         inline operator bool() const { return is_valid(); }
 
         /// @brief Is value cached only for the current session or persistent
         inline bool is_cached_for_session() const { return cached_until == clock_t::time_point::max(); }
+    };
+
+    using entry_ptr = std::shared_ptr<const cache_entry>;
 
-        // json serialization interface
-        friend void from_json(const json::Value &j, cache_entry &e);
-        friend void to_json(json::Value &j, const cache_entry &e, json::Allocator allocator);
+    struct stats_t
+    {
+        size_t entries = 0;
+        uint64_t disk_size = 0; // the size of the stored responses
+        uint64_t file_size = 0; // the size of the storage file, including the not compacted space
+        size_t memory_size = 0; // the size of the bodies held in memory
+        size_t evicted = 0; // the responses evicted to fit the disk budget
+        uint64_t evicted_size = 0;
+        size_t unloaded = 0; // the bodies dropped from memory to fit the memory budget
     };
 public:
     void start();
@@ -329,24 +361,279 @@ public:
     /// @param body a body to store
     /// @param http response ETag header
     /// @param cache_for optional time duration to keep the response
-    void store(const string &url, string body, const string &etag, clock_t::duration cache_for = {});
+    void store(const string &url, const string &body, const string &etag, clock_t::duration cache_for = {});
     void store(const string &url, const cache_entry &entry);
 
+    /// @brief Prolongs the validity of the stored `url` response for `cache_for` time,
+    /// the response stays the same
+    void prolong(const string &url, clock_t::duration cache_for);
+
     /// @brief Does cache have the stored response for a given `url`
     bool is_cached(const string &url) const;
 
-    /// @brief Get the cached data for a given `url`
-    auto get(const string &url) const -> const cache_entry&;
+    /// @brief Does cache have the stored response for a given `url` and it is still valid
+    bool is_valid(const string &url) const;
+
+    /// @brief Returns the ETag of the stored `url` response or an empty string; the
+    /// body is not read
+    auto get_etag(const string &url) const -> string;
+
+    /// @brief Get the cached data snapshot for a given `url`, nullptr if there is none
+    auto get(const string &url) const -> entry_ptr;
+
+    /// @brief Returns the published `url` snapshot as it is, nullptr if there is none;
+    /// the body is not read, so it can be empty
+    auto peek(const string &url) const -> entry_ptr;
 
     /// @brief Invalidates stored data for the `url` or range of urls, matching given `url part`
     void invalidate(const string &url);
 
     /// @brief Invalidates all the cache
     void clear_all();
+
+    /// @brief A periodic maintenance of the storage file: compacts it, when there
+    /// is too much of the overwritten responses in it
+    void compact_if_needed();
+
+    /// @brief A periodic checkpoint of the storage file: saves the index and flushes the
+    /// written responses to the disk, so a crash loses nothing of them. The flushing
+    /// does not block the other threads
+    void checkpoint_if_needed();
+
+    /// @brief Sets the disk and memory budgets in bytes, zero means no limit;
+    /// the cache is fit into the new budgets right away
+    void set_limits(uint64_t disk_limit, size_t memory_limit);
+
+    auto get_stats() const -> stats_t;
+private:
+    /// @brief A published version of the entry; the entries loaded from the storage
+    /// come without bodies, those are read on the first `get` request
+    struct slot_t
+    {
+        entry_ptr entry;
+        bool has_body = false;
+        mutable std::atomic<uint64_t> last_used = 0; // the access tick, for the LRU eviction
+    };
+
+    struct shard_t
+    {
+        mutable std::shared_mutex guard;
+        std::unordered_map<string, slot_t> slots;
+    };
+
+    static const size_t shards_count = 16;
+
+    auto get_shard(const string &url) const -> shard_t&;
+
+    /// @brief Returns the published `url` entry or nullptr, marks it as used
+    auto find_entry(const string &url, bool &has_body) const -> entry_ptr;
+
+    /// @brief Replaces the `slot` entry with the new version, the caller must hold the shard lock
+    void publish(slot_t &slot, entry_ptr entry, bool has_body) const;
+
+    /// @brief Returns the `url` slot, creating and indexing it if there is none; the caller
+    /// must hold both the `storage_guard` and the shard lock
+    auto get_or_add_slot(shard_t &shard, const string &url) -> slot_t&;
+
+    /// @brief Publishes a new version of the `url` entry with the updated validity time,
+    /// the caller must hold the `storage_guard`
+    void set_cached_until(shard_t &shard, const string &url, clock_t::time_point cached_until);
+
+    /// @brief Evicts the responses or unloads their bodies, if the cache does not fit
+    /// the budgets, the caller must hold the `storage_guard`
+    void evict_if_needed() const;
 private:
-    mutable std::mutex guard;
     std::atomic<bool> is_initialized = false;
-    std::unordered_map<string, cache_entry> cached_responses;
+    mutable std::array<shard_t, shards_count> shards;
+    mutable std::atomic<uint64_t> access_tick = 0;
+    mutable std::atomic<size_t> memory_size = 0;
+    std::atomic<uint64_t> last_version = 0;
+
+    uint64_t disk_limit = 0;
+    size_t memory_limit = 0;
+
+    // eviction counters, guarded by the `storage_guard`
+    mutable size_t evicted = 0, unloaded = 0;
+    mutable uint64_t evicted_size = 0;
+
+    // the storage is a single file, so all the writers and the bodies readers are
+    // serialized by its lock; the lock is always taken before the shards' ones
+    mutable std::mutex storage_guard;
+    mutable cache_storage storage;
+
+    // the storage file is flushed without the `storage_guard`, this lock keeps the file
+    // from being reopened meanwhile; it is always taken before the `storage_guard`
+    std::mutex checkpoint_guard;
+
+    // all the cached urls in the sorted order, so the invalidation by an url prefix visits
+    // only the matching ones; the views point to the shards' keys, which are stable until
+    // erased; guarded by the `storage_guard`
+    mutable std::set<std::string_view> urls_index;
+};
+
+
+/// @brief A cache of the objects, deserialized from the http cache responses, so the same
+/// cached body is not decompressed and parsed over and over again, e.g. on each panel redraw.
+///
+/// The objects are immutable and keyed by the response url and the type of the parser. An
+/// object is valid as long as the http cache holds the same valid version of the response
+/// it was parsed from, so it goes away together with its response: once it is replaced,
+/// invalidated or evicted. Above the capacity, the least recently used objects are dropped
+class TEST_API objects_cache
+{
+public:
+    using object_ptr = std::shared_ptr<const void>;
+
+    struct stats_t
+    {
+        size_t objects = 0;
+        size_t hits = 0;
+        size_t misses = 0; // the lookups of the missing or outdated objects
+    };
+public:
+    /// @param responses the http cache the objects are parsed from
+    /// @param capacity a maximum amount of the objects held
+    objects_cache(const http_cache &responses, size_t capacity = 2048);
+
+    /// @brief Returns the version of the cached `url` response, zero if there is none; the
+    /// version should be taken before the body is read, so the object is never tagged with
+    /// a newer version than the one it was parsed from
+    auto get_version(const string &url) const -> uint64_t;
+
+    /// @brief Returns the object of the `type`, parsed from the `url` response, in case
+    /// the response is still valid and of the same version, nullptr otherwise
+    auto get(const string &url, std::type_index type) -> object_ptr;
+
+    /// @brief Puts the object of the `type`, parsed from the `version` of the `url` response
+    void put(const string &url, std::type_index type, uint64_t version, object_ptr object);
+
+    void clear();
+
+    auto get_stats() const -> stats_t;
+private:
+    struct key_t
+    {
+        string url;
+        std::type_index type;
+
+        bool operator==(const key_t &other) const = default;
+    };
+
+    struct key_hash_t
+    {
+        size_t operator()(const key_t &key) const
+        {
+            return std::hash<string>{}(key.url) ^ (key.type.hash_code() << 1);
+        }
+    };
+
+    struct slot_t
+    {
+        uint64_t version;
+        object_ptr object;
+        uint64_t last_used = 0;
+    };
+
+    /// @brief Drops the least recently used objects, if there are more than the capacity,
+    /// the caller must hold the lock
+    void evict_if_needed();
+private:
+    const http_cache &responses;
+    size_t capacity;
+
+    mutable std::mutex guard;
+    std::unordered_map<key_t, slot_t, key_hash_t> objects;
+    uint64_t access_tick = 0;
+    size_t hits = 0, misses = 0;
+};
+
+
+/// @brief A registry of the collections' fetched items, shared by all the collection objects
+/// of the same url, e.g. the album's tracks, listed by the albums view and opened by the tracks
+/// one, are fetched and held once.
+///
+/// A snapshot is immutable and keyed by the collection's url and the type of its items. It is
+/// made of the collection's pages and stays current as long as the http cache holds the same
+/// valid versions of their responses; once any of them is replaced, the collection is fetched
+/// anew and publishes a new snapshot with a new version, so the holders can tell the change
+/// by the version only. The registry does not own the snapshots, they live as long as some
+/// collection holds them; only the few most recently used ones are retained, so the views,
+/// navigated back and forth, find them still there
+class TEST_API collections_registry
+{
+public:
+    using snapshot_ptr = std::shared_ptr<const void>;
+
+    /// @brief A page's response, the snapshot is made of
+    struct source_t
+    {
+        string url;
+        uint64_t version; // the http cache version of the response, see `http_cache::cache_entry`
+    };
+
+    struct stats_t
+    {
+        size_t snapshots = 0; // the alive ones
+        size_t hits = 0;
+        size_t misses = 0; // the lookups of the missing, gone or outdated snapshots
+    };
+public:
+    /// @param responses the http cache the pages' responses are kept in
+    /// @param retained_count an amount of the most recently used snapshots kept alive
+    collections_registry(const http_cache &responses, size_t retained_count = 32);
+
+    /// @brief Returns the `key` snapshot of the `type` and its `version` in case it is
+    /// current, nullptr otherwise
+    /// @param stale_urls if given, the snapshot made of the expired responses is current as
+    /// well, while they are the same versions; their urls are put here to be revalidated
+    auto find(const string &key, std::type_index type, uint64_t &version,
+        std::vector<string> *stale_urls = nullptr) -> snapshot_ptr;
+
+    /// @brief Publishes the `key` snapshot of the `type`, made of the given `sources`, returns
+    /// its version. The snapshot made of any of the not cached responses is not published,
+    /// zero is returned then
+    auto publish(const string &key, std::type_index type, std::vector<source_t> sources,
+        snapshot_ptr snapshot) -> uint64_t;
+
+    void clear();
+
+    auto get_stats() const -> stats_t;
+private:
+    struct key_t
+    {
+        string key;
+        std::type_index type;
+
+        bool operator==(const key_t &other) const = default;
+    };
+
+    struct key_hash_t
+    {
+        size_t operator()(const key_t &key) const
+        {
+            return std::hash<string>{}(key.key) ^ (key.type.hash_code() << 1);
+        }
+    };
+
+    struct slot_t
+    {
+        std::weak_ptr<const void> snapshot;
+        std::vector<source_t> sources;
+        uint64_t version;
+    };
+
+    /// @brief Keeps the `snapshot` among the most recently used ones, the caller must hold the lock
+    void retain(const snapshot_ptr &snapshot);
+private:
+    const http_cache &responses;
+    size_t retained_count;
+
+    mutable std::mutex guard;
+    std::unordered_map<key_t, slot_t, key_hash_t> slots;
+    std::deque<snapshot_ptr> retained; // the most recently used ones at the back
+    size_t purged_size = 0; // the amount of the slots left after the last purge of the gone ones
+    uint64_t last_version = 0;
+    size_t hits = 0, misses = 0;
 };
 
 } // namespace spotify
@@ -0,0 +1,902 @@
+#include "cache_storage.hpp"
+
+#include <zlib.h>
+#if !defined(_WIN32)
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+namespace spotifar { namespace spotify {
+
+using clock_t = utils::clock_t;
+
+//----------------------------------------------------------------------------------------------
+#if defined(_WIN32)
+
+bool mapped_file::open(const std::filesystem::path &filepath, bool read_only)
+{
+    close();
+
+    // the reader shares the writing with the handle the file is written by
+    if (read_only)
+        file = CreateFileW(filepath.c_str(), GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    else
+        file = CreateFileW(filepath.c_str(), GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_DELETE, 0, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size))
+    {
+        close();
+        return false;
+    }
+    file_size = (uint64_t)size.QuadPart;
+
+    return true;
+}
+
+void mapped_file::close()
+{
+    unmap();
+
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+
+    file = INVALID_HANDLE_VALUE;
+    file_size = 0;
+}
+
+bool mapped_file::is_open() const
+{
+    return file != INVALID_HANDLE_VALUE;
+}
+
+bool mapped_file::map()
+{
+    unmap();
+
+    // an empty file cannot be mapped
+    if (file_size == 0)
+        return false;
+
+    mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (mapping == NULL)
+        return false;
+
+    mapped = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (mapped == nullptr)
+    {
+        unmap();
+        return false;
+    }
+
+    mapped_size = file_size;
+    return true;
+}
+
+void mapped_file::unmap()
+{
+    if (mapped != nullptr)
+        UnmapViewOfFile(mapped);
+
+    if (mapping != NULL)
+        CloseHandle(mapping);
+
+    mapped = nullptr;
+    mapping = NULL;
+    mapped_size = 0;
+}
+
+bool mapped_file::read_at(uint64_t offset, void *data, size_t size) const
+{
+    OVERLAPPED position{};
+    position.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    position.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD read = 0;
+    return ReadFile(file, data, (DWORD)size, &read, &position) && read == size;
+}
+
+bool mapped_file::write_at(uint64_t offset, const void *data, size_t size)
+{
+    OVERLAPPED position{};
+    position.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    position.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD written = 0;
+    if (!WriteFile(file, data, (DWORD)size, &written, &position) || written != size)
+        return false;
+
+    file_size = std::max(file_size, offset + size);
+    return true;
+}
+
+bool mapped_file::truncate(uint64_t size)
+{
+    // a mapped file cannot be truncated
+    unmap();
+
+    LARGE_INTEGER position{};
+    position.QuadPart = (LONGLONG)size;
+    if (!SetFilePointerEx(file, position, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+        return false;
+
+    file_size = size;
+    return true;
+}
+
+void mapped_file::flush()
+{
+    FlushFileBuffers(file);
+}
+
+#else
+
+bool mapped_file::open(const std::filesystem::path &filepath, bool read_only)
+{
+    close();
+
+    file = read_only ? ::open(filepath.c_str(), O_RDONLY) : ::open(filepath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file < 0)
+        return false;
+
+    struct stat st{};
+    if (fstat(file, &st) != 0)
+    {
+        close();
+        return false;
+    }
+    file_size = (uint64_t)st.st_size;
+
+    return true;
+}
+
+void mapped_file::close()
+{
+    unmap();
+
+    if (file >= 0)
+        ::close(file);
+
+    file = -1;
+    file_size = 0;
+}
+
+bool mapped_file::is_open() const
+{
+    return file >= 0;
+}
+
+bool mapped_file::map()
+{
+    unmap();
+
+    // an empty file cannot be mapped
+    if (file_size == 0)
+        return false;
+
+    void *ptr = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, file, 0);
+    if (ptr == MAP_FAILED)
+        return false;
+
+    mapped = (const char*)ptr;
+    mapped_size = file_size;
+    return true;
+}
+
+void mapped_file::unmap()
+{
+    if (mapped != nullptr)
+        munmap((void*)mapped, mapped_size);
+
+    mapped = nullptr;
+    mapped_size = 0;
+}
+
+bool mapped_file::read_at(uint64_t offset, void *data, size_t size) const
+{
+    char *ptr = (char*)data;
+    for (size_t left = size; left > 0;)
+    {
+        auto read = pread(file, ptr, left, (off_t)offset);
+        if (read <= 0)
+            return false;
+
+        ptr += read;
+        offset += read;
+        left -= read;
+    }
+    return true;
+}
+
+bool mapped_file::write_at(uint64_t offset, const void *data, size_t size)
+{
+    const char *ptr = (const char*)data;
+    for (size_t left = size; left > 0;)
+    {
+        auto written = pwrite(file, ptr, left, (off_t)offset);
+        if (written <= 0)
+            return false;
+
+        ptr += written;
+        offset += written;
+        left -= written;
+    }
+
+    file_size = std::max<uint64_t>(file_size, offset);
+    return true;
+}
+
+bool mapped_file::truncate(uint64_t size)
+{
+    unmap();
+
+    if (ftruncate(file, (off_t)size) != 0)
+        return false;
+
+    file_size = size;
+    return true;
+}
+
+void mapped_file::flush()
+{
+    fsync(file);
+}
+
+#endif
+
+const char* mapped_file::view(uint64_t offset, uint64_t size)
+{
+    if (offset + size > file_size)
+        return nullptr;
+
+    // the file has grown since the last mapping
+    if (offset + size > mapped_size && !map())
+        return nullptr;
+
+    return mapped + offset;
+}
+
+bool mapped_file::append(const void *data, size_t size)
+{
+    return write_at(file_size, data, size);
+}
+
+
+//----------------------------------------------------------------------------------------------
+// the file format; all the numbers are stored in the native (little-endian) byte order
+
+static const char file_magic[8] = { 'S', 'P', 'F', 'R', 'H', 'T', 'T', 'P' };
+static const uint32_t file_version = 1;
+static const uint32_t record_magic = 0x44524352; // "RCRD"
+
+/// @brief The file is compacted only if it is bigger than this
+static const uint64_t min_compaction_size = 8 * 1024 * 1024;
+
+/// @brief The index is checkpointed, once this amount of the records is written after it...
+static const uint64_t checkpoint_size = 1024 * 1024;
+
+/// @brief ...or once this time has passed since the last checkpoint with any records written
+static const auto checkpoint_interval = std::chrono::seconds(30);
+
+enum record_type: uint8_t
+{
+    entry_record = 1, // a full stored response
+    expiry_record = 2, // an update of the response's validity time
+    index_record = 3, // a snapshot of the whole index
+    removal_record = 4, // a removal of the response
+};
+
+enum record_flags: uint8_t
+{
+    compressed_flag = 1,
+};
+
+struct file_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t index_offset; // an offset of the latest index record, 0 if there is none
+    uint64_t reserved[2];
+};
+static_assert(sizeof(file_header_t) == 40);
+
+struct record_header_t
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t url_size;
+    uint32_t etag_size;
+    uint32_t body_size;
+    uint32_t crc; // crc32 of url, etag and body
+    int64_t cached_until;
+};
+static_assert(sizeof(record_header_t) == 32);
+
+/// @brief An entry of the serialized index, followed by url and etag strings
+struct index_entry_t
+{
+    int64_t cached_until;
+    uint64_t body_offset;
+    uint32_t body_size;
+    uint32_t url_size;
+    uint32_t etag_size;
+    uint32_t flags;
+};
+static_assert(sizeof(index_entry_t) == 32);
+
+static uint64_t get_record_size(size_t url_size, size_t etag_size, size_t body_size)
+{
+    return sizeof(record_header_t) + url_size + etag_size + body_size;
+}
+
+static uint32_t get_crc(std::string_view url, std::string_view etag, std::string_view body)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+
+    // an empty view can have a null data pointer, which resets the crc
+    for (const auto &part: { url, etag, body })
+        if (!part.empty())
+            crc = crc32(crc, (const Bytef*)part.data(), (uInt)part.size());
+
+    return (uint32_t)crc;
+}
+
+static int64_t to_storage_time(clock_t::time_point tp)
+{
+    return tp.time_since_epoch().count();
+}
+
+static clock_t::time_point from_storage_time(int64_t value)
+{
+    return clock_t::time_point{ clock_t::duration(value) };
+}
+
+bool cache_storage::open(const std::filesystem::path &path)
+{
+    close();
+    generation++;
+
+    index.clear();
+    live_size = index_record_size = unindexed_size = 0;
+
+    filepath = path;
+    if (!file.open(filepath))
+    {
+        log::global->error("Could not open the http cache file, {}", utils::get_last_system_error());
+        return false;
+    }
+
+    const auto *header = (const file_header_t*)file.view(0, sizeof(file_header_t));
+    if (header == nullptr || std::memcmp(header->magic, file_magic, sizeof(file_magic)) != 0 ||
+        header->version != file_version)
+    {
+        // the file is new, broken or of some other version
+        if (file.get_size() > 0)
+            log::global->warn("The http cache file has an unknown format, starting it over");
+        return reset();
+    }
+
+    uint64_t header_size = header->header_size, index_offset = header->index_offset;
+
+    // the index snapshot is read and only the records after it are replayed; in case the
+    // snapshot is broken, the index is rebuilt by replaying the whole file
+    if (index_offset != 0 && read_index(index_offset))
+        replay(index_offset + index_record_size);
+    else
+        replay(header_size);
+
+    last_checkpoint = clock_t::now();
+
+    return true;
+}
+
+void cache_storage::close()
+{
+    if (!file.is_open())
+        return;
+
+    if (is_dirty)
+        write_index();
+
+    file.close();
+    index.clear();
+    live_size = index_record_size = unindexed_size = 0;
+    is_dirty = false;
+}
+
+bool cache_storage::reset()
+{
+    index.clear();
+    live_size = index_record_size = unindexed_size = 0;
+    is_dirty = false;
+    generation++;
+
+    file_header_t header{};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.version = file_version;
+    header.header_size = sizeof(file_header_t);
+
+    return file.truncate(0) && file.append(&header, sizeof(header));
+}
+
+bool cache_storage::read_index(uint64_t offset)
+{
+    const auto *rh = (const record_header_t*)file.view(offset, sizeof(record_header_t));
+    if (rh == nullptr || rh->magic != record_magic || rh->type != index_record)
+        return false;
+
+    auto body_size = rh->body_size, crc = rh->crc;
+
+    const char *body = file.view(offset + sizeof(record_header_t), body_size);
+    if (body == nullptr || get_crc({}, {}, { body, body_size }) != crc)
+        return false;
+
+    std::unordered_map<string, record_t> loaded;
+    uint64_t loaded_size = 0;
+
+    for (const char *ptr = body, *end = body + body_size; ptr < end;)
+    {
+        if (ptr + sizeof(index_entry_t) > end)
+            return false;
+
+        index_entry_t entry;
+        std::memcpy(&entry, ptr, sizeof(entry));
+        ptr += sizeof(entry);
+
+        if (ptr + entry.url_size + entry.etag_size > end)
+            return false;
+
+        string url(ptr, entry.url_size);
+        ptr += entry.url_size;
+
+        record_t &record = loaded[url];
+        record.etag.assign(ptr, entry.etag_size);
+        ptr += entry.etag_size;
+
+        record.cached_until = from_storage_time(entry.cached_until);
+        record.body_offset = entry.body_offset;
+        record.body_size = entry.body_size;
+        record.is_compressed = (entry.flags & compressed_flag) != 0;
+
+        loaded_size += get_record_size(entry.url_size, entry.etag_size, entry.body_size);
+    }
+
+    index = std::move(loaded);
+    live_size = loaded_size;
+    index_record_size = get_record_size(0, 0, body_size);
+
+    return true;
+}
+
+void cache_storage::replay(uint64_t offset)
+{
+    size_t replayed = 0;
+
+    while (offset < file.get_size())
+    {
+        const auto *rh = (const record_header_t*)file.view(offset, sizeof(record_header_t));
+        if (rh == nullptr || rh->magic != record_magic)
+            break;
+
+        record_header_t header = *rh;
+        auto record_size = get_record_size(header.url_size, header.etag_size, header.body_size);
+
+        const char *data = file.view(offset, record_size);
+        if (data == nullptr)
+            break;
+
+        std::string_view url(data + sizeof(header), header.url_size);
+        std::string_view etag(url.data() + url.size(), header.etag_size);
+        std::string_view body(etag.data() + etag.size(), header.body_size);
+
+        if (get_crc(url, etag, body) != header.crc)
+            break;
+
+        if (header.type == entry_record)
+        {
+            auto &record = index[string(url)];
+            if (record.body_offset != 0)
+                live_size -= get_record_size(url.size(), record.etag.size(), record.body_size);
+
+            record.etag = etag;
+            record.cached_until = from_storage_time(header.cached_until);
+            record.body_offset = offset + record_size - header.body_size;
+            record.body_size = header.body_size;
+            record.is_compressed = (header.flags & compressed_flag) != 0;
+
+            live_size += record_size;
+        }
+        else if (header.type == expiry_record)
+        {
+            if (auto it = index.find(string(url)); it != index.end())
+                it->second.cached_until = from_storage_time(header.cached_until);
+        }
+        else if (header.type == removal_record)
+        {
+            if (auto it = index.find(string(url)); it != index.end())
+            {
+                live_size -= get_record_size(url.size(), it->second.etag.size(), it->second.body_size);
+                index.erase(it);
+            }
+        }
+        else if (header.type == index_record)
+        {
+            // the header was not updated after this snapshot was written
+            if (!read_index(offset))
+                break;
+            unindexed_size = 0;
+        }
+
+        if (header.type != index_record)
+            unindexed_size += record_size;
+
+        offset += record_size;
+        replayed++;
+    }
+
+    if (replayed > 0)
+        is_dirty = true;
+
+    // the tail is broken, most likely the last record was not written completely
+    if (offset < file.get_size())
+    {
+        log::global->warn("The http cache file is broken at {}, {} bytes are cut off",
+            offset, file.get_size() - offset);
+        file.truncate(offset);
+    }
+}
+
+uint64_t cache_storage::append_record(uint8_t type, const string &url, const string &etag,
+    std::string_view body, int64_t cached_until, uint8_t flags)
+{
+    record_header_t header{};
+    header.magic = record_magic;
+    header.type = type;
+    header.flags = flags;
+    header.url_size = (uint32_t)url.size();
+    header.etag_size = (uint32_t)etag.size();
+    header.body_size = (uint32_t)body.size();
+    header.crc = get_crc(url, etag, body);
+    header.cached_until = cached_until;
+
+    // the record is assembled in one buffer to be written with one call, so a crash
+    // cannot leave the header without the data on disk
+    string buffer;
+    buffer.reserve(get_record_size(url.size(), etag.size(), body.size()));
+    buffer.append((const char*)&header, sizeof(header));
+    buffer.append(url);
+    buffer.append(etag);
+    buffer.append(body);
+
+    auto offset = file.get_size();
+    if (!file.append(buffer.data(), buffer.size()))
+    {
+        log::global->error("Could not write to the http cache file, {}", utils::get_last_system_error());
+        return 0;
+    }
+
+    if (type != index_record)
+        unindexed_size += buffer.size();
+
+    return offset + buffer.size() - body.size();
+}
+
+const cache_storage::record_t* cache_storage::find(const string &url) const
+{
+    if (auto it = index.find(url); it != index.end())
+        return &it->second;
+    return nullptr;
+}
+
+string cache_storage::read_body(const record_t &record)
+{
+    const char *body = file.view(record.body_offset, record.body_size);
+    if (body == nullptr)
+        throw std::runtime_error("the cached body is out of the file bounds");
+
+    return string(body, record.body_size);
+}
+
+bool cache_storage::put(const string &url, const string &etag, const string &body,
+    clock_t::time_point cached_until, bool is_compressed)
+{
+    auto body_offset = append_record(entry_record, url, etag, body,
+        to_storage_time(cached_until), is_compressed ? compressed_flag : 0);
+
+    if (body_offset == 0)
+        return false;
+
+    auto &record = index[url];
+    if (record.body_offset != 0)
+        live_size -= get_record_size(url.size(), record.etag.size(), record.body_size);
+
+    record = { etag, cached_until, body_offset, (uint32_t)body.size(), is_compressed };
+
+    live_size += get_record_size(url.size(), etag.size(), body.size());
+    is_dirty = true;
+
+    return true;
+}
+
+bool cache_storage::set_cached_until(const string &url, clock_t::time_point cached_until)
+{
+    auto it = index.find(url);
+    if (it == index.end())
+        return false;
+
+    if (it->second.cached_until == cached_until)
+        return true;
+
+    if (append_record(expiry_record, url, "", {}, to_storage_time(cached_until), 0) == 0)
+        return false;
+
+    it->second.cached_until = cached_until;
+    is_dirty = true;
+
+    return true;
+}
+
+bool cache_storage::remove(const string &url)
+{
+    auto it = index.find(url);
+    if (it == index.end())
+        return false;
+
+    if (append_record(removal_record, url, "", {}, 0, 0) == 0)
+        return false;
+
+    live_size -= get_record_size(url.size(), it->second.etag.size(), it->second.body_size);
+    index.erase(it);
+    is_dirty = true;
+
+    return true;
+}
+
+void cache_storage::for_each(std::function<void(const string &url, const record_t &record)> visitor) const
+{
+    for (const auto &[url, record]: index)
+        visitor(url, record);
+}
+
+void cache_storage::clear()
+{
+    if (!reset())
+        log::global->error("Could not clear the http cache file, {}", utils::get_last_system_error());
+}
+
+bool cache_storage::write_index()
+{
+    auto offset = append_index();
+    if (offset == 0)
+        return false;
+
+    file.flush();
+
+    return commit_index(offset, generation);
+}
+
+bool cache_storage::is_checkpoint_needed() const
+{
+    return unindexed_size >= checkpoint_size ||
+        (unindexed_size > 0 && clock_t::now() - last_checkpoint >= checkpoint_interval);
+}
+
+uint64_t cache_storage::append_index()
+{
+    string body;
+    for (const auto &[url, record]: index)
+    {
+        index_entry_t entry{
+            to_storage_time(record.cached_until), record.body_offset, record.body_size,
+            (uint32_t)url.size(), (uint32_t)record.etag.size(),
+            record.is_compressed ? compressed_flag : 0u
+        };
+
+        body.append((const char*)&entry, sizeof(entry));
+        body.append(url);
+        body.append(record.etag);
+    }
+
+    auto body_offset = append_record(index_record, "", "", body, 0, 0);
+    if (body_offset == 0)
+        return 0;
+
+    index_record_size = get_record_size(0, 0, body.size());
+    unindexed_size = 0;
+    last_checkpoint = clock_t::now();
+    is_dirty = false;
+
+    return body_offset - sizeof(record_header_t);
+}
+
+void cache_storage::sync()
+{
+    file.flush();
+}
+
+bool cache_storage::commit_index(uint64_t offset, uint64_t generation)
+{
+    // the file could be reopened or cleared while the data was being flushed
+    if (generation != this->generation)
+        return false;
+
+    // the offset is some caller's mistake otherwise
+    const auto *rh = (const record_header_t*)file.view(offset, sizeof(record_header_t));
+    if (rh == nullptr || rh->magic != record_magic || rh->type != index_record)
+        return false;
+
+    // the header is updated only after the index is written completely
+    return file.write_at(offsetof(file_header_t, index_offset), &offset, sizeof(offset));
+}
+
+bool cache_storage::is_compaction_needed() const
+{
+    auto stats = get_stats();
+    return stats.file_size >= min_compaction_size && stats.dead_size >= live_size;
+}
+
+bool cache_storage::compact_if_needed()
+{
+    if (!is_compaction_needed())
+        return false;
+
+    return compact();
+}
+
+bool cache_storage::compact()
+{
+    auto compaction = begin_compaction();
+    write_compaction(*compaction);
+    return finish_compaction(*compaction);
+}
+
+std::unique_ptr<cache_storage::compaction_t> cache_storage::begin_compaction() const
+{
+    auto compaction = std::make_unique<compaction_t>();
+    compaction->filepath = filepath;
+    compaction->tmp_filepath = std::filesystem::path(filepath).concat(".tmp");
+    compaction->index = index;
+    compaction->generation = generation;
+    compaction->file_size = file.get_size();
+
+    return compaction;
+}
+
+bool cache_storage::write_compaction(compaction_t &compaction)
+{
+    auto &compacted = compaction.compacted;
+    compacted = std::make_unique<cache_storage>();
+
+    // all the live records are copied into a new file, the bodies are copied as is; the
+    // storage file keeps growing meanwhile, but the snapshot's records are not changed
+    auto write_compacted = [&compaction, &compacted]
+    {
+        mapped_file reader;
+        if (!reader.open(compaction.filepath, true) || !compacted->open(compaction.tmp_filepath) ||
+            !compacted->reset())
+            return false;
+
+        string body;
+        for (const auto &[url, record]: compaction.index)
+        {
+            body.resize(record.body_size);
+            if (!reader.read_at(record.body_offset, body.data(), body.size()) ||
+                !compacted->put(url, record.etag, body, record.cached_until, record.is_compressed))
+                return false;
+        }
+        return true;
+    };
+
+    try
+    {
+        if (write_compacted())
+            return true;
+
+        log::global->error("Could not compact the http cache file, {}", utils::get_last_system_error());
+    }
+    catch (const std::exception &ex)
+    {
+        log::global->error("Could not compact the http cache file, {}", ex.what());
+    }
+
+    discard_compaction(compaction);
+    return false;
+}
+
+bool cache_storage::finish_compaction(compaction_t &compaction)
+{
+    auto &compacted = compaction.compacted;
+    if (compacted == nullptr)
+        return false;
+
+    // the file has been started over, the snapshot is of no use anymore
+    if (compaction.generation != generation || compaction.filepath != filepath)
+    {
+        discard_compaction(compaction);
+        return false;
+    }
+
+    // the records written after the snapshot are caught up: a stored response has got a new
+    // body offset, the ones not in the index anymore are removed
+    auto catch_up = [this, &compaction, &compacted]
+    {
+        for (const auto &[url, record]: index)
+        {
+            const auto it = compaction.index.find(url);
+            if (it == compaction.index.end() || it->second.body_offset != record.body_offset)
+            {
+                if (!compacted->put(url, record.etag, read_body(record), record.cached_until, record.is_compressed))
+                    return false;
+            }
+            else if (it->second.cached_until != record.cached_until)
+            {
+                if (!compacted->set_cached_until(url, record.cached_until))
+                    return false;
+            }
+        }
+
+        for (const auto &[url, record]: compaction.index)
+            if (!index.contains(url) && !compacted->remove(url))
+                return false;
+
+        return compacted->write_index();
+    };
+
+    try
+    {
+        if (!catch_up())
+            throw std::runtime_error(utils::get_last_system_error());
+    }
+    catch (const std::exception &ex)
+    {
+        log::global->error("Could not compact the http cache file, {}", ex.what());
+        discard_compaction(compaction);
+        return false;
+    }
+
+    compacted.reset();
+
+    // the old file is closed with no index written, it is going to be replaced anyway
+    file.close();
+
+    std::error_code ec;
+    std::filesystem::rename(compaction.tmp_filepath, filepath, ec);
+    if (ec)
+        log::global->error("Could not replace the http cache file with the compacted one, {}", ec.message());
+
+    // the storage is reopened in any case: either the compacted file or the old one
+    is_dirty = false;
+    if (!open(filepath))
+        return false;
+
+    log::global->info("The http cache file is compacted, {} -> {} bytes", compaction.file_size, file.get_size());
+    return !ec;
+}
+
+void cache_storage::discard_compaction(compaction_t &compaction)
+{
+    compaction.compacted.reset();
+
+    std::error_code ec;
+    std::filesystem::remove(compaction.tmp_filepath, ec);
+}
+
+cache_storage::stats_t cache_storage::get_stats() const
+{
+    uint64_t used = sizeof(file_header_t) + live_size + index_record_size;
+    uint64_t size = file.get_size();
+
+    return { index.size(), size, live_size, size > used ? size - used : 0 };
+}
+
+} // namespace spotify
+} // namespace spotifar
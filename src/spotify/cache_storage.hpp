@@ -0,0 +1,231 @@
+#ifndef CACHE_STORAGE_HPP_5B7E1A64_0C2D_4E8B_A3F1_6D9C2B4E7F10
+#define CACHE_STORAGE_HPP_5B7E1A64_0C2D_4E8B_A3F1_6D9C2B4E7F10
+#pragma once
+
+#include "stdafx.h"
+#include "utils.hpp"
+
+namespace spotifar { namespace spotify {
+
+/// @brief A portable (Win32/POSIX) read-write file with a read-only memory mapping
+/// of its content. The file is written with the regular file api, the mapping is
+/// re-created lazily, once the requested range goes beyond the mapped size
+/// @note the class is not thread-safe
+class TEST_API mapped_file
+{
+public:
+    mapped_file() {}
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    /// @brief Opens the file for reading and writing, creates it if does not exist
+    /// @param read_only the file is opened only for reading, a missing file is not created;
+    /// the file can be opened this way while it is opened for writing
+    bool open(const std::filesystem::path &filepath, bool read_only = false);
+    void close();
+    bool is_open() const;
+
+    auto get_size() const -> uint64_t { return file_size; }
+
+    /// @brief Returns a pointer to the `size` bytes of the file content starting from the `offset`,
+    /// or nullptr if the range is out of the file. The pointer is valid until the next call
+    /// to any non-const method
+    auto view(uint64_t offset, uint64_t size) -> const char*;
+
+    /// @brief Reads `size` bytes at the given `offset` without mapping them, so the file
+    /// cut off meanwhile gives an error instead of a fault
+    bool read_at(uint64_t offset, void *data, size_t size) const;
+
+    /// @brief Appends the given `data` to the end of file
+    bool append(const void *data, size_t size);
+
+    /// @brief Overwrites the file content at the given `offset`
+    bool write_at(uint64_t offset, const void *data, size_t size);
+
+    /// @brief Cuts the file down to the given `size`
+    bool truncate(uint64_t size);
+
+    /// @brief Flushes the written data to the disk
+    void flush();
+private:
+    bool map();
+    void unmap();
+private:
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int file = -1;
+#endif
+    const char *mapped = nullptr;
+    uint64_t mapped_size = 0;
+    uint64_t file_size = 0;
+};
+
+
+/// @brief An on-disk storage of the http responses cache: a binary append-only log file
+/// with the in-memory index of the stored responses.
+///
+/// The file consists of a fixed header and a sequence of records. Each stored response
+/// is appended as a new record: url, etag, expiration time and the body; the validity time
+/// updates are appended as small body-less records. From time to time the whole index is
+/// appended as a record as well, the header keeps the offset of the latest one. So, the
+/// loading is reading the latest index record and replaying only the records written after
+/// it, the bodies are not read at all, they are paged in from the mapped file on demand.
+/// A crash loses only the record being written at the moment, which is cut off on loading.
+/// The index is checkpointed periodically, so the replay after a crash stays short.
+///
+/// The overwritten records are not removed from the file, once the amount of such dead
+/// space exceeds the live data, the file is compacted: all the live records are copied
+/// to a new file, which replaces the old one. The bodies are copied from a snapshot of
+/// the index, see `begin_compaction`, so the storage can be used meanwhile
+/// @note the class is not thread-safe
+class TEST_API cache_storage
+{
+public:
+    struct record_t
+    {
+        string etag;
+        utils::clock_t::time_point cached_until{};
+        uint64_t body_offset = 0; // an offset of the body within the file
+        uint32_t body_size = 0;
+        bool is_compressed = false;
+    };
+
+    struct stats_t
+    {
+        size_t entries = 0;
+        uint64_t file_size = 0;
+        uint64_t live_size = 0; // the size of the records of the stored responses
+        uint64_t dead_size = 0; // the size of the overwritten records, freed by compaction
+    };
+
+    /// @brief A compaction in progress, see `begin_compaction`
+    struct compaction_t
+    {
+        std::filesystem::path filepath, tmp_filepath;
+        std::unordered_map<string, record_t> index; // the snapshot the bodies are copied by
+        uint64_t generation = 0; // the file is started over, once it is changed
+        uint64_t file_size = 0;
+        std::unique_ptr<cache_storage> compacted; // empty, if the copying has failed
+    };
+public:
+    ~cache_storage() { close(); }
+
+    /// @brief Opens the storage file and loads its index, a broken or incompatible file
+    /// is started over from scratch
+    bool open(const std::filesystem::path &filepath);
+
+    /// @brief Saves the index, if there were any changes, and closes the file
+    void close();
+
+    bool is_open() const { return file.is_open(); }
+
+    /// @brief Returns the stored record metadata for the `url`, or nullptr
+    auto find(const string &url) const -> const record_t*;
+
+    /// @brief Reads the body of the given `record` from the file
+    auto read_body(const record_t &record) -> string;
+
+    /// @brief Stores the response for the `url`, replacing the existing one
+    bool put(const string &url, const string &etag, const string &body,
+        utils::clock_t::time_point cached_until, bool is_compressed);
+
+    /// @brief Updates the validity time of the stored `url` response
+    bool set_cached_until(const string &url, utils::clock_t::time_point cached_until);
+
+    /// @brief Removes the stored `url` response, its space is freed by the next compaction
+    bool remove(const string &url);
+
+    /// @brief Calls the `visitor` for each of the stored urls; used for the bulk updates
+    void for_each(std::function<void(const string &url, const record_t &record)> visitor) const;
+
+    /// @brief Removes all the stored responses
+    void clear();
+
+    /// @brief Appends the current index to the file, so the next loading does not
+    /// need to replay the records written before
+    bool write_index();
+
+    /// @brief Whether there are enough records written since the last index, or enough
+    /// time has passed, to make a checkpoint
+    bool is_checkpoint_needed() const;
+
+    /// @brief The first step of the checkpoint: appends the current index to the file,
+    /// returns its offset or 0 on error. The index is not used on loading, until it is
+    /// committed, see `commit_index`
+    auto append_index() -> uint64_t;
+
+    /// @brief Returns the file's generation, it changes every time the file is opened
+    /// or started over, so the offsets taken before are not valid anymore
+    auto get_generation() const -> uint64_t { return generation; }
+
+    /// @brief The second step of the checkpoint: flushes all the written data to the disk.
+    /// The only method, which can be called concurrently with the others (except `open`,
+    /// `close` and the compaction ones), as it is the slowest one
+    void sync();
+
+    /// @brief The last step of the checkpoint: points the file header to the index at the
+    /// given `offset`, if the file is still of the `generation` the index was appended to
+    bool commit_index(uint64_t offset, uint64_t generation);
+
+    /// @brief Whether the overwritten records take more space than the live ones
+    bool is_compaction_needed() const;
+
+    /// @brief Compacts the file if needed, all the steps at once.
+    /// Returns `true` if the compaction took place
+    bool compact_if_needed();
+
+    /// @brief Rewrites the file with only the live records, all the steps at once
+    bool compact();
+
+    /// @brief The first step of the compaction: takes a snapshot of the index to copy
+    auto begin_compaction() const -> std::unique_ptr<compaction_t>;
+
+    /// @brief The second step of the compaction: copies the snapshot's records into a new
+    /// file, reading the storage file with its own handle. Does not touch the storage
+    /// object, so it can be called concurrently with any of its methods (except `open`,
+    /// `close` and the compaction ones), as it is the slowest one
+    static bool write_compaction(compaction_t &compaction);
+
+    /// @brief The last step of the compaction: copies the records changed since the snapshot
+    /// and replaces the storage file with the compacted one; the compaction is dropped, if
+    /// the file has been started over meanwhile
+    bool finish_compaction(compaction_t &compaction);
+
+    auto get_stats() const -> stats_t;
+private:
+    /// @brief Starts the file over: truncates it and writes a fresh header
+    bool reset();
+
+    /// @brief Reads the index record at the given `offset`, returns `false` if it is broken
+    bool read_index(uint64_t offset);
+
+    /// @brief Applies the records starting from `offset` to the index, cuts the broken tail off
+    void replay(uint64_t offset);
+
+    /// @brief Removes the compacted file of the failed or dropped `compaction`
+    static void discard_compaction(compaction_t &compaction);
+
+    /// @brief Appends a record to the file, returns the offset of its body or 0 on error
+    auto append_record(uint8_t type, const string &url, const string &etag,
+        std::string_view body, int64_t cached_until, uint8_t flags) -> uint64_t;
+private:
+    std::filesystem::path filepath;
+    mapped_file file;
+    std::unordered_map<string, record_t> index;
+
+    uint64_t live_size = 0; // the size of all the records the index refers to
+    uint64_t index_record_size = 0; // the size of the latest saved index record
+    uint64_t unindexed_size = 0; // the size of the records written after the latest index
+    utils::clock_t::time_point last_checkpoint{};
+    uint64_t generation = 0; // incremented every time the file is opened or started over
+    bool is_dirty = false;
+};
+
+} // namespace spotify
+} // namespace spotifar
+
+#endif // CACHE_STORAGE_HPP_5B7E1A64_0C2D_4E8B_A3F1_6D9C2B4E7F10
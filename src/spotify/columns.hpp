@@ -0,0 +1,229 @@
+#ifndef COLUMNS_HPP_A4E1F0C7_2B6D_4D83_9F15_7C0B3E96D2A8
+#define COLUMNS_HPP_A4E1F0C7_2B6D_4D83_9F15_7C0B3E96D2A8
+#pragma once
+
+#include "stdafx.h"
+
+#include <bit>
+
+namespace spotifar { namespace spotify {
+
+/// @brief A columnar copy of the tracks' sorting keys for the big lists: every column is
+/// a contiguous array of `uint32_t` keys ordered the same way the tracks' fields are, so
+/// sorting compares two integers instead of chasing into the tracks' albums and artists.
+/// The strings are interned into their ranks among the column's unique values; the albums
+/// and the artists shared by the tracks are ranked once per record. The tracks' own names
+/// are not a column: they are unique mostly, so ranking them costs as much as sorting by them.
+/// @note The store keeps the pointers to the tracks, it is rebuilt together with the list;
+/// a column is built on its first use
+/// @tparam T a track type, `track_t` or the type of the same shape
+template<class T>
+class tracks_columns_t
+{
+public:
+    enum column_t: uint8_t
+    {
+        artist,
+        album,
+        release_date, // YYYYMMDD
+        duration, // in ms
+        popularity,
+        columns_count,
+    };
+
+    /// @param tracks the tracks in the order of the rows
+    explicit tracks_columns_t(std::vector<const T*> tracks): tracks(std::move(tracks))
+    {
+        index_rows();
+    }
+
+    auto size() const -> size_t { return tracks.size(); }
+
+    /// @brief Returns the row of the given `track` or `npos` if it is not in the store
+    auto find_row(const T *track) const -> size_t
+    {
+        if (stride > 0)
+        {
+            // the offset is divided by the stride exactly, multiplying it by the inverse of the
+            // stride's odd part; an offset not divisible by it gives a row out of the range
+            const auto offset = (uint64_t)(int64_t)((const char*)track - (const char*)tracks[0]);
+            const auto row = (offset >> stride_shift) * stride_inverse;
+            if ((offset & ((1ull << stride_shift) - 1)) == 0 && row < tracks.size())
+                return (size_t)row;
+            return npos;
+        }
+
+        if (auto it = rows.find(track); it != rows.end())
+            return it->second;
+        return npos;
+    }
+
+    /// @brief Returns the column's keys in the order of the rows, building them on demand
+    auto get_keys(column_t column) -> const std::vector<uint32_t>&
+    {
+        auto &keys = columns[column];
+        if (keys.size() != tracks.size())
+            build_column(column, keys);
+        return keys;
+    }
+
+    /// @brief Compares the tracks by the `column` in the same way their fields are compared,
+    /// returns -2 if any of them is not in the store
+    auto compare(column_t column, const T *track1, const T *track2) -> int
+    {
+        const auto row1 = find_row(track1), row2 = find_row(track2);
+        if (row1 == npos || row2 == npos)
+            return -2;
+
+        const auto &keys = get_keys(column);
+        return keys[row1] < keys[row2] ? -1 : keys[row1] > keys[row2] ? 1 : 0;
+    }
+
+    static constexpr size_t npos = (size_t)-1;
+private:
+    /// @brief The lists of the collections are contiguous, so the row is found by the track's
+    /// offset from the first one; the other lists are indexed with a map
+    void index_rows()
+    {
+        if (tracks.size() > 1)
+        {
+            const auto step = (const char*)tracks[1] - (const char*)tracks[0];
+            bool is_contiguous = step > 0;
+            for (size_t row = 2; row < tracks.size() && is_contiguous; ++row)
+                is_contiguous = (const char*)tracks[row] - (const char*)tracks[0] == step * (ptrdiff_t)row;
+
+            if (is_contiguous)
+            {
+                stride = step;
+                stride_shift = std::countr_zero((uint64_t)step);
+
+                // Newton's iterations double the correct low bits of the inverse every time,
+                // the odd number is its own inverse modulo 8
+                const auto odd = (uint64_t)step >> stride_shift;
+                stride_inverse = odd;
+                for (size_t i = 0; i < 5; ++i)
+                    stride_inverse *= 2 - odd * stride_inverse;
+                return;
+            }
+        }
+
+        rows.reserve(tracks.size());
+        for (size_t row = 0; row < tracks.size(); ++row)
+            rows.emplace(tracks[row], (uint32_t)row);
+    }
+
+    void build_column(column_t column, std::vector<uint32_t> &keys) const
+    {
+        keys.resize(tracks.size());
+
+        switch (column)
+        {
+            case artist:
+            {
+                // the tracks without artists are sorted by the name of the default one
+                using artist_t = std::decay_t<decltype(tracks[0]->get_artist())>;
+                const auto unknown = artist_t{}.name;
+
+                rank_strings(keys,
+                    [this](size_t row) -> const void*
+                    {
+                        const auto &artists = tracks[row]->artists;
+                        return artists.empty() ? nullptr : &*artists[0];
+                    },
+                    [this, &unknown](size_t row)
+                    {
+                        const auto &artists = tracks[row]->artists;
+                        return std::wstring_view(artists.empty() ? unknown : artists[0]->name);
+                    });
+                break;
+            }
+            case album:
+                rank_strings(keys, [this](size_t row) -> const void* { return &*tracks[row]->album; },
+                    [this](size_t row) { return std::wstring_view(tracks[row]->album->name); });
+                break;
+
+            case release_date:
+                for (size_t row = 0; row < tracks.size(); ++row)
+                    keys[row] = parse_date(tracks[row]->album->release_date);
+                break;
+
+            case duration:
+                for (size_t row = 0; row < tracks.size(); ++row)
+                    keys[row] = (uint32_t)tracks[row]->duration_ms;
+                break;
+
+            case popularity:
+                for (size_t row = 0; row < tracks.size(); ++row)
+                    keys[row] = (uint32_t)tracks[row]->popularity;
+                break;
+
+            case columns_count:
+                break;
+        }
+    }
+
+    /// @brief Replaces every string with its rank among the unique ones, the equal strings
+    /// get the same rank, so the keys compare the same way the strings do
+    /// @param get_record returns the record holding the row's string, the string is taken
+    /// once per record, e.g. once per album for all its tracks
+    template<class R, class S>
+    void rank_strings(std::vector<uint32_t> &keys, R get_record, S get_string) const
+    {
+        std::unordered_map<const void*, uint32_t> records;
+        std::vector<std::wstring_view> strings;
+        std::vector<uint32_t> record_of_row(tracks.size());
+
+        records.reserve(tracks.size());
+        for (size_t row = 0; row < tracks.size(); ++row)
+        {
+            auto [it, is_new] = records.emplace(get_record(row), (uint32_t)strings.size());
+            if (is_new)
+                strings.push_back(get_string(row));
+            record_of_row[row] = it->second;
+        }
+
+        std::vector<uint32_t> order(strings.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(),
+            [&strings](uint32_t l, uint32_t r) { return strings[l] < strings[r]; });
+
+        std::vector<uint32_t> ranks(strings.size());
+        for (uint32_t idx = 0, rank = 0; idx < order.size(); ++idx)
+        {
+            if (idx > 0 && strings[order[idx]] != strings[order[idx - 1]])
+                ++rank;
+            ranks[order[idx]] = rank;
+        }
+
+        for (size_t row = 0; row < tracks.size(); ++row)
+            keys[row] = ranks[record_of_row[row]];
+    }
+
+    /// @brief The albums' dates are padded to the full "YYYY-MM-DD" ones while being read,
+    /// the rest of the strings are kept ordered before them
+    static auto parse_date(std::string_view date) -> uint32_t
+    {
+        if (date.size() != 10 || date[4] != '-' || date[7] != '-')
+            return 0;
+
+        uint32_t result = 0;
+        for (size_t idx: { 0, 1, 2, 3, 5, 6, 8, 9 })
+        {
+            if (date[idx] < '0' || date[idx] > '9')
+                return 0;
+            result = result * 10 + (uint32_t)(date[idx] - '0');
+        }
+        return result;
+    }
+
+    std::vector<const T*> tracks;
+    std::array<std::vector<uint32_t>, columns_count> columns;
+    std::unordered_map<const T*, uint32_t> rows;
+    ptrdiff_t stride = 0;
+    uint64_t stride_shift = 0, stride_inverse = 1;
+};
+
+} // namespace spotify
+} // namespace spotifar
+
+#endif // COLUMNS_HPP_A4E1F0C7_2B6D_4D83_9F15_7C0B3E96D2A8
@@ -48,7 +48,7 @@ void devices_cache::transfer_playback(const item_id_t &device_id, bool start_pla
     if (device_it->is_active)
         return playback_cmd_error("The given device is already active, {}", device_it->to_str());
     
-    api_proxy->get_pool().detach_task(
+    detach_prioritized_task(api_proxy->get_pool(), request_priority::playback,
         [
             this, start_playing, dev_id = std::as_const(device_id),
             dev_idx = std::distance(devices.begin(), device_it)
@@ -28,6 +28,7 @@ protected:
     bool request_data(devices_t &data) override;
     void on_data_synced(const devices_t &data, const devices_t &prev_data) override;
     auto get_sync_interval() const -> clock_t::duration override;
+    auto get_resync_priority() const -> request_priority override { return request_priority::playback; }
 
 private:
     api_interface *api_proxy;
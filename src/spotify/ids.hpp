@@ -0,0 +1,181 @@
+#ifndef IDS_HPP_59FB60CB_DAC7_4BB3_85F3_0B6DB90E2633
+#define IDS_HPP_59FB60CB_DAC7_4BB3_85F3_0B6DB90E2633
+#pragma once
+
+#include "stdafx.h"
+
+#if defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#   include <intrin.h> // _umul128
+#endif
+
+namespace spotifar { namespace spotify {
+
+/// @brief A compact value of the Spotify ID. The ID is a 128-bit number written as 22 chars
+/// of base62, so it is kept as the number itself: 16 bytes inline instead of a heap-allocated
+/// string, compared with two integer comparisons and hashed without walking the chars.
+/// @note Only the tracks', albums', artists' and playlists' ids are base62; the devices' ones
+/// and the other item ids stay `item_id_t` strings. A zero value stands for an invalid id
+class spotify_id_t
+{
+public:
+    static constexpr size_t length = 22;
+
+    constexpr spotify_id_t() = default;
+
+    /// @brief Parses the given `id`, an invalid one gives an invalid value
+    constexpr explicit spotify_id_t(std::string_view id)
+    {
+        if (auto parsed = parse(id))
+            *this = *parsed;
+    }
+
+    /// @brief Parses the base62 `id`, returns nothing if it is not a valid one
+    static constexpr auto parse(std::string_view id) -> std::optional<spotify_id_t>
+    {
+        if (id.size() != length)
+            return std::nullopt;
+
+        // the digits are taken by ten, so the whole number is multiplied only three times:
+        // by 62^2 and by 62^10 twice
+        uint64_t high = 0, low = 0;
+        for (size_t pos = 0; pos < length;)
+        {
+            const auto count = pos == 0 ? length % parse_chunk_length : parse_chunk_length;
+
+            uint64_t chunk = 0, multiplier = 1;
+            for (size_t i = 0; i < count; ++i, ++pos)
+            {
+                const auto digit = digits[(uint8_t)id[pos]];
+                if (digit < 0)
+                    return std::nullopt;
+
+                chunk = chunk * base + (uint64_t)digit;
+                multiplier *= base;
+            }
+
+            uint64_t low_carry = 0, high_overflow = 0;
+            low = multiply(low, multiplier, low_carry);
+            high = multiply(high, multiplier, high_overflow);
+
+            low += chunk;
+            low_carry += low < chunk;
+            high += low_carry;
+
+            // the number does not fit 128 bits
+            if (high_overflow != 0 || high < low_carry)
+                return std::nullopt;
+        }
+        return spotify_id_t(high, low);
+    }
+
+    constexpr bool is_valid() const { return high != 0 || low != 0; }
+    constexpr explicit operator bool() const { return is_valid(); }
+
+    /// @brief Writes the id back in base62 for building urls and uris, an invalid id gives
+    /// an empty string, the same as `invalid_id`
+    auto to_string() const -> string
+    {
+        if (!is_valid())
+            return "";
+
+        string result(length, alphabet[0]);
+        uint64_t limbs[4] = { low & 0xFFFFFFFF, low >> 32, high & 0xFFFFFFFF, high >> 32 };
+
+        // every division by 62^5 gives the next five digits at once
+        for (size_t idx = length; idx > 0;)
+        {
+            uint64_t remainder = 0;
+            for (size_t l = 4; l-- > 0;)
+            {
+                const auto value = remainder << 32 | limbs[l];
+                limbs[l] = value / print_chunk_base;
+                remainder = value % print_chunk_base;
+            }
+
+            for (size_t i = 0; i < print_chunk_length && idx > 0; ++i, remainder /= base)
+                result[--idx] = alphabet[remainder % base];
+        }
+        return result;
+    }
+
+    /// @brief The ids are random numbers already, both halves are folded and finalized
+    /// with the murmur3 mixer, so every bit of the id affects the result
+    constexpr auto get_hash() const -> size_t
+    {
+        auto h = low ^ (high * 0x9E3779B97F4A7C15ull);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return (size_t)h;
+    }
+
+    constexpr auto operator<=>(const spotify_id_t&) const = default;
+private:
+    constexpr spotify_id_t(uint64_t h, uint64_t l): high(h), low(l) {}
+
+    /// @brief Returns the lower half of `a * b`, the upper one goes to `high`
+    static constexpr auto multiply(uint64_t a, uint64_t b, uint64_t &high) -> uint64_t
+    {
+#if defined(__SIZEOF_INT128__)
+        const auto product = (unsigned __int128)a * b;
+        high = (uint64_t)(product >> 64);
+        return (uint64_t)product;
+#else
+    #if defined(_M_X64)
+        if (!std::is_constant_evaluated())
+            return _umul128(a, b, &high);
+    #endif
+        const auto
+            a_low = a & 0xFFFFFFFF, a_high = a >> 32,
+            b_low = b & 0xFFFFFFFF, b_high = b >> 32;
+
+        const auto
+            low_low = a_low * b_low, low_high = a_low * b_high,
+            high_low = a_high * b_low, high_high = a_high * b_high;
+
+        const auto middle = (low_low >> 32) + (low_high & 0xFFFFFFFF) + (high_low & 0xFFFFFFFF);
+
+        high = high_high + (low_high >> 32) + (high_low >> 32) + (middle >> 32);
+        return middle << 32 | (low_low & 0xFFFFFFFF);
+#endif
+    }
+
+    static constexpr uint64_t base = 62;
+    static constexpr size_t parse_chunk_length = 10;
+    static constexpr size_t print_chunk_length = 5;
+    static constexpr uint64_t print_chunk_base = base * base * base * base * base;
+    static constexpr char alphabet[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    /// @brief The chars' values in base62, -1 for the ones out of the alphabet
+    static constexpr auto digits = []
+    {
+        std::array<int8_t, 256> digits{};
+        digits.fill(-1);
+        for (size_t idx = 0; idx < base; ++idx)
+            digits[(uint8_t)alphabet[idx]] = (int8_t)idx;
+        return digits;
+    }();
+
+    uint64_t high = 0, low = 0;
+};
+
+static_assert(sizeof(spotify_id_t) == 16);
+static_assert(spotify_id_t("6rqhFgbbKwnb9MLmUQDhG6").is_valid());
+static_assert(!spotify_id_t("6rqhFgbbKwnb9MLmUQDhG").is_valid());
+static_assert(!spotify_id_t("6rqhFgbbKwnb9MLmUQDh-6").is_valid());
+
+} // namespace spotify
+} // namespace spotifar
+
+template<>
+struct std::hash<spotifar::spotify::spotify_id_t>
+{
+    std::size_t operator()(const spotifar::spotify::spotify_id_t &id) const noexcept
+    {
+        return id.get_hash();
+    }
+};
+
+#endif // IDS_HPP_59FB60CB_DAC7_4BB3_85F3_0B6DB90E2633
@@ -4,29 +4,37 @@
 
 #include "stdafx.h"
 #include "items.hpp"
+#include "transport.hpp"
 
 namespace spotifar { namespace spotify {
 
-template<class T, int N = 0, class C = utils::clock_t::duration>
+/// @brief A way the requesters treat the expired cached responses
+enum class cache_policy
+{
+    revalidate, // the caller waits for the conditional request to the server
+    stale_while_revalidate, // the stale response is returned at once and revalidated in the background
+};
+
+template<class T, int N = 0, class C = utils::clock_t::duration, cache_policy P = cache_policy::revalidate>
 class item_requester;
 
 template<class T, int N, class C, class ContainerT = std::vector<T>>
 class several_items_requester;
 
-template<class T, int N = 0, class C = utils::clock_t::duration>
+template<class T, int N = 0, class C = utils::clock_t::duration, cache_policy P = cache_policy::revalidate>
 class sync_collection;
 
-template<class T, int N = 0, class C = utils::clock_t::duration>
+template<class T, int N = 0, class C = utils::clock_t::duration, cache_policy P = cache_policy::revalidate>
 class async_collection;
 
 
 using followed_artists_t = sync_collection<artist_t, -1>;
 using followed_artists_ptr = std::shared_ptr<followed_artists_t>;
 
-using saved_albums_t = async_collection<saved_album_t, 1, std::chrono::days>;
+using saved_albums_t = async_collection<saved_album_t, 1, std::chrono::days, cache_policy::stale_while_revalidate>;
 using saved_albums_ptr = std::shared_ptr<saved_albums_t>;
 
-using saved_tracks_t = async_collection<saved_track_t, 1, std::chrono::days>;
+using saved_tracks_t = async_collection<saved_track_t, 1, std::chrono::days, cache_policy::stale_while_revalidate>;
 using saved_tracks_ptr = std::shared_ptr<saved_tracks_t>;
 
 using saved_playlists_t = async_collection<simplified_playlist_t, -1>;
@@ -219,6 +227,15 @@ struct api_interface
     /// @param resync forces cache to get resynced beforehand
     virtual auto get_devices_cache(bool resync = false) -> devices_cache_interface* = 0;
 
+    /// @brief Returns the http responses cache, for the stats and maintenance
+    virtual auto get_http_cache() -> http_cache* = 0;
+
+    /// @brief Returns the cache of the objects parsed from the http cache responses
+    virtual auto get_objects_cache() -> objects_cache* = 0;
+
+    /// @brief Returns the registry of the collections' items, shared by the collection objects
+    virtual auto get_collections() -> collections_registry* = 0;
+
     /// @brief https://developer.spotify.com/documentation/web-api/reference/get-an-artists-top-tracks
     virtual auto get_artist_top_tracks(const item_id_t &artist_id) -> std::vector<track_t> = 0;
 
@@ -314,7 +331,10 @@ struct api_interface
 //protected:
     /// @brief Performs an HTTP GET request
     /// @param cache_for caches the response for the given amount of time
-    virtual httplib::Result get(const string &url, utils::clock_t::duration cache_for = {}, bool retry_429 = false) = 0;
+    /// @param allow_stale an expired cached response is returned right away with no request
+    /// performed, marked as stale; the caller is responsible for its revalidation
+    virtual httplib::Result get(const string &url, utils::clock_t::duration cache_for = {},
+        bool retry_429 = false, bool allow_stale = false) = 0;
 
     /// @brief Performs an HTTP PUT request
     virtual httplib::Result put(const string &url, const string &body = {}) = 0;
@@ -326,11 +346,13 @@ struct api_interface
     virtual httplib::Result post(const string &url, const string &body = {}) = 0;
 
     /// @brief Returns a reference to the internally allocated thread-pool. Used by
-    /// requesters to perform async request
-    virtual auto get_pool() -> BS::light_thread_pool& = 0;
+    /// requesters to perform async request; the tasks should be queued with the priority
+    /// of the requests they perform, see `get_pool_priority`
+    virtual auto get_pool() -> BS::priority_thread_pool& = 0;
 
     /// @brief Whether the given url is cached
-    virtual bool is_request_cached(const string &url) const = 0;
+    /// @param allow_stale the expired cached response counts as well
+    virtual bool is_request_cached(const string &url, bool allow_stale = false) const = 0;
 
     /// @brief Returns the given `endpoint_name` endpoint's busy status
     virtual bool is_endpoint_rate_limited(const string &endpoint_name) const = 0;
@@ -344,13 +366,13 @@ private:
 
     friend class del_requester;
 
-    template<class T, int N, class C>
+    template<class T, int N, class C, cache_policy P>
     friend class item_requester;
 
-    template<class T, int N, class C>
+    template<class T, int N, class C, cache_policy P>
     friend class sync_collection;
 
-    template<class T, int N, class C>
+    template<class T, int N, class C, cache_policy P>
     friend class async_collection;
 
     friend class search_requester;
@@ -1,4 +1,6 @@
 #include "items.hpp"
+#include "ids.hpp"
+#include "items_pool.hpp"
 #include "utils.hpp"
 #include "lng.hpp"
 
@@ -17,66 +19,65 @@ bool operator==(const data_item_t &lhs, const data_item_t &rhs)
     return lhs.id == rhs.id;
 }
 
+static constexpr auto image_fields = std::tuple{
+    schema::field("url", &image_t::url),
+    schema::field("width", &image_t::width),
+    schema::field("height", &image_t::height),
+};
+
 void from_json(const Value &j, image_t &i)
 {
-    i.url = j["url"].GetString();
-    i.width = j["width"].GetUint();
-    i.height = j["height"].GetUint();
+    schema::read(j, i, image_fields);
 }
 
 void to_json(Value &result, const image_t &i, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    result.AddMember("url", Value(i.url, allocator), allocator);
-    result.AddMember("width", Value(i.width), allocator);
-    result.AddMember("height", Value(i.height), allocator);
+    schema::write(result, i, image_fields, allocator);
 }
 
+static constexpr auto external_urls_fields = std::tuple{
+    schema::field("spotify", &external_urls_t::spotify),
+};
+
 void from_json(const json::Value &j, external_urls_t &e)
 {
-    e.spotify = j["spotify"].GetString();
+    schema::read(j, e, external_urls_fields);
 }
 
 void to_json(json::Value &result, const external_urls_t &e, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    result.AddMember("spotify", Value(e.spotify, allocator), allocator);
+    schema::write(result, e, external_urls_fields, allocator);
 }
 
+static constexpr auto copyrights_fields = std::tuple{
+    schema::field("type", &copyrights_t::type),
+    schema::field("text", &copyrights_t::text),
+};
+
 void from_json(const json::Value &j, copyrights_t &c)
 {
-    c.type = j["type"].GetString();
-    c.text = utils::utf8_decode(j["text"].GetString());
+    schema::read(j, c, copyrights_fields);
 }
 
 void to_json(json::Value &result, const copyrights_t &c, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    result.AddMember("type", Value(c.type, allocator), allocator);
-    result.AddMember("text", Value(utils::utf8_encode(c.text), allocator), allocator);
+    schema::write(result, c, copyrights_fields, allocator);
 }
 
+static constexpr auto simplified_artist_fields = std::tuple{
+    schema::field("id", &simplified_artist_t::id),
+    schema::field("name", &simplified_artist_t::name),
+    schema::field("external_urls", &simplified_artist_t::urls),
+};
+
 void from_json(const Value &j, simplified_artist_t &a)
 {
-    a.id = j["id"].GetString();
-    a.name = utils::utf8_decode(j["name"].GetString());
-    
-    from_json(j["external_urls"], a.urls);
+    schema::read(j, a, simplified_artist_fields);
 }
 
 void to_json(Value &result, const simplified_artist_t &a, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    Value urls;
-    to_json(urls, a.urls, allocator);
-
-    result.AddMember("id", Value(a.id, allocator), allocator);
-    result.AddMember("name", Value(utils::utf8_encode(a.name), allocator), allocator);
-    result.AddMember("external_urls", urls, allocator);
+    schema::write(result, a, simplified_artist_fields, allocator);
 }
 
 const image_t artist_t::get_image() const noexcept
@@ -84,40 +85,25 @@ const image_t artist_t::get_image() const noexcept
     return images.size() > 1 ? images[1] : image_t{};
 }
 
+static constexpr auto artist_fields = std::tuple_cat(simplified_artist_fields, std::tuple{
+    schema::field("popularity", &artist_t::popularity),
+    schema::object("followers", std::tuple{
+        schema::field("total", &artist_t::followers_total),
+    }),
+    schema::field("images", &artist_t::images),
+    schema::field("genres", &artist_t::genres),
+});
+
 void from_json(const Value &j, artist_t &a)
 {
-    from_json(j, dynamic_cast<simplified_artist_t&>(a));
-
-    a.popularity = j["popularity"].GetUint();
-    a.followers_total = j["followers"]["total"].GetUint();
-    
-    from_json(j["images"], a.images);
-    from_json(j["genres"], a.genres);
+    schema::read(j, a, artist_fields);
 }
 
 void to_json(Value &result, const artist_t &a, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    to_json(result, dynamic_cast<const simplified_artist_t&>(a), allocator);
-
-    Value genres;
-    to_json(genres, a.genres, allocator);
-
-    Value images;
-    to_json(images, a.images, allocator);
-    
-    auto followers = Value(json::kObjectType);
-    followers.AddMember("total", Value(a.followers_total), allocator);
-
-    result.AddMember("id", Value(a.id, allocator), allocator);
-    result.AddMember("popularity", Value(a.popularity), allocator);
-    result.AddMember("followers", followers, allocator);
-    result.AddMember("images", images, allocator);
-    result.AddMember("genres", genres, allocator);
+    schema::write(result, a, artist_fields, allocator);
 }
 
-
 wstring artist_t::get_main_genre() const
 {
     if (genres.size() > 0)
@@ -178,52 +164,35 @@ wstring simplified_album_t::get_artists_full_name() const
     return utils::string_join(artists_names, L", ");
 }
 
-void from_json(const Value &j, simplified_album_t &a)
-{
-    a.id = j["id"].GetString();
-    a.name = utils::utf8_decode(j["name"].GetString());
-    a.total_tracks = j["total_tracks"].GetUint();
-    a.album_type = j["album_type"].GetString();
-    a.release_date = j["release_date"].GetString();
-    
-    if (j.HasMember("release_date_precision"))
+static constexpr auto simplified_album_fields = std::tuple{
+    schema::field("id", &simplified_album_t::id),
+    schema::field("name", &simplified_album_t::name),
+    schema::field("total_tracks", &simplified_album_t::total_tracks),
+    schema::field("album_type", &simplified_album_t::album_type),
+    schema::field("release_date", &simplified_album_t::release_date),
+    schema::field("href", &simplified_album_t::href),
+    schema::field("images", &simplified_album_t::images),
+    schema::field("artists", &simplified_album_t::artists),
+    schema::field("external_urls", &simplified_album_t::urls),
+    // the date comes with a precision of a year or a month for some albums, e.g. "1999"
+    // or "1999-05" (see `release_date_precision`), it is padded up to a full date
+    schema::then(+[](simplified_album_t &a)
     {
-        string precision = j["release_date_precision"].GetString(); // year, month, day
-        if (precision == "year")
-            a.release_date = utils::format("{}-01-01", a.release_date);
-        else if (precision == "month")
-            a.release_date = utils::format("{}-01", a.release_date);
-    }
+        if (a.release_date.size() == 4)
+            a.release_date += "-01-01";
+        else if (a.release_date.size() == 7)
+            a.release_date += "-01";
+    }),
+};
 
-    a.href = j["href"].GetString();
-
-    from_json(j["images"], a.images);
-    from_json(j["artists"], a.artists);
-    from_json(j["external_urls"], a.urls);
+void from_json(const Value &j, simplified_album_t &a)
+{
+    schema::read(j, a, simplified_album_fields);
 }
 
 void to_json(Value &result, const simplified_album_t &a, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    Value images;
-    to_json(images, a.images, allocator);
-
-    Value artists;
-    to_json(artists, a.artists, allocator);
-
-    Value urls;
-    to_json(urls, a.urls, allocator);
-
-    result.AddMember("id", Value(a.id, allocator), allocator);
-    result.AddMember("name", Value(utils::utf8_encode(a.name), allocator), allocator);
-    result.AddMember("total_tracks", Value(a.total_tracks), allocator);
-    result.AddMember("album_type", Value(a.album_type, allocator), allocator);
-    result.AddMember("release_date", Value(a.release_date, allocator), allocator);
-    result.AddMember("href", Value(a.href, allocator), allocator);
-    result.AddMember("images", images, allocator);
-    result.AddMember("artists", artists, allocator);
-    result.AddMember("external_urls", urls, allocator);
+    schema::write(result, a, simplified_album_fields, allocator);
 }
 
 copyrights_t album_t::get_main_copyright() const
@@ -233,48 +202,73 @@ copyrights_t album_t::get_main_copyright() const
     return { "C", get_text(MCopyrightUnknown) };
 }
 
+static constexpr auto album_fields = std::tuple_cat(simplified_album_fields, std::tuple{
+    schema::field("copyrights", &album_t::copyrights),
+    schema::field("popularity", &album_t::popularity),
+    schema::field("label", &album_t::recording_label),
+});
+
 void from_json(const Value &j, album_t &a)
 {
-    from_json(j, dynamic_cast<simplified_album_t&>(a));
-    from_json(j["copyrights"], a.copyrights);
-    // from_json(j["items"], a.tracks);
-    
-    a.popularity = j["popularity"].GetUint();
-    a.recording_label = utils::utf8_decode(j["label"].GetString());
+    schema::read(j, a, album_fields);
 }
 
 void to_json(Value &result, const album_t &a, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-    to_json(result, dynamic_cast<const simplified_album_t&>(a), allocator);
-    
-    Value copyrights;
-    to_json(copyrights, a.copyrights, allocator);
-    
-    // Value tracks;
-    // to_json(tracks, a.tracks, allocator);
-    
-    // result.AddMember("items", tracks, allocator);
-    result.AddMember("copyrights", copyrights, allocator);
-    result.AddMember("popularity", Value(a.popularity), allocator);
-    result.AddMember("label", Value(utils::utf8_encode(a.recording_label), allocator), allocator);
+    schema::write(result, a, album_fields, allocator);
 }
 
-void to_json(Value &result, saved_album_t &a, json::Allocator &allocator)
+static constexpr auto saved_album_fields = std::tuple{
+    schema::field("added_at", &saved_album_t::added_at),
+    schema::object("album", album_fields),
+};
+
+void from_json(const Value &j, saved_album_t &a)
 {
-    result = Value(json::kObjectType);
+    schema::read(j, a, saved_album_fields);
+}
 
-    Value album;
-    to_json(album, dynamic_cast<const album_t&>(a), allocator);
+void to_json(Value &result, const saved_album_t &a, json::Allocator &allocator)
+{
+    schema::write(result, a, saved_album_fields, allocator);
+}
 
-    result.AddMember("added_at", Value(a.added_at, allocator), allocator);
-    result.AddMember("album", album, allocator);
+static bool is_same(const image_t &lhs, const image_t &rhs)
+{
+    return lhs.url == rhs.url && lhs.width == rhs.width && lhs.height == rhs.height;
 }
 
-void from_json(const Value &j, saved_album_t &a)
+static bool is_same(const simplified_artist_t &lhs, const simplified_artist_t &rhs)
+{
+    return lhs.id == rhs.id && lhs.name == rhs.name && lhs.urls.spotify == rhs.urls.spotify;
+}
+
+static bool is_same(const simplified_album_t &lhs, const simplified_album_t &rhs)
+{
+    auto is_same_item = [](const auto &l, const auto &r) { return is_same(l, r); };
+
+    return lhs.id == rhs.id && lhs.name == rhs.name && lhs.total_tracks == rhs.total_tracks &&
+        lhs.album_type == rhs.album_type && lhs.release_date == rhs.release_date &&
+        lhs.href == rhs.href && lhs.urls.spotify == rhs.urls.spotify &&
+        std::ranges::equal(lhs.images, rhs.images, is_same_item) &&
+        std::ranges::equal(lhs.artists, rhs.artists, is_same_item);
+}
+
+static items_pool_t<simplified_artist_t> artists_pool;
+static items_pool_t<simplified_album_t> albums_pool;
+
+void from_json(const Value &j, shared_item_t<simplified_artist_t> &a)
+{
+    simplified_artist_t artist;
+    from_json(j, artist);
+    a = shared_item_t<simplified_artist_t>(artists_pool.intern(std::move(artist)));
+}
+
+void from_json(const Value &j, shared_item_t<simplified_album_t> &a)
 {
-    from_json(j["album"], dynamic_cast<album_t&>(a));
-    a.added_at = j["added_at"].GetString();
+    simplified_album_t album;
+    from_json(j, album);
+    a = shared_item_t<simplified_album_t>(albums_pool.intern(std::move(album)));
 }
 
 const string& simplified_track_t::get_fields_filter()
@@ -285,50 +279,37 @@ const string& simplified_track_t::get_fields_filter()
 
 simplified_artist_t simplified_track_t::get_artist() const noexcept
 {
-    return artists.size() > 0 ? artists[0] : simplified_artist_t{};
+    return artists.size() > 0 ? *artists[0] : simplified_artist_t{};
 }
 
 wstring simplified_track_t::get_artists_full_name() const
 {
     std::vector<wstring> artists_names;
     std::transform(artists.cbegin(), artists.cend(), back_inserter(artists_names),
-        [](const auto &a) { return a.name; });
+        [](const auto &a) { return a->name; });
     return utils::string_join(artists_names, L", ");
 }
 
+static constexpr auto simplified_track_fields = std::tuple{
+    schema::field("id", &simplified_track_t::id),
+    schema::field("name", &simplified_track_t::name),
+    schema::field("duration_ms", &simplified_track_t::duration_ms),
+    schema::field("track_number", &simplified_track_t::track_number),
+    schema::field("disc_number", &simplified_track_t::disc_number),
+    schema::field("explicit", &simplified_track_t::is_explicit),
+    schema::field("artists", &simplified_track_t::artists),
+    schema::field("external_urls", &simplified_track_t::urls),
+    schema::then(+[](simplified_track_t &t) { t.duration = t.duration_ms / 1000; }),
+};
+
 void from_json(const Value &j, simplified_track_t &t)
 {
-    t.id = j["id"].GetString();
-    t.track_number = j["track_number"].GetUint();
-    t.disc_number = j["disc_number"].GetUint();
-    t.duration_ms = j["duration_ms"].GetInt();
-    t.is_explicit = j["explicit"].GetBool();
-    
-    t.duration = t.duration_ms / 1000;
-    t.name = utils::utf8_decode(j["name"].GetString());
-    
-    from_json(j["artists"], t.artists);
-    from_json(j["external_urls"], t.urls);
+    schema::read(j, t, simplified_track_fields);
 }
 
 void to_json(Value &result, const simplified_track_t &t, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    Value artists;
-    to_json(artists, t.artists, allocator);
-
-    Value urls;
-    to_json(urls, t.urls, allocator);
-
-    result.AddMember("id", Value(t.id, allocator), allocator);
-    result.AddMember("name", Value(utils::utf8_encode(t.name), allocator), allocator);
-    result.AddMember("duration_ms", Value(t.duration_ms), allocator);
-    result.AddMember("track_number", Value(t.track_number), allocator);
-    result.AddMember("disc_number", Value(t.disc_number), allocator);
-    result.AddMember("explicit", Value(t.is_explicit), allocator);
-    result.AddMember("artists", artists, allocator);
-    result.AddMember("external_urls", urls, allocator);
+    schema::write(result, t, simplified_track_fields, allocator);
 }
 
 const string& track_t::get_fields_filter()
@@ -337,25 +318,19 @@ const string& track_t::get_fields_filter()
     return fields;
 }
 
+static constexpr auto track_fields = std::tuple_cat(simplified_track_fields, std::tuple{
+    schema::field("album", &track_t::album),
+    schema::field("popularity", &track_t::popularity),
+});
+
 void from_json(const Value &j, track_t &t)
 {
-    from_json(j, dynamic_cast<simplified_track_t&>(t));
-    from_json(j["album"], t.album);
-    
-    t.popularity = j["popularity"].GetUint();
+    schema::read(j, t, track_fields);
 }
 
 void to_json(Value &result, const track_t &t, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    to_json(result, dynamic_cast<const simplified_track_t&>(t), allocator);
-
-    Value album;
-    to_json(album, t.album, allocator);
-
-    result.AddMember("album", album, allocator);
-    result.AddMember("popularity", Value(t.popularity), allocator);
+    schema::write(result, t, track_fields, allocator);
 }
 
 const string& saved_track_t::get_fields_filter()
@@ -364,72 +339,56 @@ const string& saved_track_t::get_fields_filter()
     return fields;
 }
 
-void to_json(Value &result, const saved_track_t &t, json::Allocator &allocator)
-{
-    result = Value(json::kObjectType);
-
-    Value track;
-    to_json(track, dynamic_cast<const track_t&>(t), allocator);
+static constexpr auto saved_track_fields = std::tuple{
+    schema::field("added_at", &saved_track_t::added_at),
+    schema::object("track", track_fields),
+};
 
-    result.AddMember("added_at", Value(t.added_at, allocator), allocator);
-    result.AddMember("track", track, allocator);
-}
-    
 void from_json(const Value &j, saved_track_t &t)
 {
-    from_json(j["track"], dynamic_cast<track_t&>(t));
-    t.added_at = j["added_at"].GetString();
+    schema::read(j, t, saved_track_fields);
 }
 
+void to_json(Value &result, const saved_track_t &t, json::Allocator &allocator)
+{
+    schema::write(result, t, saved_track_fields, allocator);
+}
+
+static constexpr auto simplified_playlist_fields = std::tuple{
+    schema::field("id", &simplified_playlist_t::id),
+    schema::field("snapshot_id", &simplified_playlist_t::snapshot_id),
+    schema::field("name", &simplified_playlist_t::name),
+    schema::field("description", &simplified_playlist_t::description),
+    schema::field("href", &simplified_playlist_t::href),
+    schema::field("collaborative", &simplified_playlist_t::is_collaborative),
+    schema::field("public", &simplified_playlist_t::is_public),
+    schema::object("tracks", std::tuple{
+        schema::field("total", &simplified_playlist_t::tracks_total),
+    }),
+    schema::object("owner", std::tuple{
+        schema::field("display_name", &simplified_playlist_t::user_display_name),
+    }),
+    schema::field("external_urls", &simplified_playlist_t::urls),
+};
+
 void from_json(const Value &j, simplified_playlist_t &p)
 {
-    p.id = j["id"].GetString();
-    p.snapshot_id = j["snapshot_id"].GetString();
-    p.href = j["href"].GetString();
-    p.is_collaborative = j["collaborative"].GetBool();
-    p.is_public = j["public"].GetBool();
-    p.tracks_total = j["tracks"]["total"].GetUint();
-    
-    p.name = utils::utf8_decode(j["name"].GetString());
-    p.user_display_name = utils::utf8_decode(j["owner"]["display_name"].GetString());
-    p.description = utils::utf8_decode(j["description"].GetString());
-    
-    from_json(j["external_urls"], p.urls);
+    schema::read(j, p, simplified_playlist_fields);
 }
 
 void to_json(Value &result, const simplified_playlist_t &p, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    Value tracks;
-    tracks.AddMember("total", Value(p.tracks_total), allocator);
-
-    Value owner;
-    owner.AddMember("name", Value(utils::utf8_encode(p.user_display_name), allocator), allocator);
-
-    Value urls;
-    to_json(urls, p.urls, allocator);
-
-    result.AddMember("id", Value(p.id, allocator), allocator);
-    result.AddMember("snapshot_id", Value(p.snapshot_id, allocator), allocator);
-    result.AddMember("name", Value(utils::utf8_encode(p.name), allocator), allocator);
-    result.AddMember("description", Value(utils::utf8_encode(p.description), allocator), allocator);
-    result.AddMember("href", Value(p.href, allocator), allocator);
-    result.AddMember("collaborative", Value(p.is_collaborative), allocator);
-    result.AddMember("public", Value(p.is_public), allocator);
-    result.AddMember("tracks", tracks, allocator);
-    result.AddMember("actions", owner, allocator);
-    result.AddMember("external_urls", urls, allocator);
+    schema::write(result, p, simplified_playlist_fields, allocator);
 }
 
-void to_json(Value &result, const playlist_t &a, json::Allocator &allocator)
+void from_json(const Value &j, playlist_t &p)
 {
-    to_json(result, dynamic_cast<const simplified_playlist_t&>(a), allocator);
+    schema::read(j, p, simplified_playlist_fields);
 }
 
-void from_json(const Value &j, playlist_t &p)
+void to_json(Value &result, const playlist_t &p, json::Allocator &allocator)
 {
-    from_json(j, dynamic_cast<simplified_playlist_t&>(p));
+    schema::write(result, p, simplified_playlist_fields, allocator);
 }
 
 const string& simplified_playlist_t::get_fields_filter()
@@ -462,49 +421,26 @@ const string& playlist_t::get_fields_filter()
     return fields;
 }
 
+static constexpr auto playback_state_fields = std::tuple{
+    schema::field("repeat_state", &playback_state_t::repeat_state),
+    schema::field("shuffle_state", &playback_state_t::shuffle_state),
+    schema::field("progress_ms", &playback_state_t::progress_ms, schema::optional),
+    schema::field("is_playing", &playback_state_t::is_playing),
+    schema::field("device", &playback_state_t::device),
+    schema::field("actions", &playback_state_t::actions),
+    schema::field("item", &playback_state_t::item, schema::optional | schema::nullable),
+    schema::field("context", &playback_state_t::context, schema::optional | schema::nullable),
+    schema::then(+[](playback_state_t &p) { p.progress = p.progress_ms / 1000; }),
+};
+
 void from_json(const Value &j, playback_state_t &p)
 {
-    from_json(j["device"], p.device);
-    from_json(j["actions"], p.actions);
-
-    if (j.HasMember("context") && !j["context"].IsNull())
-        from_json(j["context"], p.context);
-
-    if (j.HasMember("item") && !j["item"].IsNull())
-        from_json(j["item"], p.item);
-
-    p.progress_ms = j.HasMember("progress_ms") ? j["progress_ms"].GetInt() : 0;
-    p.progress = p.progress_ms / 1000;
-
-    p.repeat_state = j["repeat_state"].GetString();
-    p.shuffle_state = j["shuffle_state"].GetBool();
-    p.is_playing = j["is_playing"].GetBool();
+    schema::read(j, p, playback_state_fields);
 }
 
 void to_json(Value &result, const playback_state_t &p, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    Value device;
-    to_json(device, p.device, allocator);
-
-    Value actions;
-    to_json(actions, p.actions, allocator);
-
-    Value item;
-    to_json(item, p.item, allocator);
-
-    Value context;
-    to_json(context, p.context, allocator);
-
-    result.AddMember("repeat_state", Value(p.repeat_state, allocator), allocator);
-    result.AddMember("shuffle_state", Value(p.shuffle_state), allocator);
-    result.AddMember("progress_ms", Value(p.progress_ms), allocator);
-    result.AddMember("is_playing", Value(p.is_playing), allocator);
-    result.AddMember("device", device, allocator);
-    result.AddMember("actions", actions, allocator);
-    result.AddMember("item", item, allocator);
-    result.AddMember("context", context, allocator);
+    schema::write(result, p, playback_state_fields, allocator);
 }
 
 bool operator==(const actions_t &lhs, const actions_t &rhs)
@@ -523,74 +459,46 @@ bool operator==(const actions_t &lhs, const actions_t &rhs)
     );
 }
 
+// the data contains the disallowing flags, they are inverted to comply the other code usage
+static constexpr auto actions_fields = std::tuple{
+    schema::object("disallows", std::tuple{
+        schema::flag("interrupting_playback", &actions_t::interrupting_playback),
+        schema::flag("pausing", &actions_t::pausing),
+        schema::flag("resuming", &actions_t::resuming),
+        schema::flag("seeking", &actions_t::seeking),
+        schema::flag("skipping_next", &actions_t::skipping_next),
+        schema::flag("skipping_prev", &actions_t::skipping_prev),
+        schema::flag("toggling_repeat_context", &actions_t::toggling_repeat_context),
+        schema::flag("toggling_repeat_track", &actions_t::toggling_repeat_track),
+        schema::flag("toggling_shuffle", &actions_t::toggling_shuffle),
+        schema::flag("trasferring_playback", &actions_t::trasferring_playback),
+    }, schema::optional),
+};
+
 void from_json(const Value &j, actions_t &a)
 {
-    if (j.HasMember("disallows"))
-    {
-        const auto &actions = j["disallows"];
-
-        // data contains disallowing flags, so we need to invert them in order to
-        // comply the other code usage
-        auto is_allowed = [&](const string &fieldname) -> bool
-        {
-            return actions.HasMember(fieldname) ? !actions[fieldname].GetBool() : true;
-        };
-    
-        a.interrupting_playback = is_allowed("interrupting_playback");
-        a.pausing = is_allowed("pausing");
-        a.resuming = is_allowed("resuming");
-        a.seeking = is_allowed("seeking");
-        a.skipping_next = is_allowed("skipping_next");
-        a.skipping_prev = is_allowed("skipping_prev");
-        a.toggling_repeat_context = false;
-        a.toggling_repeat_track = false;
-        a.toggling_repeat_context = is_allowed("toggling_repeat_context");
-        a.toggling_repeat_track = is_allowed("toggling_repeat_track");
-        a.toggling_shuffle = is_allowed("toggling_shuffle");
-        a.trasferring_playback = is_allowed("trasferring_playback");
-    }
-}
-
-void to_json(Value &result, const actions_t &a, json::Allocator &al)
-{
-    result = Value(json::kObjectType);
-    result.AddMember("disallows", Value(json::kObjectType), al);
-
-    auto &disallows = result["disallows"];
-    
-    // helper to add only the positive flags into the object
-    auto write_action = [&](const string &fieldname, bool value)
-    {
-        if (!value)
-            disallows.AddMember(Value(fieldname, al), Value(true), al);
-    };
+    schema::read(j, a, actions_fields);
+}
 
-    write_action("interrupting_playback", a.interrupting_playback);
-    write_action("pausing", a.pausing);
-    write_action("resuming", a.resuming);
-    write_action("seeking", a.seeking);
-    write_action("skipping_next", a.skipping_next);
-    write_action("skipping_prev", a.skipping_prev);
-    write_action("toggling_repeat_context", a.toggling_repeat_context);
-    write_action("toggling_repeat_track", a.toggling_repeat_track);
-    write_action("toggling_shuffle", a.toggling_shuffle);
-    write_action("trasferring_playback", a.trasferring_playback);
+void to_json(Value &result, const actions_t &a, json::Allocator &allocator)
+{
+    schema::write(result, a, actions_fields, allocator);
 }
 
+static constexpr auto context_fields = std::tuple{
+    schema::field("type", &context_t::type),
+    schema::field("uri", &context_t::uri),
+    schema::field("href", &context_t::href),
+};
+
 void from_json(const Value &j, context_t &c)
 {
-    c.type = j["type"].GetString();
-    c.uri = j["uri"].GetString();
-    c.href = j["href"].GetString();
+    schema::read(j, c, context_fields);
 }
 
 void to_json(Value &result, const context_t &c, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    result.AddMember("type", Value(c.type, allocator), allocator);
-    result.AddMember("uri", Value(c.uri, allocator), allocator);
-    result.AddMember("href", Value(c.href, allocator), allocator);
+    schema::write(result, c, context_fields, allocator);
 }
 
 string context_t::get_item_id() const
@@ -607,31 +515,25 @@ bool operator==(const context_t &lhs, const context_t &rhs)
     return lhs.href == rhs.href;
 }
 
+static constexpr auto device_fields = std::tuple{
+    schema::field("id", &device_t::id),
+    schema::field("name", &device_t::name),
+    schema::field("is_active", &device_t::is_active),
+    schema::field("type", &device_t::type),
+    schema::field("volume_percent", &device_t::volume_percent, schema::optional),
+    schema::field("supports_volume", &device_t::supports_volume),
+    schema::field("is_private_session", &device_t::is_private_session),
+    schema::field("is_restricted", &device_t::is_restricted),
+};
+
 void from_json(const Value &j, device_t &d)
 {
-    d.id = j["id"].GetString();
-    d.is_active = j["is_active"].GetBool();
-    d.type = j["type"].GetString();
-    d.supports_volume = j["supports_volume"].GetBool();
-    d.is_private_session = j["is_private_session"].GetBool();
-    d.is_restricted = j["is_restricted"].GetBool();
-    d.name = utils::utf8_decode(j["name"].GetString());
-
-    d.volume_percent = j.HasMember("volume_percent") ? j["volume_percent"].GetInt() : 0;
+    schema::read(j, d, device_fields);
 }
 
 void to_json(Value &result, const device_t &d, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    result.AddMember("id", Value(d.id, allocator), allocator);
-    result.AddMember("name", Value(utils::utf8_encode(d.name), allocator), allocator);
-    result.AddMember("is_active", Value(d.is_active), allocator);
-    result.AddMember("type", Value(d.type, allocator), allocator);
-    result.AddMember("volume_percent", Value(d.volume_percent), allocator);
-    result.AddMember("supports_volume", Value(d.supports_volume), allocator);
-    result.AddMember("is_private_session", Value(d.is_private_session), allocator);
-    result.AddMember("is_restricted", Value(d.is_restricted), allocator);
+    schema::write(result, d, device_fields, allocator);
 }
 
 string device_t::to_str() const
@@ -639,73 +541,52 @@ string device_t::to_str() const
     return utils::format("device(name={}, id={})", utils::to_string(name), id);
 }
 
-void to_json(Value &result, const history_item_t &i, json::Allocator &allocator)
-{
-    result = Value(json::kObjectType);
-    
-    Value track;
-    to_json(track, dynamic_cast<const track_t&>(i), allocator);
-
-    Value context;
-    to_json(context, i.context, allocator);
+static constexpr auto history_item_fields = std::tuple{
+    schema::field("played_at", &history_item_t::played_at),
+    schema::field("context", &history_item_t::context, schema::nullable),
+    schema::object("track", track_fields),
+};
 
-    result.AddMember("played_at", Value(i.played_at, allocator), allocator);
-    result.AddMember("context", context, allocator);
-    result.AddMember("track", track, allocator);
-}
-    
-void from_json(const Value &j, history_item_t &p)
+void from_json(const Value &j, history_item_t &i)
 {
-    from_json(j["track"], dynamic_cast<track_t&>(p));
-
-    p.played_at = j["played_at"].GetString();
-
-    if (!j["context"].IsNull())
-        from_json(j["context"], p.context);
+    schema::read(j, i, history_item_fields);
 }
 
-void to_json(Value &result, const playing_queue_t &p, json::Allocator &allocator)
+void to_json(Value &result, const history_item_t &i, json::Allocator &allocator)
 {
-    result = Value(json::kObjectType);
-
-    Value currently_playing;
-    to_json(currently_playing, p.currently_playing, allocator);
-
-    Value queue;
-    to_json(queue, p.queue, allocator);
-
-    result.AddMember("currently_playing", currently_playing, allocator);
-    result.AddMember("queue", queue, allocator);
+    schema::write(result, i, history_item_fields, allocator);
 }
 
+static constexpr auto playing_queue_fields = std::tuple{
+    schema::field("currently_playing", &playing_queue_t::currently_playing, schema::nullable),
+    schema::field("queue", &playing_queue_t::queue),
+};
+
 void from_json(const Value &j, playing_queue_t &p)
 {
-    if (!j["currently_playing"].IsNull())
-        from_json(j["currently_playing"], p.currently_playing);
+    schema::read(j, p, playing_queue_fields);
+}
 
-    from_json(j["queue"], p.queue);
+void to_json(Value &result, const playing_queue_t &p, json::Allocator &allocator)
+{
+    schema::write(result, p, playing_queue_fields, allocator);
 }
 
+static constexpr auto auth_fields = std::tuple{
+    schema::field("access_token", &auth_t::access_token),
+    schema::field("scope", &auth_t::scope),
+    schema::field("expires_in", &auth_t::expires_in),
+    schema::field("refresh_token", &auth_t::refresh_token, schema::optional | schema::nullable),
+};
+
 void from_json(const Value &j, auth_t &a)
 {
-    a.access_token = j["access_token"].GetString();
-    a.scope = j["scope"].GetString();
-    a.expires_in = j["expires_in"].GetInt();
-    
-    if (j.HasMember("refresh_token") && !j["refresh_token"].IsNull())
-        a.refresh_token = j["refresh_token"].GetString();
-    else
-        a.refresh_token = "";
+    schema::read(j, a, auth_fields);
 }
 
 void to_json(Value &result, const auth_t &a, json::Allocator &allocator)
 {
-    result = Value(kObjectType);
-
-    result.AddMember("access_token", Value(a.access_token, allocator), allocator);
-    result.AddMember("scope", Value(a.scope, allocator), allocator);
-    result.AddMember("expires_in", Value(a.expires_in), allocator);
-    result.AddMember("refresh_token", Value(a.refresh_token, allocator), allocator);
+    schema::write(result, a, auth_fields, allocator);
 }
 
 } // namespace spotify
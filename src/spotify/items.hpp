@@ -62,6 +62,37 @@ struct copyrights_t
     friend void to_json(json::Value &j, const copyrights_t &c, json::Allocator &allocator);
 };
 
+/// @brief A reference to an immutable item shared by the other items, e.g. the same album
+/// record is referred by all its tracks instead of being copied to each of them. The items
+/// are interned while being read from json, see `from_json` overloads below; an empty
+/// reference gives a default item
+template<class T>
+class shared_item_t
+{
+public:
+    shared_item_t() = default;
+    explicit shared_item_t(std::shared_ptr<const T> item): item(std::move(item)) {}
+
+    auto get() const -> const T& { return item ? *item : get_default(); }
+    auto operator*() const -> const T& { return get(); }
+    auto operator->() const -> const T* { return &get(); }
+    operator const T&() const { return get(); }
+private:
+    static auto get_default() -> const T&
+    {
+        static const T default_item{};
+        return default_item;
+    }
+
+    std::shared_ptr<const T> item;
+};
+
+template<class T>
+void to_json(json::Value &j, const shared_item_t<T> &item, json::Allocator &allocator)
+{
+    to_json(j, item.get(), allocator);
+}
+
 struct simplified_artist_t: public data_item_t
 {
     wstring name = utils::far3::get_text(MArtistUnknown);
@@ -125,7 +156,7 @@ struct simplified_track_t: public data_item_t
     size_t disc_number;
     size_t track_number;
     bool is_explicit;
-    std::vector<simplified_artist_t> artists;
+    std::vector<shared_item_t<simplified_artist_t>> artists;
     external_urls_t urls;
 
     static string make_uri(const item_id_t &id) { return make_item_uri("track", id); }
@@ -144,6 +175,11 @@ struct simplified_track_t: public data_item_t
     friend void to_json(json::Value &j, const simplified_track_t &t, json::Allocator &allocator);
 };
 
+/// @brief Read the artist or the album and intern it by its id: the items read again with the
+/// same content are shared, so a big library keeps every album or artist of its tracks once
+void from_json(const json::Value &j, shared_item_t<simplified_artist_t> &a);
+void from_json(const json::Value &j, shared_item_t<simplified_album_t> &a);
+
 struct artist_t: public simplified_artist_t
 {
     size_t followers_total = 0;
@@ -162,7 +198,7 @@ struct artist_t: public simplified_artist_t
 
 struct track_t: public simplified_track_t
 {
-    simplified_album_t album;
+    shared_item_t<simplified_album_t> album;
     size_t popularity = 0;
 
     static const string& get_fields_filter();
@@ -199,7 +235,7 @@ struct saved_album_t: public album_t
     string added_at;
     
     friend void from_json(const json::Value &j, saved_album_t &a);
-    friend void to_json(json::Value &j, saved_album_t &a, json::Allocator &allocator);
+    friend void to_json(json::Value &j, const saved_album_t &a, json::Allocator &allocator);
 };
 
 struct simplified_playlist_t: public data_item_t
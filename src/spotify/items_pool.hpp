@@ -0,0 +1,57 @@
+#ifndef ITEMS_POOL_HPP_4D5E1D7F_6837_4928_84F4_5A2FEDBA564D
+#define ITEMS_POOL_HPP_4D5E1D7F_6837_4928_84F4_5A2FEDBA564D
+#pragma once
+
+#include "stdafx.h"
+#include "ids.hpp"
+
+namespace spotifar { namespace spotify {
+
+/// @brief Interns the items by their ids. The records are owned by the items referring to
+/// them, the pool keeps only weak references, so an album is freed with its last track,
+/// and the expired references are dropped every time the pool doubles
+/// @tparam T an item type with the `id` field; the records of the same id are compared
+/// with the `is_same(const T&, const T&)` overload, found by the argument's namespace
+/// @tparam A an allocator of the records and of the pool's own nodes
+template<class T, class A = std::allocator<T>>
+class items_pool_t
+{
+public:
+    auto intern(T &&item) -> std::shared_ptr<const T>
+    {
+        const spotify_id_t uid(item.id);
+        if (!uid) // the local files' albums and artists have no ids
+            return std::allocate_shared<const T>(A(), std::move(item));
+
+        std::lock_guard lock(guard);
+
+        auto &ref = items[uid];
+        if (auto shared = ref.lock(); shared && is_same(*shared, item))
+            return shared;
+
+        // a new item or the changed one, the items read before keep referring the previous record
+        auto shared = std::allocate_shared<const T>(A(), std::move(item));
+        ref = shared;
+
+        if (items.size() >= purge_size)
+        {
+            std::erase_if(items, [](const auto &p) { return p.second.expired(); });
+            purge_size = std::max(min_purge_size, items.size() * 2);
+        }
+        return shared;
+    }
+private:
+    static constexpr size_t min_purge_size = 1024;
+
+    using ref_t = std::pair<const spotify_id_t, std::weak_ptr<const T>>;
+
+    std::mutex guard;
+    std::unordered_map<spotify_id_t, std::weak_ptr<const T>, std::hash<spotify_id_t>,
+        std::equal_to<spotify_id_t>, typename std::allocator_traits<A>::template rebind_alloc<ref_t>> items;
+    size_t purge_size = min_purge_size;
+};
+
+} // namespace spotify
+} // namespace spotifar
+
+#endif // ITEMS_POOL_HPP_4D5E1D7F_6837_4928_84F4_5A2FEDBA564D
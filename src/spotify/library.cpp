@@ -10,14 +10,26 @@ namespace phs = std::placeholders;
 
 static const size_t BATCH_SIZE = 50;
 
+/// @brief A maximum number of the saved statuses' batches checked per one library resync:
+/// the background syncs are left with ~4 requests per second of the global budget, which
+/// gives six of them for the 1.5 seconds resync interval
+static const size_t MAX_BATCHES_PER_SYNC = 6;
+
+using saved_tracks_delta_t = delta_collection<saved_track_t, 1, std::chrono::days>;
+using saved_albums_delta_t = delta_collection<saved_album_t, 1, std::chrono::days>;
+
+static_assert(std::is_base_of_v<saved_tracks_t, saved_tracks_delta_t>);
+static_assert(std::is_base_of_v<saved_albums_t, saved_albums_delta_t>);
+
 /// @brief A custom saved-tracks-collection specialization, to update collection cache,
-/// when the fetching is finished.
-class saved_tracks_collection: public saved_tracks_t
+/// when the fetching is finished. The collection is fetched in the delta mode, only
+/// its newly saved head is requested, see `delta_collection`
+class saved_tracks_collection: public saved_tracks_delta_t
 {
 public:
     /// @param collection A collection to be updated pointer
     saved_tracks_collection(api_interface *api, library *library):
-        saved_tracks_t(api->get_ptr(), "/v1/me/tracks"),
+        saved_tracks_delta_t(api->get_ptr(), "/v1/me/tracks"),
         library(library)
         {}
     
@@ -25,7 +37,7 @@ public:
 
     bool fetch_items(api_weak_ptr_t api_proxy, bool only_cached, bool silent = false, size_t pages_to_request = 0) override
     {
-        if (saved_tracks_t::fetch_items(api_proxy, only_cached, silent, pages_to_request))
+        if (saved_tracks_delta_t::fetch_items(api_proxy, only_cached, silent, pages_to_request))
         {
             item_ids_t ids;
             std::transform(cbegin(), cend(), std::back_inserter(ids), [](const auto &t) { return t.id; });
@@ -35,25 +47,42 @@ public:
         }
         return false;
     }
+protected:
+    /// @brief The collection is served stale from the cache, while it is revalidated; once
+    /// some of its pages turn out to be changed, the collection is re-read, merging its new
+    /// head with the snapshot, and the saving statuses are updated, which notifies the
+    /// listeners. The fetching waits for the requests pool, so it is done from the main
+    /// thread, not from the pool's one, where the handler is called
+    auto get_revalidated_handler() const -> std::function<void()> override
+    {
+        return [api_proxy = this->api_proxy]
+        {
+            utils::far3::synchro_tasks::push([api_proxy]
+            {
+                if (auto api = api_proxy.lock())
+                    api->get_library()->get_saved_tracks()->fetch(false, true);
+            }, "saved tracks revalidated task");
+        };
+    }
 private:
     library *library;
 };
 
 /// @brief A custom saved-albums-collection specialization, to update collection cache,
-/// when the fetching is finished. 
-class saved_albums_collection: public saved_albums_t
+/// when the fetching is finished, fetched in the delta mode as well
+class saved_albums_collection: public saved_albums_delta_t
 {
 public:
     /// @param collection A collection to be updated pointer
     saved_albums_collection(api_interface *api, library *library):
-        saved_albums_t(api->get_ptr(), "/v1/me/albums"),
+        saved_albums_delta_t(api->get_ptr(), "/v1/me/albums"),
         library(library)
         {}
     ~saved_albums_collection() { library = nullptr; }
 
     bool fetch_items(api_weak_ptr_t api_proxy, bool only_cached, bool silent = false, size_t pages_to_request = 0) override
     {
-        if (saved_albums_t::fetch_items(api_proxy, only_cached, silent, pages_to_request))
+        if (saved_albums_delta_t::fetch_items(api_proxy, only_cached, silent, pages_to_request))
         {
             item_ids_t ids;
             std::transform(cbegin(), cend(), std::back_inserter(ids), [](const auto &t) { return t.id; });
@@ -63,6 +92,19 @@ public:
         }
         return false;
     }
+protected:
+    /// @brief see `saved_tracks_collection::get_revalidated_handler`
+    auto get_revalidated_handler() const -> std::function<void()> override
+    {
+        return [api_proxy = this->api_proxy]
+        {
+            utils::far3::synchro_tasks::push([api_proxy]
+            {
+                if (auto api = api_proxy.lock())
+                    api->get_library()->get_saved_albums()->fetch(false, true);
+            }, "saved albums revalidated task");
+        };
+    }
 private:
     library *library;
 };
@@ -97,6 +139,23 @@ private:
 };
 
 //-------------------------------------------------------------------------------------------------------------------
+static void from_json(const json::Value &j, statuses_container_t &statuses)
+{
+    statuses.reserve(j.MemberCount());
+
+    for (auto it = j.MemberBegin(); it != j.MemberEnd(); ++it)
+        if (auto id = spotify_id_t(it->name.GetString()))
+            statuses[id] = it->value.GetBool();
+}
+
+static void to_json(json::Value &result, const statuses_container_t &statuses, json::Allocator &allocator)
+{
+    result = json::Value(json::kObjectType);
+
+    for (const auto &[id, status]: statuses)
+        result.AddMember(json::Value(id.to_string(), allocator), json::Value(status), allocator);
+}
+
 void from_json(const json::Value &j, saved_items_t &v)
 {
     if (!j["tracks"].IsNull())
@@ -149,39 +208,76 @@ static std::deque<bool> check_saved_items(api_interface *api, const string &endp
 
 
 //-------------------------------------------------------------------------------------------------------------------
-bool saved_items_cache_t::resync(statuses_container_t &data)
+bool saved_items_cache_t::take_batch(batch_t &batch)
+{
+    std::lock_guard<std::mutex> lock(ids_access_guard);
+    if (ids_to_process.empty())
+        return false;
+
+    const auto count = std::min(BATCH_SIZE, ids_to_process.size());
+    batch.ids.assign(std::make_move_iterator(ids_to_process.begin()),
+        std::make_move_iterator(ids_to_process.begin() + count));
+    ids_to_process.erase(ids_to_process.begin(), ids_to_process.begin() + count);
+
+    return true;
+}
+
+void saved_items_cache_t::check_batch(batch_t &batch)
 {
-    if (ids_to_process.empty()) return false;
+    batch.statuses = check_saved_items(api_proxy, batch.ids);
+}
 
-    item_ids_t ids;
+bool saved_items_cache_t::apply_batch(collection_base_t::data_t &data, const batch_t &batch)
+{
+    const bool is_received = batch.statuses.size() == batch.ids.size();
+    if (is_received)
+    {
+        auto &container = get_container(data);
+        for (size_t i = 0; i < batch.ids.size(); ++i)
+            container.insert_or_assign(spotify_id_t(batch.ids[i]), batch.statuses[i]);
+    }
+    else
+    {
+        log::api->error("Failed to get saved status for {} items", batch.ids.size());
+    }
 
     {
         std::lock_guard<std::mutex> lock(ids_access_guard);
-        if (ids_to_process.size() > BATCH_SIZE)
+
+        const auto now = clock_t::now();
+        for (const auto &id: batch.ids)
         {
-            ids.assign(ids_to_process.begin(), ids_to_process.begin() + BATCH_SIZE);
-            ids_to_process.erase(ids_to_process.begin(), ids_to_process.begin() + BATCH_SIZE);
+            if (auto it = pending_ids.find(spotify_id_t(id)); it != pending_ids.end())
+            {
+                if (is_received)
+                {
+                    stats.total_latency += now - it->second;
+                    stats.max_latency = std::max(stats.max_latency, now - it->second);
+                }
+                pending_ids.erase(it);
+            }
         }
+
+        stats.batches++;
+        if (is_received)
+            stats.checked += batch.ids.size();
         else
-            ids = std::move(ids_to_process);
+            stats.failed++;
     }
 
-    if (auto result = check_saved_items(api_proxy, ids); result.size() == ids.size())
-    {
-        for (size_t i = 0; i < ids.size(); ++i)
-            data.insert_or_assign(ids[i], result[i]);
-
-        // potential problem, as until the method returns 'true`, the cache
-        // does not save `data` into its container; if some subscriber, revceiving
-        // the event decides to access cache, it is outdated
-        statuses_received_event(ids);
-        return true;
-    }
-    else
-    {
-        log::api->error("Failed to get saved status for {} items", ids.size());
-    }
-    return false;
+    // potential problem, as until the resync returns 'true`, the cache
+    // does not save `data` into its container; if some subscriber, revceiving
+    // the event decides to access cache, it is outdated
+    if (is_received)
+        statuses_received_event(batch.ids);
+
+    return is_received;
+}
+
+auto saved_items_cache_t::get_stats() const -> stats_t
+{
+    std::lock_guard<std::mutex> lock(ids_access_guard);
+    return stats;
 }
 
 void saved_items_cache_t::update_saved_items(const item_ids_t &ids, bool status, bool full_resync)
@@ -191,18 +287,30 @@ void saved_items_cache_t::update_saved_items(const item_ids_t &ids, bool status,
         auto accessor = data_accessor();
         auto &container = get_container(accessor.data);
 
+        std::unordered_set<spotify_id_t> unique_ids;
+        if (full_resync)
+            unique_ids.reserve(ids.size());
+
         for (const auto &id: ids)
         {
-            if (const auto it = container.find(id); it != container.end())
+            const auto uid = spotify_id_t(id);
+            if (!uid)
+                continue;
+
+            if (const auto it = container.find(uid); it != container.end())
             {
                 if (it->second != status)
                     changed_ids.push_back(id);
+                it->second = status;
             }
             else
             {
                 received_ids.push_back(id);
+                container.emplace(uid, status);
             }
-            container[id] = status;
+
+            if (full_resync)
+                unique_ids.insert(uid);
         }
 
         // the flag comes from the saved collections fetch method, specifying
@@ -210,11 +318,10 @@ void saved_items_cache_t::update_saved_items(const item_ids_t &ids, bool status,
         if (full_resync)
         {
             // ... in that case we are checking for the ones, removed from collection
-            const std::unordered_set<item_id_t> unique_ids(ids.begin(), ids.end());
-            for (auto &[id, value]: container)
+            for (auto &[uid, value]: container)
                 // ... does not present in the incoming ids and was true in the container
-                if (!unique_ids.contains(id) && value == true)
-                    changed_ids.push_back(id);
+                if (!unique_ids.contains(uid) && value == true)
+                    changed_ids.push_back(uid.to_string());
         }
     }
     
@@ -228,10 +335,15 @@ void saved_items_cache_t::update_saved_items(const item_ids_t &ids, bool status,
 bool saved_items_cache_t::is_item_saved(const item_id_t &item_id, bool force_sync)
 {
     {
+        // the items without a valid id, e.g. the local files, cannot be saved
+        const auto uid = spotify_id_t(item_id);
+        if (!uid)
+            return false;
+
         auto accessor = data_accessor();
         auto &container = get_container(accessor.data);
 
-        const auto it = container.find(item_id);
+        const auto it = container.find(uid);
         if (it != container.end())
             return it->second;
 
@@ -239,7 +351,7 @@ bool saved_items_cache_t::is_item_saved(const item_id_t &item_id, bool force_syn
         {
             if (auto res = check_saved_items(api_proxy, { item_id }); res.size() == 1)
             {
-                container.insert_or_assign(item_id, res[0]);
+                container.insert_or_assign(uid, res[0]);
                 return res[0];
             }
         }
@@ -247,7 +359,7 @@ bool saved_items_cache_t::is_item_saved(const item_id_t &item_id, bool force_syn
 
     {
         std::lock_guard<std::mutex> lock(ids_access_guard);
-        if (std::find(ids_to_process.begin(), ids_to_process.end(), item_id) == ids_to_process.end())
+        if (pending_ids.emplace(spotify_id_t(item_id), clock_t::now()).second)
             ids_to_process.push_back(item_id);
     }
 
@@ -387,6 +499,9 @@ bool library::remove_saved_tracks(const item_ids_t &ids)
     
     // updating tracks cache with the new saved tracks ids
     tracks.update_saved_items(ids, false);
+
+    // the removed items are not told by the head, the next fetch reconciles the snapshot
+    saved_tracks_delta_t::invalidate_snapshot(api_proxy->get_ptr(), "/v1/me/tracks");
     
     return true;
 }
@@ -441,6 +556,9 @@ bool library::remove_saved_albums(const item_ids_t &ids)
     
     // updating albums cache with the new saved albums ids
     albums.update_saved_items(ids, false);
+
+    // the removed items are not told by the head, the next fetch reconciles the snapshot
+    saved_albums_delta_t::invalidate_snapshot(api_proxy->get_ptr(), "/v1/me/albums");
     
     return true;
 }
@@ -523,14 +641,82 @@ clock_t::duration library::get_sync_interval() const
     return 1500ms;
 }
 
+void library::shutdown(config::settings_context &ctx)
+{
+    using namespace std::chrono;
+
+    for (const auto &[name, cache]: std::initializer_list<std::pair<const char*, const saved_items_cache_t*>>{
+        { "tracks", &tracks }, { "albums", &albums }, { "artists", &artists } })
+    {
+        const auto stats = cache->get_stats();
+        log::api->info("Saved {} statuses, checked {}, requests {}, failed {}, latency avg {}ms, max {}ms",
+            name, stats.checked, stats.batches, stats.failed,
+            stats.checked ? duration_cast<milliseconds>(stats.total_latency).count() / stats.checked : 0,
+            duration_cast<milliseconds>(stats.max_latency).count());
+    }
+
+    collection_base_t::shutdown(ctx);
+}
+
 bool library::request_data(data_t &data)
 {
+    struct request_t
+    {
+        saved_items_cache_t *cache;
+        saved_items_cache_t::batch_t batch;
+    };
+
     data = get();
 
-    if (tracks.resync(data.tracks) || albums.resync(data.albums) || artists.resync(data.artists))
-        return true;
+    // the budget is shared by the types in turn, so a long queue of the tracks
+    // does not hold back the albums and artists ones
+    const std::array<saved_items_cache_t*, 3> caches{ &tracks, &albums, &artists };
 
-    return false;
+    std::vector<request_t> requests;
+    for (bool is_taken = true; is_taken && requests.size() < MAX_BATCHES_PER_SYNC;)
+    {
+        is_taken = false;
+        for (auto *cache: caches)
+        {
+            if (requests.size() == MAX_BATCHES_PER_SYNC)
+                break;
+
+            if (request_t request{ cache }; cache->take_batch(request.batch))
+            {
+                requests.push_back(std::move(request));
+                is_taken = true;
+            }
+        }
+    }
+
+    if (requests.empty())
+        return false;
+
+    auto check_batch = [&requests](size_t idx) { requests[idx].cache->check_batch(requests[idx].batch); };
+
+    // the batches are checked concurrently, unless the resync is called from
+    // the requests pool's task, which would wait for the batches queued behind it
+    if (requests.size() > 1 && BS::this_thread::get_pool() != (void*)&api_proxy->get_pool())
+    {
+        auto priority = request_priority_scope::get_current();
+
+        api_proxy->get_pool().submit_sequence((size_t)0, requests.size(), [&check_batch, priority](size_t idx)
+            {
+                request_priority_scope scope(priority);
+                check_batch(idx);
+            }, get_pool_priority(priority)).wait();
+    }
+    else
+    {
+        for (size_t idx = 0; idx < requests.size(); ++idx)
+            check_batch(idx);
+    }
+
+    bool is_received = false;
+    for (const auto &request: requests)
+        is_received = request.cache->apply_batch(data, request.batch) || is_received;
+
+    return is_received;
 }
     
 } // namespace spotify
@@ -4,12 +4,14 @@
 
 #include "cache.hpp"
 #include "interfaces.hpp"
+#include "ids.hpp"
 
 namespace spotifar { namespace spotify {
 
 /// @brief A container type for caching saving statuses for the Spotify API items.
-/// true - saved, false - not saved, abcense - status is unknown
-using statuses_container_t = std::unordered_map<item_id_t, bool>;
+/// true - saved, false - not saved, abcense - status is unknown; the whole library's ids
+/// are kept here, so they are stored compactly
+using statuses_container_t = std::unordered_map<spotify_id_t, bool>;
 
 struct saved_items_t
 {
@@ -29,6 +31,22 @@ using collection_base_t = json_cache<saved_items_t>;
 class saved_items_cache_t
 {
     using data_accessor_t = std::function<collection_base_t::accessor_t()>;
+public:
+    /// @brief A batch of the queued ids, checked by one request
+    struct batch_t
+    {
+        item_ids_t ids;
+        std::deque<bool> statuses; // in the order of `ids`, empty if the request failed
+    };
+
+    struct stats_t
+    {
+        size_t checked = 0; // the ids, which statuses are received
+        size_t batches = 0; // the requests performed
+        size_t failed = 0; // the requests failed
+        clock_t::duration total_latency{}; // summed up from the queueing of the ids to receiving their statuses
+        clock_t::duration max_latency{};
+    };
 public:
     /// @param accessor function-getter to obtain a main collection_base_t::data_t
     /// container for writing
@@ -36,14 +54,23 @@ public:
         api_proxy(api), data_accessor(accessor)
         {}
 
-    /// @brief Resyncs current cache with the API by timer. Obtains valid saving
-    /// statuses for all the previously requested and delayed item ids. Updates
-    /// main cache `c` immediately.
+    /// @brief Takes the next batch of the queued ids for checking, returns false if the
+    /// queue is empty. The ids are kept pending until the batch is applied, so the
+    /// repeated requests of their statuses do not queue them once again
+    bool take_batch(batch_t &batch);
+
+    /// @brief Requests the saving statuses of the batch's ids; the batches are checked
+    /// concurrently, the method does not touch the cache
+    void check_batch(batch_t &batch);
+
+    /// @brief Stores the statuses of the checked `batch` into the main cache `data`
+    /// and releases its pending ids; the ids of a failed batch are queued again by the
+    /// next access to them. Returns true if the statuses are received.
     /// NOTE: the class has an access to the data container through `data_accessor_t` member,
-    /// but in the `resync` particular case `json_cache` creates a temp cache object, until
+    /// but in the resync case `json_cache` creates a temp cache object, until
     /// resync is finished succesfully, which is not accessible over getter. So, it is
     /// passed here directly as an argument
-    bool resync(statuses_container_t& c);
+    bool apply_batch(collection_base_t::data_t &data, const batch_t &batch);
 
     /// @brief Sets `status` saving flag to all the given `ids` items in cache
     /// @param full_resync signals, that the list of `ids` is the full new amount of saved items
@@ -52,6 +79,8 @@ public:
     /// @brief Returns items `item_id` saving status if known, otherwise `false`
     /// and add `item_id` to the queue for requesting
     bool is_item_saved(const item_id_t &item_id, bool force_sync);
+
+    auto get_stats() const -> stats_t;
 protected:
     /// @brief Helps to get an access to the needed nested container, which is part of
     /// the main on `c`
@@ -70,8 +99,13 @@ protected:
 private:
     api_interface *api_proxy;
     data_accessor_t data_accessor;
-    item_ids_t ids_to_process;
-    std::mutex ids_access_guard;
+
+    // the queue keeps the order of the requests, the pending ids are the queued and
+    // the being checked ones together with the time they were queued at
+    std::deque<item_id_t> ids_to_process;
+    std::unordered_map<spotify_id_t, clock_t::time_point> pending_ids;
+    stats_t stats;
+    mutable std::mutex ids_access_guard;
 };
 
 /// @brief Class specialisation for caching tracks saving statuses
@@ -139,6 +173,9 @@ public:
     bool is_artist_followed(const item_id_t &artist_id, bool force_sync = false) override;
     bool follow_artists(const item_ids_t &ids) override;
     bool unfollow_artists(const item_ids_t &ids) override;
+
+    // cached_data_abstract's interface
+    void shutdown(config::settings_context &ctx) override;
 protected:
     // json_cache's interface
     bool is_active() const override;
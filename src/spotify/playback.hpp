@@ -17,6 +17,7 @@ protected:
     void on_data_synced(const playback_state_t &data, const playback_state_t &prev_data) override;
     bool request_data(playback_state_t &data) override;
     auto get_sync_interval() const -> clock_t::duration override;
+    auto get_resync_priority() const -> request_priority override { return request_priority::playback; }
 
 private:
     api_interface *api_proxy;
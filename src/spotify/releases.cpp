@@ -1,6 +1,7 @@
 #include "releases.hpp"
 #include "requesters.hpp"
 #include "observer_protocols.hpp"
+#include "ids.hpp"
 
 namespace spotifar { namespace spotify {
 
@@ -80,6 +81,9 @@ void recent_releases::queue_artists(const item_ids_t &ids)
         ]
         (const std::size_t idx)
         {
+            // the crawler must not compete with the user's requests for the rate budget
+            request_priority_scope scope(request_priority::background);
+
             std::unique_lock<std::mutex> thread_lock(sleep_cv_guard);
 
             const auto artist_id = ids[idx];
@@ -167,11 +171,14 @@ void recent_releases::on_data_synced(const data_t &data, const data_t &prev_data
     log::global->info("A recent releases cache is found, next update in {}",
         utils::format("{:%T}", get_expires_at() - clock_t::now()));
 
-    const std::unordered_set<simplified_album_t> prev_releases(prev_data.begin(), prev_data.end());
+    std::unordered_set<spotify_id_t> prev_releases;
+    prev_releases.reserve(prev_data.size());
+    for (const auto &album: prev_data)
+        prev_releases.insert(spotify_id_t(album.id));
 
     recent_releases_t result;
     for (const auto &album: data)
-        if (!prev_releases.contains(album))
+        if (!prev_releases.contains(spotify_id_t(album.id)))
             result.push_back(album);
 
     if (result.size() > 0)
@@ -44,6 +44,53 @@ bool modify_requester::execute(api_weak_ptr_t api_proxy)
     return true;
 }
 
+void revalidate_stale(api_weak_ptr_t api_proxy, std::vector<string> urls,
+    utils::clock_t::duration cache_for, std::function<void()> on_changed)
+{
+    auto api = api_proxy.lock();
+    if (!api || urls.empty()) return;
+
+    // the revalidation is not urgent, the caller has got its data already, so the
+    // requests are made one by one and yield to the user's ones
+    detach_prioritized_task(api->get_pool(), request_priority::background,
+        [api_proxy, urls = std::move(urls), cache_for, on_changed]
+        {
+            bool is_changed = false;
+            for (const auto &url: urls)
+            {
+                auto api = api_proxy.lock();
+                if (!api) return;
+
+                // the cached responses are keyed by the domain-trimmed urls
+                auto cache = api->get_http_cache();
+                const auto &key = url.starts_with("/") ? url : http::trim_domain(url);
+                auto get_version = [cache, &key]
+                {
+                    auto entry = cache->peek(key);
+                    return entry != nullptr ? entry->version : 0;
+                };
+
+                auto version = get_version();
+
+                auto res = api->get(url, cache_for);
+                if (!utils::http::is_success(res))
+                {
+                    log::api->warn("The stale response revalidation failed: '{}', url '{}'",
+                        utils::http::get_status_message(res), url);
+                    continue;
+                }
+
+                // both the 304 response and the cache hit of the response, revalidated by
+                // some other caller already, keep the cached version, only a new body changes it
+                if (get_version() != version)
+                    is_changed = true;
+            }
+
+            if (is_changed && on_changed)
+                on_changed();
+        });
+}
+
 httplib::Result put_requester::execute_request(api_interface *api)
 {
     return api->put(get_url(), get_body());
@@ -4,6 +4,7 @@
 
 #include "stdafx.h"
 #include "utils.hpp"
+#include "cache.hpp"
 #include "interfaces.hpp"
 #include "observer_protocols.hpp"
 
@@ -31,6 +32,14 @@ void playback_cmd_error(const utils::string_view &msg_fmt, Args &&...args)
         &api_requests_observer::on_playback_command_failed, formatted);
 }
 
+/// @brief Revalidates the stale cached responses of the given `urls` one by one in the
+/// background, see `cache_policy::stale_while_revalidate`
+/// @param on_changed a handler, called from the background thread once all the responses
+/// are revalidated, in case any of them turned out to be modified; the failed ones are
+/// skipped, they do not hide the changes of the others
+void revalidate_stale(api_weak_ptr_t api_proxy, std::vector<string> urls,
+    utils::clock_t::duration cache_for, std::function<void()> on_changed = nullptr);
+
 /// @brief A helper-formatter to get an error message of a collection fetching requester
 template<class R>
 string get_fetching_error(const R &requester)
@@ -224,11 +233,13 @@ public:
 /// @tparam T a final result's type
 /// @tparam N a number of days/hours/mins etc. the request's result will be cached for
 /// @tparam C a caching class type: std::chrono::seconds, *::milliseconds, *::weeks etc.
-template<class T, int N, class C>
+/// @tparam P a way the expired cached result is treated, see `cache_policy`
+template<class T, int N, class C, cache_policy P>
 class item_requester
 {
 public:
     using result_t = T;
+    static constexpr bool is_stale_allowed = P == cache_policy::stale_while_revalidate;
 public:
     /// @param url a url to request
     /// @param params get-request parameters to infuse into given `url`
@@ -239,12 +250,34 @@ public:
         fieldname(fieldname)
         {}
     
-    /// @brief Returns a result. Valid only after a successful request
-    auto get() const -> const result_t& { return result; }
+    /// @brief Returns a result, the one shared with the objects cache is returned as is.
+    /// Valid only after a successful request
+    auto get() const -> const result_t& { return shared != nullptr ? *shared : result; }
+
+    /// @brief Moves the result out of the requester, so the caller takes it over; the
+    /// requester's result is left empty. The result shared with the objects cache is immutable,
+    /// so it is moved only if nobody else holds it, otherwise the caller gets its copy.
+    /// Valid only after a successful request
+    auto extract() -> result_t&&
+    {
+        if (shared != nullptr)
+        {
+            if (shared.use_count() == 1)
+                result = std::move(const_cast<result_t&>(*shared));
+            else
+                result = *shared;
+            shared.reset();
+        }
+        return std::move(result);
+    }
 
     /// @brief Returns the target url
     auto get_url() const -> const string& { return url; }
 
+    /// @brief Returns the http cache version of the response the result is read from, zero
+    /// if it is not cached. Valid only after a successful request
+    auto get_version() const -> uint64_t { return version; }
+
     /// @brief Returns the http-result object
     /// @note result is valid only after a proper request
     auto get_response() const -> const httplib::Result& { return response; }
@@ -252,11 +285,15 @@ public:
     /// @brief Tells, whether the response is different from the cached one
     bool is_modified() const { return response && response->status != httplib::NotModified_304; }
 
+    /// @brief Tells, whether the result is the expired cached one, which is being
+    /// revalidated in the background
+    bool is_stale() const { return utils::http::is_stale(response); }
+
     /// @brief Checks whether the requested result has already been cached and
     /// cab be obtained quickly without a delay
     bool is_cached(api_weak_ptr_t api) const
     {
-        return !api.expired() && api.lock()->is_request_cached(get_url());
+        return !api.expired() && api.lock()->is_request_cached(get_url(), is_stale_allowed);
     }
 
     /// @brief Launches a requester and retrieves a result over http. If `only_cache` is true,
@@ -269,18 +306,39 @@ public:
     /// no cache exists
     bool execute(api_weak_ptr_t api_proxy, bool only_cached = false, bool retry_429 = false)
     {
+        version = 0;
+        shared.reset();
+
         if (only_cached && !is_cached(api_proxy))
             return true;
 
-        if (api_proxy.expired()) return false;
+        auto api = api_proxy.lock();
+        if (!api) return false;
 
-        response = api_proxy.lock()->get(url, C{ N }, retry_429);
+        // the result, parsed from the same valid cached response before, is taken as is
+        auto *objects = api->get_objects_cache();
+        if (auto object = objects->get(url, typeid(*this)))
+        {
+            response = httplib::Result(std::make_unique<httplib::Response>(), httplib::Error::Success);
+            response->status = httplib::OK_200;
+
+            load_parsed(object);
+            version = get_cached_version(*api);
+            return true;
+        }
+
+        auto parsed_version = objects->get_version(url);
+
+        response = api->get(url, C{ N }, retry_429, is_stale_allowed);
         if (!is_success(response))
         {
             log::api->error("There is an error while executing API GET request '{}', "
                 "url '{}'", utils::http::get_status_message(response), url);
             return false;
         }
+
+        if (is_stale())
+            on_stale_served(api_proxy);
         
         try
         {
@@ -288,14 +346,12 @@ public:
             if (response->status == httplib::NoContent_204)
                 return true;
             
-            json::Document doc;
-            doc.Parse(response->body);
-            
-            json::Value &body = doc;
-            if (!fieldname.empty())
-                body = body[fieldname];
+            on_read_body(response->body, result);
 
-            on_read_result(body, result);
+            objects->put(url, typeid(*this), parsed_version, share_parsed());
+
+            // the fresh response is stored by the request itself, so its version is taken after it
+            version = get_cached_version(*api);
             return true;
         }
         catch (const std::exception &ex)
@@ -308,6 +364,42 @@ public:
 protected:
     virtual bool is_success(const httplib::Result &r) const { return utils::http::is_success(r); }
 
+    /// @brief Called when the expired cached result is returned, by default the response
+    /// is revalidated in the background right away
+    virtual void on_stale_served(api_weak_ptr_t api_proxy)
+    {
+        revalidate_stale(api_proxy, { url }, C{ N });
+    }
+
+    /// @brief Moves the parsed result into the immutable object to be kept in the objects
+    /// cache, the requester shares it from then on; the derived classes, parsing some extra
+    /// data from the body, should keep it as well
+    virtual auto share_parsed() -> objects_cache::object_ptr
+    {
+        shared = std::make_shared<T>(std::move(result));
+        return shared;
+    }
+
+    /// @brief Shares the result of the `object`, kept by `share_parsed` before, with no copying
+    virtual void load_parsed(const objects_cache::object_ptr &object)
+    {
+        shared = std::static_pointer_cast<const T>(object);
+    }
+
+    /// @brief Parses the response's raw `body` into the `result`. By default the body is
+    /// parsed into a DOM document, which is passed further to `on_read_result`
+    virtual void on_read_body(const string &body, T &result)
+    {
+        json::Document doc;
+        doc.Parse(body);
+        
+        json::Value &value = doc;
+        if (!fieldname.empty())
+            value = value[fieldname];
+
+        on_read_result(value, result);
+    }
+
     /// @brief Provides a way for derived classes to specify result parsing approach
     /// @param body parsed response body
     /// @param result a reference to the result to hold
@@ -315,17 +407,30 @@ protected:
     {
         from_json(body, result);
     }
+
+    /// @brief Returns the version of the `url` response, the http cache holds now
+    auto get_cached_version(api_interface &api) const -> uint64_t
+    {
+        auto entry = api.get_http_cache()->peek(url.starts_with("/") ? url : utils::http::trim_domain(url));
+        return entry != nullptr ? entry->version : 0;
+    }
 protected:
     string fieldname;
     string url;
     result_t result;
+    // the parsed result, once it is shared; it is never changed while being shared, but it
+    // is not created const, so the last holder can move it out, see `extract`
+    std::shared_ptr<const result_t> shared;
     httplib::Result response;
+    uint64_t version = 0;
 };
 
 
 /// @brief A class-helper, used for requesting several items from Spotify. As their
 /// API allows requesting with a limited number of items, the requester implements
-/// an interface to get data by chunks, stores them in one container and the returns
+/// an interface to get data by chunks, stores them in one container and the returns.
+/// The chunks are requested in parallel on the api's requests pool, paced by the same
+/// rate-limit budget as all the other requests, the result keeps the order of the ids
 /// @tparam T a type of the data returned, iterable
 /// @tparam N a number of days/hours/mins etc. the request's result will be cached for
 /// @tparam C a caching class type: std::chrono::seconds, *::milliseconds, *::weeks etc.
@@ -335,6 +440,15 @@ class several_items_requester
 {
 public:
     using result_t = ContainerT;
+    using chunk_requester_t = item_requester<result_t, N, C>;
+
+    /// @brief A chunk of the ids, which was not requested well
+    struct failed_chunk_t
+    {
+        size_t offset; // the offset of the chunk's first id
+        size_t size;
+        const chunk_requester_t *requester;
+    };
 public:
     /// @param chunk_size a max size of a data chunk to request
     /// @param data_field some responses have nested data under `data_field` key name
@@ -348,50 +462,99 @@ public:
     /// @brief Returns a result. Valid only after a successful request
     auto get() const -> const result_t& { return result; }
 
-    /// @brief Returns the last processes response object
-    auto get_response() const -> const httplib::Result& { return response; }
+    /// @brief Returns the response of the first failed chunk, or of the last chunk if all
+    /// of them are requested well; empty if there were no requests
+    auto get_response() const -> const httplib::Result&
+    {
+        static const httplib::Result none;
+
+        if (!failed_chunks.empty())
+            return failed_chunks.front().requester->get_response();
+        return requesters.empty() ? none : requesters.back()->get_response();
+    }
+
+    /// @brief Returns the chunks, which were not requested well, in the order of the ids
+    auto get_failed_chunks() const -> const std::vector<failed_chunk_t>& { return failed_chunks; }
 
     auto get_url() const -> const string& { return url; }
 
-    /// @brief see `item_requester::execute` interface
-    bool execute(api_weak_ptr_t api, bool only_cached = false, bool silent = false, bool retry_429 = false)
+    /// @brief see `item_requester::execute` interface. If some of the chunks fail, the
+    /// `false` is returned, the result holds the items of the rest of them in order
+    bool execute(api_weak_ptr_t api_proxy, bool only_cached = false, bool silent = false, bool retry_429 = false)
     {   
         result.clear();
+        failed_chunks.clear();
 
-        auto chunk_begin = ids.begin();
-        auto chunk_end = ids.begin();
+        auto api = api_proxy.lock();
+        if (!api) return false;
+
+        const auto chunks_count = (ids.size() + chunk_size - 1) / chunk_size;
         
         requester_progress_notifier notifier(url, !silent);
-        
-        do
+        std::atomic<size_t> items_received = 0;
+
+        requesters.clear();
+        for (size_t idx = 0; idx < chunks_count; ++idx)
         {
-            if (std::distance(chunk_end, ids.end()) <= chunk_size)
-                chunk_end = ids.end(); // the number of ids is less than the max chunk size
-            else
-                std::advance(chunk_end, chunk_size); // ..or just advance iterator further
+            auto first = ids.begin() + idx * chunk_size;
+            auto last = idx + 1 < chunks_count ? first + chunk_size : ids.end();
 
-            notifier.send_progress(result.size(), ids.size());
+            requesters.push_back(std::make_unique<chunk_requester_t>(url, httplib::Params{
+                { "ids", utils::string_join(item_ids_t(first, last), ",") },
+            }, data_field));
+        }
 
-            item_requester<result_t, N, C> requester(url, {
-                { "ids", utils::string_join(item_ids_t(chunk_begin, chunk_end), ",") },
-            }, data_field);
+        std::vector<char> is_succeeded(chunks_count, false);
 
-            if (!requester.execute(api, only_cached, retry_429))
-                return false;
-            
-            const auto &items = requester.get();
-            result.insert(result.end(), items.begin(), items.end());
-        
-            chunk_begin = chunk_end;
+        auto execute_chunk = [&](size_t idx)
+        {
+            is_succeeded[idx] = requesters[idx]->execute(api_proxy, only_cached, retry_429);
+            if (is_succeeded[idx])
+                notifier.send_progress(items_received += requesters[idx]->get().size(), ids.size());
+        };
+
+        // the requests pool's own tasks would wait for the chunks queued behind them,
+        // so the requester, executed from there, requests them one by one
+        if (chunks_count > 1 && BS::this_thread::get_pool() != (void*)&api->get_pool())
+        {
+            auto priority = request_priority_scope::get_current();
+
+            api->get_pool().submit_sequence((size_t)0, chunks_count, [&execute_chunk, priority](size_t idx)
+                {
+                    request_priority_scope scope(priority);
+                    execute_chunk(idx);
+                }, get_pool_priority(priority)).wait();
+        }
+        else
+        {
+            for (size_t idx = 0; idx < chunks_count; ++idx)
+                execute_chunk(idx);
         }
-        while (std::distance(chunk_begin, ids.end()) > 0); // there are still items between iterators
 
-        return true;
+        for (size_t idx = 0; idx < chunks_count; ++idx)
+        {
+            if (!is_succeeded[idx])
+            {
+                failed_chunks.push_back({ idx * chunk_size,
+                    std::min(chunk_size, ids.size() - idx * chunk_size), requesters[idx].get() });
+                continue;
+            }
+
+            auto items = requesters[idx]->extract();
+            result.insert(result.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+        }
+
+        for (const auto &chunk: failed_chunks)
+            log::api->error("The chunk of the items was not received, offset {}, size {}, {}",
+                chunk.offset, chunk.size, get_fetching_error(chunk.requester));
+
+        return failed_chunks.empty();
     }
 private:
-    httplib::Result response;
+    std::vector<std::unique_ptr<chunk_requester_t>> requesters;
+    std::vector<failed_chunk_t> failed_chunks;
     result_t result;
-    ptrdiff_t chunk_size;
+    size_t chunk_size;
     item_ids_t ids;
     string data_field;
     string url;
@@ -402,11 +565,12 @@ private:
 /// @tparam T a final result's type
 /// @tparam N a number of days/hours/mins etc. the request's result will be cached for
 /// @tparam C a caching class type: std::chrono::seconds, *::milliseconds, *::weeks etc.
-template<class T, int N, class C>
-class collection_requester: public item_requester<T, N, C>
+/// @tparam P a way the expired cached result is treated, see `cache_policy`
+template<class T, int N, class C, cache_policy P>
+class collection_requester: public item_requester<T, N, C, P>
 {
 public:
-    using item_requester<T, N, C>::item_requester;
+    using item_requester<T, N, C, P>::item_requester;
 
     /// @brief Return a valid `url` to the next page in case it exists
     /// @note works only a successful request
@@ -415,44 +579,104 @@ public:
     /// @brief Returns a total amount of items in collection
     /// @note works only a successful request
     size_t get_total() const { return total; }
+
+    /// @brief Returns the total of the page's previous response, kept in the caches, even
+    /// the expired one; no request is made. Zero, if there is no such response
+    size_t peek_total(api_weak_ptr_t api_proxy) const
+    {
+        auto api = api_proxy.lock();
+        if (!api) return 0;
+
+        if (auto object = api->get_objects_cache()->get(this->url, typeid(*this)))
+            return std::static_pointer_cast<const page_t>(object)->total;
+
+        try
+        {
+            auto entry = api->get_http_cache()->get(utils::http::trim_domain(this->url));
+            if (entry == nullptr || entry->body.empty())
+                return 0;
+
+            json::page_reader reader;
+            reader.read_total(entry->get_body(), this->fieldname);
+            return reader.get_total();
+        }
+        catch (const std::exception &ex)
+        {
+            log::api->warn("Could not read the cached page's total, {}, url {}", ex.what(), this->url);
+            return 0;
+        }
+    }
+
+    /// @brief Sets a handler, called from the requesting thread as soon as the page's `next`
+    /// url is read from the response, before the rest of the page is; it is not called for
+    /// the pages taken from the objects cache
+    void set_next_handler(json::page_reader::next_handler_t handler) { on_next = std::move(handler); }
 protected:
-    /// @brief A response body parser specialization to get all the necessary fields,
-    /// to process further with collection requesting
-    void on_read_result(const json::Value &body, T &result) override
+    /// @brief The pages are read in a streaming manner: the items are put into the `result`
+    /// one by one as they are parsed, with no DOM of the whole page built
+    void on_read_body(const string &body, T &result) override
     {
-        from_json(body["items"], result);
+        json::read_page(body, this->fieldname, result, total, next, on_next);
+    }
 
-        if (body.HasMember("total") && !body["total"].IsNull())
-            total = body["total"].GetUint();
+    /// @brief The stale pages are revalidated by the collection at once, when all
+    /// of them are received, see `collection_abstract::revalidate`
+    void on_stale_served(api_weak_ptr_t api_proxy) override {}
 
-        if (body.HasMember("next") && !body["next"].IsNull())
-            next = body["next"].GetString();
-        else
-            next = "";
+    /// @brief The page is kept together with its total and next url, the requester shares
+    /// its items only
+    auto share_parsed() -> objects_cache::object_ptr override
+    {
+        auto page = std::make_shared<page_t>(std::move(this->result), total, next);
+        this->shared = std::shared_ptr<const T>(page, &page->items);
+        return page;
+    }
+
+    void load_parsed(const objects_cache::object_ptr &object) override
+    {
+        auto page = std::static_pointer_cast<const page_t>(object);
+        total = page->total;
+        next = page->next;
+        this->shared = std::shared_ptr<const T>(page, &page->items);
     }
 private:
+    /// @brief A parsed page, as it is kept in the objects cache
+    struct page_t
+    {
+        T items;
+        size_t total;
+        string next;
+    };
+
     size_t total = 0;
     string next = "";
+    json::page_reader::next_handler_t on_next;
 };
 
 
-/// @brief An abstract class of an API collection object. Behaves like a vector,
+/// @brief An abstract class of an API collection object. Behaves like a read-only vector,
 /// always empty after creation and has to be populated manually. Provides an interface
 /// to fetch collection from the server or to get total count of items held in collection
 /// without fetching all the data.
+///
+/// The fetched items are an immutable snapshot, shared with the other collection objects
+/// of the same url through the api's `collections_registry`: while the responses of its
+/// pages stay the same, the collection is not fetched again, it takes the snapshot as it is
 /// @tparam T a final result's type
 /// @tparam N a number of days/hours/mins etc. the request's result will be cached for
 /// @tparam C a caching class type: std::chrono::seconds, *::milliseconds, *::weeks etc.
-template<class T, int N, class C>
-class collection_abstract:
-    public std::vector<T>,
-    public collection_interface
+/// @tparam P a way the expired cached pages are treated, see `cache_policy`
+template<class T, int N, class C, cache_policy P>
+class collection_abstract: public collection_interface
 {
 public:
-    using base_t = std::vector<T>;
     using container_t = std::vector<T>;
-    using requester_t = collection_requester<container_t, N, C>;
+    using requester_t = collection_requester<container_t, N, C, P>;
     using requester_ptr = std::shared_ptr<requester_t>;
+    using value_type = T;
+    using size_type = typename container_t::size_type;
+    using const_iterator = typename container_t::const_iterator;
+    using iterator = const_iterator;
 public:
     /// @param url a url to request
     /// @param params get-request parameters to infuse into given `url`
@@ -467,6 +691,21 @@ public:
 
     auto get_url() const -> const string& { return url; }
 
+    auto begin() const -> const_iterator { return snapshot->begin(); }
+    auto end() const -> const_iterator { return snapshot->end(); }
+    auto cbegin() const -> const_iterator { return snapshot->cbegin(); }
+    auto cend() const -> const_iterator { return snapshot->cend(); }
+    auto size() const -> size_type { return snapshot->size(); }
+    bool empty() const { return snapshot->empty(); }
+    auto operator[](size_type idx) const -> const T& { return (*snapshot)[idx]; }
+    auto front() const -> const T& { return snapshot->front(); }
+    auto back() const -> const T& { return snapshot->back(); }
+
+    /// @brief Returns the version of the collection's items: it changes every time they are
+    /// fetched anew and stays the same while the shared snapshot is taken, so the holders can
+    /// tell the change cheaply. Zero for the items, which are not shared
+    auto get_version() const -> uint64_t { return version; }
+
     size_t get_total() const override
     {
         if (populated) // if the collection is populated, return its size
@@ -502,7 +741,10 @@ public:
 
     void clear()
     {
-        base_t::clear();
+        snapshot = get_empty_snapshot();
+        building = nullptr;
+        sources.clear();
+        version = 0;
         populated = false;
     }
 
@@ -512,12 +754,19 @@ public:
     /// @param pages_to_request number of data pages to request; "0" means all
     bool fetch(bool only_cached = false, bool silent = false, size_t pages_to_request = 0) override
     {
+        if (find_shared(pages_to_request))
+            return true;
+
         clear();
+        start_building();
 
         if (!fetch_items(api_proxy, only_cached, silent, pages_to_request))
+        {
+            building = nullptr;
             return false;
+        }
 
-        populated = true;
+        publish(pages_to_request);
 
         return true;
     }
@@ -532,12 +781,99 @@ protected:
     /// @param silent 1. does not send watcher updates; 2. no retries requesting policy
     /// @param pages_to_request number of data pages to request; "0" means all
     virtual bool fetch_items(api_weak_ptr_t api, bool only_cached, bool silent = false, size_t pages_to_request = 0) = 0;
+
+    /// @brief Returns a handler, which is called from a background thread, once the pages
+    /// served stale are revalidated and some of them turned out to be changed. The collection
+    /// object itself may be gone by that time, so the handler should not refer to it
+    virtual auto get_revalidated_handler() const -> std::function<void()> { return nullptr; }
+
+    /// @brief Revalidates the pages, which were served stale from the cache, in the background
+    /// @param stale_urls the urls of the stale pages, the empty ones are skipped
+    void revalidate(api_weak_ptr_t api, std::vector<string> stale_urls) const
+    {
+        std::erase(stale_urls, "");
+        if (!stale_urls.empty())
+            revalidate_stale(api, std::move(stale_urls), C{ N }, get_revalidated_handler());
+    }
+
+    /// @brief Returns the items being fetched, valid only while `fetch_items` is running
+    auto get_items() -> container_t& { return *building; }
+
+    /// @brief Starts the new items to be fetched, the collection reads them right away
+    auto start_building() -> std::shared_ptr<container_t>
+    {
+        building = std::make_shared<container_t>();
+        snapshot = building;
+        return building;
+    }
+
+    /// @brief Adds the page's response to the ones the fetched items are made of
+    /// @param url the page's url, with the domain or without it
+    /// @param version the http cache version of the response, see `item_requester::get_version`
+    void add_source(const string &url, uint64_t version)
+    {
+        sources.push_back({ url.starts_with("/") ? url : utils::http::trim_domain(url), version });
+    }
+
+    /// @brief Takes the snapshot of the same url and pages, fetched before by any of the
+    /// collection objects, in case it is current; its stale pages are revalidated in the
+    /// background, the same as the collection's own ones are
+    bool find_shared(size_t pages_to_request)
+    {
+        auto api = api_proxy.lock();
+        if (!api) return false;
+
+        std::vector<string> stale_urls;
+        uint64_t shared_version = 0;
+
+        auto shared = api->get_collections()->find(get_registry_key(pages_to_request), typeid(container_t),
+            shared_version, P == cache_policy::stale_while_revalidate ? &stale_urls : nullptr);
+        if (shared == nullptr)
+            return false;
+
+        clear();
+        snapshot = std::static_pointer_cast<const container_t>(shared);
+        version = shared_version;
+        populated = true;
+
+        revalidate(api_proxy, std::move(stale_urls));
+        return true;
+    }
+
+    /// @brief Finishes the fetched items and shares them; from now on they are not changed
+    void publish(size_t pages_to_request)
+    {
+        populated = true;
+
+        auto items = std::move(building);
+        if (auto api = api_proxy.lock())
+            version = api->get_collections()->publish(get_registry_key(pages_to_request),
+                typeid(container_t), std::move(sources), std::move(items));
+        sources.clear();
+    }
+
+    /// @brief The collections fetched partially are kept apart from the whole ones
+    auto get_registry_key(size_t pages_to_request) const -> string
+    {
+        return utils::format("{}#{}", httplib::append_query_params(url, params), pages_to_request);
+    }
+
+    static auto get_empty_snapshot() -> const std::shared_ptr<const container_t>&
+    {
+        static const auto empty = std::make_shared<const container_t>();
+        return empty;
+    }
 protected:
     api_weak_ptr_t api_proxy;
     string url;
     string fieldname;
     httplib::Params params;
     bool populated = false;
+
+    std::shared_ptr<const container_t> snapshot = get_empty_snapshot(); // the items the collection reads
+    std::shared_ptr<container_t> building; // the same items, while they are being fetched
+    std::vector<collections_registry::source_t> sources; // the responses the fetched items are made of
+    uint64_t version = 0;
 };
 
 
@@ -546,11 +882,12 @@ protected:
 /// @tparam T a final result's type
 /// @tparam N a number of days/hours/mins etc. the request's result will be cached for
 /// @tparam C a caching class type: std::chrono::seconds, *::milliseconds, *::weeks etc.
-template<class T, int N, class C>
-class sync_collection: public collection_abstract<T, N, C>
+/// @tparam P a way the expired cached pages are treated, see `cache_policy`
+template<class T, int N, class C, cache_policy P>
+class sync_collection: public collection_abstract<T, N, C, P>
 {
 public:
-    using base_t = collection_abstract<T, N, C>;
+    using base_t = collection_abstract<T, N, C, P>;
     using typename base_t::requester_t;
     using typename base_t::requester_ptr;
     using base_t::collection_abstract;
@@ -570,10 +907,23 @@ protected:
         auto requester = get_begin_requester();
         requester_progress_notifier notifier(requester->get_url(), !silent);
 
+        std::vector<string> stale_urls;
+
+        // the requests pool's own tasks would wait for the pages queued behind them,
+        // so the collection, fetched from there, requests them one by one
+        const auto pool = api.lock();
+        const bool is_pipelined = pool && BS::this_thread::get_pool() != (void*)&pool->get_pool();
+
+        pipeline_ctx_t ctx{ api, this->fieldname, only_cached, silent, is_pipelined,
+            request_priority_scope::get_current() };
+        auto pipelined = pipeline(ctx, *requester, pages_to_request);
+
+        bool is_executed = requester->execute(api, only_cached, !silent);
+
         while (requester != nullptr)
         {
             // if some of the pages were not requested well, all the operation is aborted
-            if (!requester->execute(api, only_cached, !silent))
+            if (!is_executed)
             {
                 dispatch_event(&api_requests_observer::on_collection_fetching_failed,
                     get_fetching_error(requester));
@@ -582,6 +932,11 @@ protected:
 
             if (requester->is_modified())
                 modified = true;
+
+            if (requester->is_stale())
+                stale_urls.push_back(requester->get_url());
+
+            this->add_source(requester->get_url(), requester->get_version());
             
             auto total = requester->get_total();
             if (pages_to_request > 0)
@@ -590,47 +945,190 @@ protected:
             notifier.send_progress(this->size(), total);
 
             // reserving all the container length space at once
-            if (this->capacity() != total)
-                this->reserve(total);
+            auto &items = this->get_items();
+            if (items.capacity() != total)
+                items.reserve(total);
             
-            const auto &items = requester->get();
-            this->insert(this->end(), items.begin(), items.end());
+            auto page = requester->extract();
+            items.insert(items.end(), std::make_move_iterator(page.begin()), std::make_move_iterator(page.end()));
             
             if (--pages_to_request <= 0) break;
     
-            const auto &next_url = requester->get_next_url();
-            if (!next_url.empty())
-                requester = requester_ptr(new requester_t(next_url, {}, this->fieldname));
-            else
+            const auto next_url = requester->get_next_url();
+            if (next_url.empty())
+            {
                 requester = nullptr;
+            }
+            else if (pipelined->requester != nullptr)
+            {
+                // the next page has been requested already, while this one was being read
+                requester = pipelined->requester;
+                is_executed = pipelined->execution.get();
+                pipelined = pipelined->next;
+            }
+            else
+            {
+                // the page was taken from the objects cache, its `next` url was not reported
+                requester = requester_ptr(new requester_t(next_url, {}, this->fieldname));
+                pipelined = pipeline(ctx, *requester, pages_to_request);
+                is_executed = requester->execute(api, only_cached, !silent);
+            }
         }
 
+        this->revalidate(api, std::move(stale_urls));
+
         return true;
     }
 private:
+    /// @brief The settings of the pages requested ahead, the same as the collection's ones
+    struct pipeline_ctx_t
+    {
+        api_weak_ptr_t api_proxy;
+        string fieldname;
+        bool only_cached, silent;
+        bool is_pipelined; // the pages are not requested ahead, if false
+        request_priority priority;
+    };
+
+    /// @brief The page requested ahead: its requester is set and the request is launched
+    /// as soon as the previous page's `next` url is read
+    struct pipelined_page_t
+    {
+        requester_ptr requester;
+        std::future<bool> execution;
+        std::shared_ptr<pipelined_page_t> next; // the page following this one
+    };
+
+    using pipelined_ptr = std::shared_ptr<pipelined_page_t>;
+
+    /// @brief Makes the `requester` request its next page in the background, once the
+    /// `next` url is read from the response, so the page's round-trip overlaps with reading
+    /// the rest of the current one; the chain goes on the same way with the next pages
+    /// @param pages_left the amount of the pages to request, including the current one,
+    /// zero means all of them
+    static auto pipeline(const pipeline_ctx_t &ctx, requester_t &requester, size_t pages_left) -> pipelined_ptr
+    {
+        auto pipelined = std::make_shared<pipelined_page_t>();
+        if (pages_left == 1 || !ctx.is_pipelined)
+            return pipelined;
+
+        // the handler is called before `execute` is finished, the page is not read by
+        // the collection until then, so the handler is its only writer
+        requester.set_next_handler([ctx, pipelined, pages_left](const string &next_url)
+        {
+            auto api = ctx.api_proxy.lock();
+            if (!api) return;
+
+            auto next = requester_ptr(new requester_t(next_url, {}, ctx.fieldname));
+            pipelined->next = pipeline(ctx, *next, pages_left > 1 ? pages_left - 1 : 0);
+            pipelined->requester = next;
+            pipelined->execution = api->get_pool().submit_task([ctx, next]
+                {
+                    request_priority_scope scope(ctx.priority);
+                    return next->execute(ctx.api_proxy, ctx.only_cached, !ctx.silent);
+                }, get_pool_priority(ctx.priority));
+        });
+        return pipelined;
+    }
+
     bool modified = false;
 };
 
 
 /// @brief The items collection, which populates itself, requesting data
 /// from the server asynchronously. Once all the responseы are received,
-/// accumulates them in the right order.
+/// accumulates them in the right order. The collection can be streamed as well,
+/// getting its items page by page as they come, see `stream`
 /// @tparam T a final result's type
 /// @tparam N a number of days/hours/mins etc. the request's result will be cached for
 /// @tparam C a caching class type: std::chrono::seconds, *::milliseconds, *::weeks etc.
-template<class T, int N, class C>
-class async_collection: public collection_abstract<T, N, C>
+/// @tparam P a way the expired cached pages are treated, see `cache_policy`
+template<class T, int N, class C, cache_policy P>
+class async_collection:
+    public collection_abstract<T, N, C, P>,
+    public std::enable_shared_from_this<async_collection<T, N, C, P>>
 {
 public:
-    using base_t = collection_abstract<T, N, C>;
+    using base_t = collection_abstract<T, N, C, P>;
+    using typename base_t::container_t;
     using typename base_t::requester_t;
     using typename base_t::requester_ptr;
     using base_t::collection_abstract;
+
+    /// @brief A handler, called from the plugin's main thread every time the streamed
+    /// collection gets its next items
+    /// @param is_finished the collection is complete or its fetching is failed, the
+    /// handler is not called anymore
+    using stream_handler_t = std::function<void(bool is_finished)>;
     
     bool is_modified() const override
     {
         return modified;
     }
+
+    /// @brief Fetches the collection in the background, not blocking the caller. The pages
+    /// are requested the same way `fetch` does it, but every page is appended to the collection
+    /// as soon as it and all the pages before it are received, so the first items are there
+    /// after one round-trip. The items are appended from the plugin's main thread, the one
+    /// the collection is read from; the space for all the pages, counted by the first one,
+    /// is reserved with it, so the items appended earlier are never moved. If the collection is gone by then,
+    /// the items are dropped and the `handler` is not called. The current shared snapshot
+    /// is taken at once, the `handler` is called the same way then
+    /// @note the collection should be owned by a shared pointer
+    bool stream(stream_handler_t handler, bool silent = false)
+    {
+        auto api = this->api_proxy.lock();
+        if (!api) return false;
+
+        if (this->find_shared(0))
+        {
+            utils::far3::synchro_tasks::push([owner = this->weak_from_this(), handler = std::move(handler)]
+                {
+                    if (owner.lock() && handler)
+                        handler(true);
+                }, "collection shared items task");
+            return true;
+        }
+
+        this->clear();
+
+        auto state = std::make_shared<stream_state_t>(this->weak_from_this(), std::move(handler),
+            this->start_building(), this->url, this->params, this->fieldname, !silent);
+
+        detach_prioritized_task(api->get_pool(), request_priority_scope::get_current(),
+            [state, api_proxy = this->api_proxy]
+            {
+                auto requester = state->make_requester(0);
+                if (!requester->execute(api_proxy, false, state->is_retrying))
+                    return on_stream_failed(state, get_fetching_error(requester));
+
+                const auto total = requester->get_total();
+                const auto pages_count = std::max((size_t)1, (total + max_limit - 1) / max_limit);
+                {
+                    std::lock_guard lock(state->guard);
+                    state->total = total;
+                    state->pages.resize(pages_count);
+                    state->sources.resize(pages_count);
+                }
+                on_page_received(state, 0, *requester);
+
+                auto api = api_proxy.lock();
+                if (!api) return on_stream_failed(state, "the api is gone");
+
+                // the pages inherit the priority of the task, see `detach_prioritized_task`
+                for (size_t idx = 1; idx < pages_count; ++idx)
+                    detach_prioritized_task(api->get_pool(), request_priority_scope::get_current(),
+                        [state, api_proxy, idx]
+                        {
+                            auto requester = state->make_requester(idx * max_limit);
+                            if (requester->execute(api_proxy, false, state->is_retrying))
+                                on_page_received(state, idx, *requester);
+                            else
+                                on_stream_failed(state, get_fetching_error(requester));
+                        });
+            });
+        return true;
+    }
 protected:
     requester_ptr get_begin_requester() const override
     {
@@ -640,10 +1138,14 @@ protected:
     // a collection's requester fabric
     requester_ptr make_requester(size_t offset) const
     {
-        auto updated_params = this->params;
-        updated_params.insert(std::pair{ "offset", std::to_string(offset) });
+        return make_requester(this->url, this->params, this->fieldname, offset);
+    }
 
-        return requester_ptr(new requester_t(this->url, updated_params, this->fieldname));
+    static requester_ptr make_requester(const string &url, httplib::Params params,
+        const string &fieldname, size_t offset)
+    {
+        params.insert(std::pair{ "offset", std::to_string(offset) });
+        return requester_ptr(new requester_t(url, params, fieldname));
     }
 
     bool fetch_items(api_weak_ptr_t api_proxy, bool only_cached, bool silent = false, size_t pages_to_request = 0) override
@@ -654,42 +1156,143 @@ protected:
 
         requester_progress_notifier notifier(requester->get_url(), !silent);
 
-        // performing the first request to obtain a total number fo items
-        if (!requester->execute(api_proxy, only_cached, !silent))
+        pages_t result;
+
+        // the total of the previous response tells the amount of the pages ahead, so they are
+        // all requested at once together with the first one, saving it a round-trip; the
+        // pages are reconciled with the actual total afterwards
+        size_t total = 0;
+        if (const auto known_total = only_cached ? 0 : requester->peek_total(api_proxy);
+            get_pages_count(known_total, pages_to_request) > 1)
         {
-            dispatch_event(&api_requests_observer::on_collection_fetching_failed,
-                get_fetching_error(requester));
-            return false;
+            result.resize(get_pages_count(known_total, pages_to_request));
+            if (!fetch_pages(api_proxy, 0, result, known_total, notifier, only_cached, silent))
+                return false;
+
+            total = result.first_total;
+        }
+        else
+        {
+            // performing the first request to obtain a total number fo items
+            if (!requester->execute(api_proxy, only_cached, !silent))
+            {
+                dispatch_event(&api_requests_observer::on_collection_fetching_failed,
+                    get_fetching_error(requester));
+                return false;
+            }
+
+            if (requester->is_modified())
+                modified = true;
+
+            total = requester->get_total();
+
+            result.resize(1);
+            result.pages[0] = requester->extract();
+            result.sources[0] = { requester->get_url(), requester->get_version() };
+            if (requester->is_stale())
+                result.stale_urls[0] = requester->get_url();
         }
-        
-        if (requester->is_modified())
-            modified = true;
 
-        size_t total = requester->get_total();
         if (total == 0) // if there is no entries, the results is still valid
+        {
+            // the first page tells it, the surplus ones are dropped
+            result.resize(1);
+            add_sources(result);
+            this->revalidate(api_proxy, std::move(result.stale_urls));
             return true;
+        }
 
-        // calculating the amount of pages
-        size_t start = 1ULL, end = total / max_limit;
-        if (total > end * max_limit) // if there are some entries left, adding extra page on top
-            end += 1;
+        // the surplus pages of the shrunk collection are dropped, the missing pages of
+        // the grown one are requested
+        const auto pages_count = get_pages_count(total, pages_to_request);
+        if (pages_count < result.pages.size())
+        {
+            result.resize(pages_count);
+        }
+        else if (pages_count > result.pages.size())
+        {
+            const auto first = result.pages.size();
+            result.resize(pages_count);
+            if (!fetch_pages(api_proxy, first, result, total, notifier, only_cached, silent))
+                return false;
+        }
 
         if (pages_to_request > 0)
-        {
-            end = std::min(pages_to_request, end);
             total = std::min(total, pages_to_request * max_limit);
+
+        // preallocating data container for holding the final result
+        auto &items = this->get_items();
+        if (items.capacity() != total)
+            items.reserve(total);
+
+        // the pages are moved into the collection, the items are not copied once more
+        for (auto &chunk: result.pages)
+            items.insert(items.end(), std::make_move_iterator(chunk.begin()), std::make_move_iterator(chunk.end()));
+
+        add_sources(result);
+        this->revalidate(api_proxy, std::move(result.stale_urls));
+
+        return true;
+    }
+private:
+    /// @brief The collection's pages received so far, by their indices
+    struct pages_t
+    {
+        std::vector<std::vector<T>> pages;
+        std::vector<string> stale_urls; // the urls of the pages served stale, the fresh ones stay empty
+        std::vector<collections_registry::source_t> sources; // the pages' responses
+        size_t first_total = 0; // the total reported by the first page, if it is requested with the rest
+
+        void resize(size_t count)
+        {
+            pages.resize(count);
+            stale_urls.resize(count);
+            sources.resize(count);
         }
+    };
 
-        std::vector<std::vector<T>> result(end);
-        result[0] = requester->get();
+    /// @brief Adds the responses of the `result` pages to the collection's ones, in the pages order
+    void add_sources(const pages_t &result)
+    {
+        for (const auto &source: result.sources)
+            this->add_source(source.url, source.version);
+    }
+
+    /// @brief Returns the amount of the pages to request for the collection of `total` items
+    static size_t get_pages_count(size_t total, size_t pages_to_request)
+    {
+        const auto count = (total + max_limit - 1) / max_limit;
+        return pages_to_request > 0 ? std::min(count, pages_to_request) : count;
+    }
 
+    /// @brief Requests the pages starting from the `first` one till the end of the `result`
+    /// in parallel, putting them into the `result` by their indices
+    /// @param total the expected amount of the items, for the progress notifications
+    bool fetch_pages(api_weak_ptr_t api_proxy, size_t first, pages_t &result, size_t total,
+        requester_progress_notifier &notifier, bool only_cached, bool silent)
+    {
         /// @note for some reason passing weakref does not work here, it gets `empty`.
         /// So, I am passing real api pointer which works well
         auto api = api_proxy.lock();
-        auto sequence_future = api->get_pool().submit_sequence(start, end,
-            [this, &result, api = api.get(), &notifier, total, only_cached, silent]
+        if (!api) return false;
+
+        // the pages are requested with the same priority as the collection itself, so
+        // the pages of the user's view are queued ahead of the background syncs ones
+        auto priority = request_priority_scope::get_current();
+
+        // once the first page tells the actual total, the pages beyond it, which have not
+        // been started yet, are not requested; the running ones are dropped afterwards
+        std::atomic<size_t> pages_needed = result.pages.size();
+
+        auto sequence_future = api->get_pool().submit_sequence(first, result.pages.size(),
+            [this, &result, api = api.get(), &notifier, total, only_cached, silent, priority, &pages_needed]
             (const size_t idx)
             {
+                if (idx >= pages_needed)
+                    return;
+
+                request_priority_scope scope(priority);
+
                 auto requester = make_requester(idx * max_limit);
 
                 // all the exceptions are being accumulated and rethrown by thread-pool
@@ -699,15 +1302,26 @@ protected:
                 
                 if (requester->get_response()->status != httplib::NotModified_304)
                     modified = true;
+
+                if (requester->is_stale())
+                    result.stale_urls[idx] = requester->get_url();
+
+                if (idx == 0)
+                {
+                    result.first_total = requester->get_total();
+                    pages_needed = std::min(pages_needed.load(),
+                        std::max((size_t)1, (result.first_total + max_limit - 1) / max_limit));
+                }
                 
-                result[idx] = requester->get();
+                result.pages[idx] = requester->extract();
+                result.sources[idx] = { requester->get_url(), requester->get_version() };
 
                 size_t items_received = 0;
-                for (const auto &chunk: result)
+                for (const auto &chunk: result.pages)
                     items_received += chunk.size();
                 
                 notifier.send_progress(items_received, total);
-            });
+            }, get_pool_priority(priority));
 
         try
         {
@@ -719,16 +1333,512 @@ protected:
             dispatch_event(&api_requests_observer::on_collection_fetching_failed, std::string(ex.what()));
             return false;
         }
+        return true;
+    }
 
-        // preallocating data container for holding the final result
-        if (this->capacity() != total)
-            this->reserve(total);
+    /// @brief The state of the streamed collection, shared by its pages' tasks; the tasks
+    /// do not refer to the collection itself, it can be gone while they are running
+    struct stream_state_t
+    {
+        std::weak_ptr<async_collection> owner;
+        stream_handler_t handler;
+        std::shared_ptr<container_t> items; // the collection's items being streamed
+        string url, fieldname;
+        httplib::Params params;
+        requester_progress_notifier notifier;
+        bool is_retrying;
+
+        std::mutex guard;
+        std::vector<std::optional<std::vector<T>>> pages; // the received pages, not appended yet
+        std::vector<string> stale_urls;
+        std::vector<collections_registry::source_t> sources; // the pages' responses, by their indices
+        size_t total = 0, appended = 0, received_items = 0; // `appended` is counted in pages
+        bool is_modified = false, is_finished = false;
+
+        stream_state_t(std::weak_ptr<async_collection> owner, stream_handler_t handler,
+            std::shared_ptr<container_t> items, const string &url, const httplib::Params &params,
+            const string &fieldname, bool is_active):
+            owner(owner), handler(std::move(handler)), items(std::move(items)), url(url), params(params),
+            fieldname(fieldname), notifier(url, is_active), is_retrying(is_active)
+            {}
+
+        requester_ptr make_requester(size_t offset) const
+        {
+            return async_collection::make_requester(url, params, fieldname, offset);
+        }
+    };
+
+    using stream_state_ptr = std::shared_ptr<stream_state_t>;
+
+    /// @brief Appends the longest run of the received pages, following the appended ones,
+    /// to the collection. The appending tasks are pushed under the state's lock, so they
+    /// are executed in the pages order
+    static void on_page_received(const stream_state_ptr &state, size_t idx, requester_t &requester)
+    {
+        std::lock_guard lock(state->guard);
+        if (state->is_finished)
+            return;
+
+        if (requester.is_modified())
+            state->is_modified = true;
+
+        if (requester.is_stale())
+            state->stale_urls.push_back(requester.get_url());
+
+        state->received_items += requester.get().size();
+        state->pages[idx] = requester.extract();
+        state->sources[idx] = { requester.get_url(), requester.get_version() };
+        state->notifier.send_progress(state->received_items, state->total);
+
+        std::vector<T> items;
+        for (; state->appended < state->pages.size() && state->pages[state->appended]; ++state->appended)
+        {
+            auto &page = *state->pages[state->appended];
+            items.insert(items.end(), std::make_move_iterator(page.begin()), std::make_move_iterator(page.end()));
+            state->pages[state->appended].reset();
+        }
+
+        // the empty collection is finished with no items
+        state->is_finished = state->appended == state->pages.size();
+        if (items.empty() && !state->is_finished)
+            return;
+
+        // the sources are handed over with the last items, the state is not read after that
+        std::vector<collections_registry::source_t> sources;
+        if (state->is_finished)
+            sources = std::move(state->sources);
+
+        utils::far3::synchro_tasks::push(
+            [owner = state->owner, handler = state->handler, target = state->items, items = std::move(items),
+                sources = std::move(sources), capacity = state->pages.size() * max_limit,
+                is_finished = state->is_finished, is_modified = state->is_modified]() mutable
+            {
+                // the collection is gone or it has been fetched anew meanwhile
+                auto collection = owner.lock();
+                if (!collection || collection->building != target)
+                    return;
+
+                // the pages are not longer than the limit, while the `total` of the first one
+                // can be outgrown by the collection, changed during the streaming
+                if (target->capacity() < capacity)
+                    target->reserve(capacity);
+                target->insert(target->end(), std::make_move_iterator(items.begin()),
+                    std::make_move_iterator(items.end()));
+
+                if (is_finished)
+                {
+                    for (const auto &source: sources)
+                        collection->add_source(source.url, source.version);
+
+                    collection->modified = is_modified;
+                    collection->publish(0);
+                }
+
+                if (handler)
+                    handler(is_finished);
+            }, "collection streamed items task");
+
+        if (state->is_finished)
+            if (auto collection = state->owner.lock())
+                collection->revalidate(collection->api_proxy, std::move(state->stale_urls));
+    }
+
+    /// @brief Stops the streaming, the items appended so far are kept
+    static void on_stream_failed(const stream_state_ptr &state, const string &error)
+    {
+        std::lock_guard lock(state->guard);
+        if (state->is_finished)
+            return;
+
+        state->is_finished = true;
+        dispatch_event(&api_requests_observer::on_collection_fetching_failed, error);
+
+        utils::far3::synchro_tasks::push([owner = state->owner, handler = state->handler]
+            {
+                if (owner.lock() && handler)
+                    handler(true);
+            }, "collection streaming failed task");
+    }
+
+    bool modified = false;
+};
+
+
+/// @brief The collection of the user's saved items, ordered by their `added_at` time
+/// descending, like `/v1/me/tracks` or `/v1/me/albums`. Instead of re-reading all the
+/// pages every time, the collection is fetched in a delta mode: the merged items are kept
+/// in the http cache as a snapshot, and only the head of the collection is requested
+/// until the newest known item is met; the new items are put in front of the snapshot.
+/// The snapshot is a small manifest plus the chunks of items it lists, so putting the new
+/// items in front of it writes only the head's chunk, not the whole collection again.
+/// The collection is reconciled page by page, as `async_collection` does it, when there
+/// is no snapshot, when it is older than `reconcile_interval`, when the known item is not
+/// met within `max_head_pages` or when the server's `total` or its last page disagree with
+/// the merged items, which is the case of the removed items. The library drops the snapshot
+/// on its own removals, see `invalidate_snapshot`. Only the requested pages are the merged
+/// collection's sources: the snapshot is a local entry, which the api cannot revalidate
+/// @tparam T a final result's type, the item has `id` and `added_at` fields
+/// @tparam N a number of days/hours/mins etc. the pages are cached for
+/// @tparam C a caching class type: std::chrono::seconds, *::milliseconds, *::weeks etc.
+template<class T, int N, class C>
+class delta_collection: public async_collection<T, N, C, cache_policy::stale_while_revalidate>
+{
+public:
+    using base_t = async_collection<T, N, C, cache_policy::stale_while_revalidate>;
+    using typename base_t::container_t;
+    using base_t::async_collection;
+
+    /// @brief The head pages are not served stale, they are what tells the changes
+    using head_requester_t = collection_requester<container_t, N, C, cache_policy::revalidate>;
+
+    static constexpr size_t max_head_pages = 4;
+    static constexpr size_t chunk_size = 1000;
+    static constexpr size_t small_chunk_size = 100;
+    static constexpr auto reconcile_interval = std::chrono::weeks{ 1 };
+
+    /// @brief The snapshot's layout: the chunks' sequence numbers and sizes, from the
+    /// newest items' chunk to the oldest one
+    struct manifest_t
+    {
+        std::vector<std::pair<size_t, size_t>> chunks{};
+        size_t total = 0;
+        size_t next_seq = 0;
+    };
+
+    bool is_modified() const override
+    {
+        return modified || base_t::is_modified();
+    }
+
+    /// @brief Returns the http cache key of the collection's snapshot; it is out of the
+    /// collection's url range, so saving or removing items does not expire it
+    static auto get_snapshot_url(const string &url) -> string
+    {
+        return "/snapshots" + url;
+    }
+
+    /// @brief Expires the snapshot, so the next fetch reconciles the collection. The manifest
+    /// is stored anew, not just rescheduled, so its version changes as well; its chunks are
+    /// kept to be dropped by the reconcile
+    static void invalidate_snapshot(api_weak_ptr_t api_proxy, const string &url)
+    {
+        auto api = api_proxy.lock();
+        if (!api) return;
+
+        auto cache = api->get_http_cache();
+        const auto &snapshot_url = get_snapshot_url(url);
+        if (auto entry = cache->get(snapshot_url))
+        {
+            auto expired = *entry;
+            expired.cached_until = {};
+            cache->store(snapshot_url, expired);
+        }
+    }
+protected:
+    bool fetch_items(api_weak_ptr_t api_proxy, bool only_cached, bool silent = false, size_t pages_to_request = 0) override
+    {
+        // the partial and the cached-only fetches do not need the whole collection
+        if (only_cached || pages_to_request > 0)
+            return base_t::fetch_items(api_proxy, only_cached, silent, pages_to_request);
+
+        auto api = api_proxy.lock();
+        if (!api) return false;
+
+        manifest_t manifest;
+        container_t known;
+        if (!read_snapshot(api->get_http_cache(), manifest, known))
+            return reconcile(api_proxy, silent);
+
+        requester_progress_notifier notifier(this->url, !silent);
+
+        container_t head, last_page;
+        size_t total = 0, last_offset = 0;
+        bool is_met = false;
+
+        for (size_t page = 0; page < max_head_pages && !is_met; ++page)
+        {
+            auto requester = request_page(api_proxy, page * max_limit, silent);
+            if (requester == nullptr)
+                return false;
+
+            last_page = requester->extract();
+            last_offset = page * max_limit;
+            total = requester->get_total();
+
+            // the item, saved again, comes back with the new `added_at` time
+            auto it = std::find_if(last_page.begin(), last_page.end(), [&newest = known.front()](const auto &item)
+                { return item.id == newest.id && item.added_at == newest.added_at; });
+
+            is_met = it != last_page.end();
+            head.insert(head.end(), last_page.begin(), it);
+
+            // the collection is shorter than the head, the known item is not there
+            if (requester->get_next_url().empty())
+                break;
+        }
 
-        for (const auto &chunk: result)
-            this->insert(this->end(), chunk.begin(), chunk.end());
+        bool is_matched = is_met && total == head.size() + known.size();
+        if (is_matched)
+        {
+            // the removed and the re-saved items can keep the count the same, so the tail
+            // of the merged items is checked against the collection's last page as well
+            auto tail_offset = (total - 1) / max_limit * max_limit;
+            if (tail_offset != last_offset)
+            {
+                auto requester = request_page(api_proxy, tail_offset, silent);
+                if (requester == nullptr)
+                    return false;
+
+                last_page = requester->extract();
+                is_matched = requester->get_total() == total;
+            }
+            is_matched = is_matched && is_tail_matched(last_page, tail_offset, total, head, known);
+        }
+
+        if (!is_matched)
+        {
+            log::api->info("The collection's head or tail does not match the snapshot, it is reconciled: "
+                "{}, total {}, known {}, new {}", this->url, total, known.size(), head.size());
+            return reconcile(api_proxy, silent);
+        }
+
+        auto &items = this->get_items();
+        items.reserve(total);
+        items.insert(items.end(), std::make_move_iterator(head.begin()), std::make_move_iterator(head.end()));
+        items.insert(items.end(), std::make_move_iterator(known.begin()), std::make_move_iterator(known.end()));
+
+        notifier.send_progress(this->size(), total);
+
+        if (!head.empty())
+        {
+            modified = true;
+            write_head(api->get_http_cache(), manifest, head.size());
+        }
 
         return true;
     }
+
+    /// @brief Requests the collection's page at the given offset, the page is added
+    /// to the collection's sources
+    /// @returns nullptr, if the request failed, the failure is reported already
+    auto request_page(api_weak_ptr_t api_proxy, size_t offset, bool silent) -> std::shared_ptr<head_requester_t>
+    {
+        auto params = this->params;
+        params.insert(std::pair{ "offset", std::to_string(offset) });
+
+        auto requester = std::make_shared<head_requester_t>(this->url, params, this->fieldname);
+        if (!requester->execute(api_proxy, false, !silent))
+        {
+            dispatch_event(&api_requests_observer::on_collection_fetching_failed,
+                get_fetching_error(requester));
+            return nullptr;
+        }
+
+        this->add_source(requester->get_url(), requester->get_version());
+        return requester;
+    }
+
+    /// @brief Checks, whether the collection's last page consists of the same items
+    /// the merged head and snapshot have at its positions
+    static bool is_tail_matched(const container_t &page, size_t offset, size_t total,
+        const container_t &head, const container_t &known)
+    {
+        if (page.empty() || offset + page.size() != total)
+            return false;
+
+        for (size_t i = 0; i < page.size(); ++i)
+        {
+            auto pos = offset + i;
+            const auto &item = pos < head.size() ? head[pos] : known[pos - head.size()];
+            if (item.id != page[i].id || item.added_at != page[i].added_at)
+                return false;
+        }
+        return true;
+    }
+
+    /// @brief Fetches the whole collection page by page and keeps it as a new snapshot
+    bool reconcile(api_weak_ptr_t api_proxy, bool silent)
+    {
+        if (!base_t::fetch_items(api_proxy, false, silent))
+            return false;
+
+        if (auto api = api_proxy.lock())
+            write_snapshot(api->get_http_cache());
+        return true;
+    }
+
+    /// @brief Returns the http cache key of the snapshot's chunk
+    static auto get_chunk_url(const string &url, size_t seq) -> string
+    {
+        return utils::format("{}#{}", get_snapshot_url(url), seq);
+    }
+
+    /// @brief Reads the snapshot's manifest and all its chunks' items, if the snapshot
+    /// is there and still in schedule
+    bool read_snapshot(http_cache *cache, manifest_t &manifest, container_t &items) const
+    {
+        try
+        {
+            auto entry = cache->get(get_snapshot_url(this->url));
+            if (entry == nullptr || !entry->is_valid())
+                return false;
+
+            manifest = read_manifest(entry->get_body());
+            items.reserve(manifest.total);
+
+            for (const auto &[seq, size]: manifest.chunks)
+            {
+                // the evicted chunk or the one, rewritten partially, breaks the whole snapshot
+                auto chunk = cache->get(get_chunk_url(this->url, seq));
+                if (chunk == nullptr)
+                    return false;
+
+                container_t chunk_items;
+                size_t total = 0;
+                string next;
+                json::read_page(chunk->get_body(), "", chunk_items, total, next);
+
+                if (chunk_items.size() != size)
+                    return false;
+
+                items.insert(items.end(), std::make_move_iterator(chunk_items.begin()),
+                    std::make_move_iterator(chunk_items.end()));
+            }
+
+            return !items.empty() && items.size() == manifest.total;
+        }
+        catch (const std::exception &ex)
+        {
+            log::api->warn("The collection's snapshot could not be read, {}, url {}", ex.what(), this->url);
+            return false;
+        }
+    }
+
+    /// @brief Stores the collection's new head items, put in front of the snapshot's ones.
+    /// Only the head is written: as a new chunk, or merged with the newest chunk, while that
+    /// one is smaller than `small_chunk_size`. The snapshot keeps its current schedule
+    /// @param manifest the manifest the snapshot was read with
+    void write_head(http_cache *cache, manifest_t &manifest, size_t head_size)
+    {
+        auto entry = cache->peek(get_snapshot_url(this->url));
+        if (entry == nullptr || !entry->is_valid())
+            return;
+
+        auto cache_for = entry->cached_until - utils::clock_t::now();
+
+        if (!manifest.chunks.empty() && manifest.chunks.front().second < small_chunk_size)
+            manifest.chunks.front().second += head_size;
+        else
+            manifest.chunks.insert(manifest.chunks.begin(), std::pair{ manifest.next_seq++, head_size });
+
+        const auto &[seq, size] = manifest.chunks.front();
+        write_chunk(cache, seq, 0, size, cache_for);
+
+        manifest.total = this->size();
+        write_manifest(cache, manifest, cache_for);
+    }
+
+    /// @brief Stores the whole collection as a new snapshot, split into the chunks of
+    /// `chunk_size` items, and starts a new schedule for it; the previous snapshot's
+    /// chunks are dropped
+    void write_snapshot(http_cache *cache)
+    {
+        auto cache_for = std::chrono::duration_cast<utils::clock_t::duration>(reconcile_interval);
+
+        manifest_t previous;
+        try
+        {
+            if (auto entry = cache->get(get_snapshot_url(this->url)))
+                previous = read_manifest(entry->get_body());
+        }
+        catch (const std::exception &) {} // the broken manifest has no chunks to drop
+
+        // the new chunks do not overwrite the previous ones, which are still referenced
+        // until the new manifest is stored
+        manifest_t manifest;
+        manifest.next_seq = previous.next_seq;
+        manifest.total = this->size();
+
+        for (size_t offset = 0; offset < manifest.total; offset += chunk_size)
+        {
+            auto size = std::min(chunk_size, manifest.total - offset);
+            write_chunk(cache, manifest.next_seq, offset, size, cache_for);
+            manifest.chunks.push_back(std::pair{ manifest.next_seq++, size });
+        }
+
+        write_manifest(cache, manifest, cache_for);
+
+        for (const auto &[seq, size]: previous.chunks)
+            cache->store(get_chunk_url(this->url, seq), http_cache::cache_entry{});
+    }
+
+    /// @brief Stores the collection's items [offset, offset + size) as the snapshot's chunk,
+    /// in the same layout as the collection's pages
+    void write_chunk(http_cache *cache, size_t seq, size_t offset, size_t size, utils::clock_t::duration cache_for)
+    {
+        json::Document doc;
+        doc.SetObject();
+
+        json::Value items(json::kArrayType);
+        const auto &collection = this->get_items();
+        for (size_t i = offset; i < offset + size; ++i)
+        {
+            json::Value value;
+            to_json(value, collection[i], doc.GetAllocator());
+            items.PushBack(value, doc.GetAllocator());
+        }
+
+        doc.AddMember("items", items, doc.GetAllocator());
+        doc.AddMember("total", json::Value((uint64_t)size), doc.GetAllocator());
+
+        json::StringBuffer sb;
+        json::Writer<json::StringBuffer> writer(sb);
+        doc.Accept(writer);
+
+        cache->store(get_chunk_url(this->url, seq), sb.GetString(), "", cache_for);
+    }
+
+    /// @brief Parses the snapshot's manifest, throws std::runtime_error if it is malformed
+    static auto read_manifest(const string &body) -> manifest_t
+    {
+        json::Document doc;
+        if (doc.Parse(body).HasParseError())
+            throw std::runtime_error(GetParseError_En(doc.GetParseError()));
+
+        manifest_t manifest;
+        manifest.total = doc["total"].GetUint64();
+        manifest.next_seq = doc["next_seq"].GetUint64();
+
+        for (const auto &chunk: doc["chunks"].GetArray())
+            manifest.chunks.push_back({ chunk["seq"].GetUint64(), chunk["size"].GetUint64() });
+
+        return manifest;
+    }
+
+    void write_manifest(http_cache *cache, const manifest_t &manifest, utils::clock_t::duration cache_for)
+    {
+        json::Document doc;
+        doc.SetObject();
+
+        json::Value chunks(json::kArrayType);
+        for (const auto &[seq, size]: manifest.chunks)
+        {
+            json::Value chunk(json::kObjectType);
+            chunk.AddMember("seq", json::Value((uint64_t)seq), doc.GetAllocator());
+            chunk.AddMember("size", json::Value((uint64_t)size), doc.GetAllocator());
+            chunks.PushBack(chunk, doc.GetAllocator());
+        }
+
+        doc.AddMember("chunks", chunks, doc.GetAllocator());
+        doc.AddMember("total", json::Value((uint64_t)manifest.total), doc.GetAllocator());
+        doc.AddMember("next_seq", json::Value((uint64_t)manifest.next_seq), doc.GetAllocator());
+
+        json::StringBuffer sb;
+        json::Writer<json::StringBuffer> writer(sb);
+        doc.Accept(writer);
+
+        cache->store(get_snapshot_url(this->url), sb.GetString(), "", cache_for);
+    }
 private:
     bool modified = false;
 };
@@ -0,0 +1,345 @@
+#include "transport.hpp"
+
+namespace spotifar { namespace spotify {
+
+using clock_t = utils::clock_t;
+
+static thread_local request_priority current_priority = request_priority::interactive;
+
+BS::priority_t get_pool_priority(request_priority priority)
+{
+    switch (priority)
+    {
+        case request_priority::background: return BS::pr::low;
+        case request_priority::playback: return BS::pr::highest;
+        default: return BS::pr::high;
+    }
+}
+
+request_priority_scope::request_priority_scope(request_priority priority):
+    prev_priority(current_priority)
+{
+    current_priority = priority;
+}
+
+request_priority_scope::~request_priority_scope()
+{
+    current_priority = prev_priority;
+}
+
+request_priority request_priority_scope::get_current()
+{
+    return current_priority;
+}
+
+clients_pool::clients_pool(size_t max_per_host, clock_t::duration idle_timeout, initializer_t initializer):
+    max_per_host(std::max<size_t>(max_per_host, 1)),
+    idle_timeout(idle_timeout),
+    initializer(initializer)
+{
+}
+
+clients_pool::~clients_pool()
+{
+    shutdown();
+}
+
+clients_pool::client_ptr clients_pool::acquire(const string &host)
+{
+    std::unique_ptr<httplib::Client> client;
+    {
+        std::unique_lock lock(guard);
+
+        auto &h = hosts[host];
+
+        // the pool is at its limit for the host, waiting for some client to be returned
+        cv.wait(lock, [this, &h] { return is_shutdown || !h.idle.empty() || h.leased < max_per_host; });
+
+        if (!h.idle.empty())
+        {
+            client = std::move(h.idle.back().client);
+            h.idle.pop_back();
+            stats.reused++;
+        }
+        h.leased++;
+    }
+
+    if (client == nullptr)
+    {
+        client = std::make_unique<httplib::Client>(host);
+        client->set_keep_alive(true);
+
+        if (initializer)
+            initializer(*client);
+
+        std::lock_guard lock(guard);
+        stats.created++;
+    }
+
+    return client_ptr(client.release(),
+        [this, host](httplib::Client *c) { release(host, c); });
+}
+
+void clients_pool::release(const string &host, httplib::Client *client)
+{
+    std::unique_ptr<httplib::Client> c(client);
+    {
+        std::lock_guard lock(guard);
+
+        auto &h = hosts[host];
+        if (h.leased > 0)
+            h.leased--;
+
+        // after the shutdown the clients are not kept, the connection is closed
+        // right away by the unique_ptr
+        if (!is_shutdown)
+            h.idle.push_back({ std::move(c), clock_t::now() });
+    }
+    cv.notify_one();
+}
+
+void clients_pool::cleanup()
+{
+    // the idle clients are moved out of the lock scope to be closed, as closing
+    // a TLS connection could take a while
+    std::vector<idle_client_t> expired;
+    {
+        std::lock_guard lock(guard);
+
+        auto now = clock_t::now();
+        for (auto &[host, h]: hosts)
+        {
+            // the list is ordered by the idle time, the oldest ones are at the front
+            auto it = std::find_if(h.idle.begin(), h.idle.end(),
+                [&](const auto &c) { return c.idle_since + idle_timeout > now; });
+
+            std::move(h.idle.begin(), it, std::back_inserter(expired));
+            h.idle.erase(h.idle.begin(), it);
+        }
+        stats.expired += expired.size();
+    }
+
+    for (auto &c: expired)
+        c.client->stop();
+}
+
+void clients_pool::shutdown()
+{
+    std::unordered_map<string, host_t> dropped;
+    {
+        std::lock_guard lock(guard);
+        is_shutdown = true;
+
+        for (auto &[host, h]: hosts)
+            dropped[host].idle = std::move(h.idle);
+    }
+    cv.notify_all();
+}
+
+clients_pool::stats_t clients_pool::get_stats() const
+{
+    std::lock_guard lock(guard);
+    return stats;
+}
+
+httplib::Result requests_coalescer::execute(const string &key, request_t request)
+{
+    std::shared_ptr<flight_t> flight;
+    bool is_leader = false;
+    {
+        std::lock_guard lock(guard);
+        stats.requests++;
+
+        auto [it, is_inserted] = flights.try_emplace(key);
+        if (is_inserted)
+        {
+            it->second = std::make_shared<flight_t>();
+            is_leader = true;
+        }
+        else
+        {
+            it->second->followers++;
+            stats.collapsed++;
+        }
+        flight = it->second;
+    }
+
+    // a follower just waits for the leader's result and makes a copy of it,
+    // as each caller owns and may modify its response
+    if (!is_leader)
+    {
+        auto [response, error] = flight->result.get();
+        if (response == nullptr)
+            return httplib::Result(nullptr, error);
+        return httplib::Result(std::make_unique<httplib::Response>(*response), error);
+    }
+
+    // the flight is removed before sharing the result, so nobody can join it afterwards
+    // and the number of followers is final
+    auto finish_flight = [this, &key]
+    {
+        std::lock_guard lock(guard);
+        flights.erase(key);
+    };
+
+    httplib::Result res;
+    try
+    {
+        res = request();
+    }
+    catch (...)
+    {
+        finish_flight();
+        flight->promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    finish_flight();
+
+    // the response is copied only in case somebody is waiting for it
+    std::shared_ptr<const httplib::Response> shared;
+    if (flight->followers > 0 && res)
+        shared = std::make_shared<httplib::Response>(*res);
+
+    flight->promise.set_value({ shared, res.error() });
+
+    return res;
+}
+
+requests_coalescer::stats_t requests_coalescer::get_stats() const
+{
+    std::lock_guard lock(guard);
+    return stats;
+}
+
+token_bucket::token_bucket(const settings_t &settings):
+    settings(settings),
+    tokens(settings.capacity),
+    rate(settings.rate),
+    last_refill(clock_t::now())
+{
+}
+
+void token_bucket::refill(const clock_t::time_point &now)
+{
+    if (now > last_refill)
+    {
+        std::chrono::duration<double> elapsed = now - last_refill;
+        tokens = std::min(settings.capacity, tokens + elapsed.count() * rate);
+    }
+    last_refill = now;
+}
+
+bool token_bucket::has_waiting_above(request_priority priority) const
+{
+    for (size_t p = (size_t)priority + 1; p < waiting.size(); ++p)
+        if (waiting[p] > 0)
+            return true;
+    return false;
+}
+
+bool token_bucket::try_acquire(clock_t::duration &wait_for, request_priority priority)
+{
+    std::lock_guard lock(guard);
+
+    auto now = clock_t::now();
+    if (blocked_until > now)
+    {
+        wait_for = blocked_until - now;
+        return false;
+    }
+
+    refill(now);
+
+    // the background requests leave the reserved tokens untouched
+    double needed = 1.0;
+    if (priority == request_priority::background)
+        needed += std::min(settings.reserve, settings.capacity - 1.0);
+
+    // the token is not given away, while somebody more important is waiting for it,
+    // the waiting higher priority requester wakes everybody up, once it is served
+    if (tokens >= needed && !has_waiting_above(priority))
+    {
+        tokens -= 1.0;
+        return true;
+    }
+
+    wait_for = std::chrono::duration_cast<clock_t::duration>(
+        std::chrono::duration<double>(std::max(needed - tokens, 1.0) / rate));
+    return false;
+}
+
+bool token_bucket::acquire(std::function<bool()> is_cancelled, request_priority priority)
+{
+    clock_t::duration wait_for{};
+    if (try_acquire(wait_for, priority))
+        return true;
+
+    auto &waiting_count = waiting[(size_t)priority];
+    {
+        std::lock_guard lock(guard);
+        waiting_count++;
+    }
+
+    bool is_acquired = false;
+    while (!(is_acquired = try_acquire(wait_for, priority)))
+    {
+        if (is_cancelled && is_cancelled())
+            break;
+
+        // waking up periodically anyway, as the rate could be changed in the meantime
+        std::unique_lock lock(guard);
+        cv.wait_for(lock, std::min<clock_t::duration>(wait_for, 250ms));
+    }
+
+    {
+        std::lock_guard lock(guard);
+        waiting_count--;
+    }
+
+    // the lower priority requesters could have been held back by this one
+    cv.notify_all();
+
+    return is_acquired;
+}
+
+void token_bucket::on_throttled(clock_t::duration retry_after)
+{
+    std::lock_guard lock(guard);
+
+    rate = std::max(settings.min_rate, rate / 2);
+    tokens = 0;
+    blocked_until = std::max(blocked_until, clock_t::now() + retry_after);
+    last_refill = blocked_until;
+}
+
+void token_bucket::on_success()
+{
+    std::lock_guard lock(guard);
+    rate = std::min(settings.max_rate, rate + settings.increase_step);
+}
+
+bool token_bucket::is_exhausted() const
+{
+    auto state = get_state();
+    return state.blocked_until > clock_t::now() || state.tokens < 1.0;
+}
+
+token_bucket::state_t token_bucket::get_state() const
+{
+    std::lock_guard lock(guard);
+
+    // the tokens are not refilled here to keep the method const, so the
+    // amount is calculated on the fly
+    double current = tokens;
+    if (auto now = clock_t::now(); now > last_refill)
+    {
+        std::chrono::duration<double> elapsed = now - last_refill;
+        current = std::min(settings.capacity, tokens + elapsed.count() * rate);
+    }
+
+    return { current, rate, blocked_until };
+}
+
+} // namespace spotify
+} // namespace spotifar
@@ -0,0 +1,240 @@
+#ifndef TRANSPORT_HPP_7C0E2B5A_4D1F_4B8E_9E43_2A6F1D3C8B17
+#define TRANSPORT_HPP_7C0E2B5A_4D1F_4B8E_9E43_2A6F1D3C8B17
+#pragma once
+
+#include "stdafx.h"
+#include "utils.hpp"
+
+namespace spotifar { namespace spotify {
+
+/// @brief A priority class of the outgoing API traffic. The higher classes are served first
+/// from the requests queue and get the rate budget reserved for them
+enum class request_priority: uint8_t
+{
+    background = 0, // caches resyncs, releases crawling, library statuses checks
+    interactive, // the requests made on behalf of the user browsing the views
+    playback, // the playback control commands
+};
+
+/// @brief Maps the requests priority onto the thread-pool's tasks priority
+auto get_pool_priority(request_priority priority) -> BS::priority_t;
+
+/// @brief A scoped helper to set the priority of all the requests, performed by the current
+/// thread, until the object is destroyed; the previous priority is restored afterwards. The
+/// threads with no priority set perform their requests as `request_priority::interactive`
+class TEST_API request_priority_scope
+{
+public:
+    request_priority_scope(request_priority priority);
+    ~request_priority_scope();
+
+    request_priority_scope(const request_priority_scope&) = delete;
+    request_priority_scope& operator=(const request_priority_scope&) = delete;
+
+    /// @brief Returns the requests priority of the calling thread
+    static auto get_current() -> request_priority;
+private:
+    request_priority prev_priority;
+};
+
+/// @brief Queues the `task` into the `pool` with the given requests `priority`, all
+/// the requests performed by the task are made with the same priority
+template<class F>
+void detach_prioritized_task(BS::priority_thread_pool &pool, request_priority priority, F &&task)
+{
+    pool.detach_task(
+        [priority, task = std::forward<F>(task)]
+        {
+            request_priority_scope scope(priority);
+            task();
+        }, get_pool_priority(priority));
+}
+
+/// @brief A pool of keep-alive http clients, shared by all the API worker threads.
+/// Each client holds its own TCP+TLS connection, so re-using it saves a full handshake
+/// for every subsequent request to the same host.
+///
+/// A leased client is used exclusively by one thread (httplib::Client is not thread-safe)
+/// and is returned back to the pool automatically, once the last reference to it is dropped.
+/// The number of simultaneously leased clients per host is limited, the threads exceeding
+/// the limit are waiting for the other ones to return their clients. The clients, which
+/// stayed idle longer than the given timeout, are closed and dropped by `cleanup`.
+class TEST_API clients_pool
+{
+public:
+    using client_ptr = std::shared_ptr<httplib::Client>;
+    using initializer_t = std::function<void(httplib::Client&)>;
+
+    struct stats_t
+    {
+        size_t created = 0; // total amount of clients (connections) created
+        size_t reused = 0; // total amount of leases served by an idle client
+        size_t expired = 0; // total amount of clients dropped by idle timeout
+    };
+public:
+    /// @param max_per_host a maximum number of clients leased simultaneously for one host
+    /// @param idle_timeout an idle client is closed after this period of inactivity
+    /// @param initializer a handler to set up a newly created client: logger, headers etc.
+    clients_pool(size_t max_per_host, utils::clock_t::duration idle_timeout,
+        initializer_t initializer = nullptr);
+    ~clients_pool();
+
+    /// @brief Leases a client for the given `host` ("https://api.spotify.com"). Returns
+    /// an idle one if any, creates a new one if the per-host limit allows, otherwise
+    /// blocks the calling thread until some client is returned to the pool
+    auto acquire(const string &host) -> client_ptr;
+
+    /// @brief Closes and drops all the clients, which have been idle longer than the timeout
+    void cleanup();
+
+    /// @brief Drops all the idle clients and wakes up all the waiting threads; after that
+    /// the pool does not keep the clients anymore, each lease creates a new temporary one
+    void shutdown();
+
+    auto get_stats() const -> stats_t;
+private:
+    /// @brief Returns the given `client` back to the `host` idle list
+    void release(const string &host, httplib::Client *client);
+private:
+    struct idle_client_t
+    {
+        std::unique_ptr<httplib::Client> client;
+        utils::clock_t::time_point idle_since;
+    };
+
+    struct host_t
+    {
+        std::vector<idle_client_t> idle; // LIFO, the most recently used is at the back
+        size_t leased = 0;
+    };
+
+    const size_t max_per_host;
+    const utils::clock_t::duration idle_timeout;
+    initializer_t initializer;
+
+    mutable std::mutex guard;
+    std::condition_variable cv;
+    std::unordered_map<string, host_t> hosts;
+    stats_t stats;
+    bool is_shutdown = false;
+};
+
+
+/// @brief A single-flight helper to collapse identical concurrent requests. The first
+/// caller for the given key (a leader) performs the request, all the callers coming with
+/// the same key while the request is in flight are waiting for the leader's result and
+/// receive their own copy of it, instead of performing the same network round-trip
+class TEST_API requests_coalescer
+{
+public:
+    using request_t = std::function<httplib::Result()>;
+
+    struct stats_t
+    {
+        size_t requests = 0; // total amount of requests passed through
+        size_t collapsed = 0; // amount of requests, served by some other one in flight
+    };
+public:
+    /// @brief Executes the given `request`, or waits for the identical one in flight with the
+    /// same `key` to finish and returns a copy of its result. The exceptions thrown by
+    /// the leader's request are rethrown to all the waiting callers as well
+    auto execute(const string &key, request_t request) -> httplib::Result;
+
+    auto get_stats() const -> stats_t;
+private:
+    using shared_result_t = std::pair<std::shared_ptr<const httplib::Response>, httplib::Error>;
+
+    struct flight_t
+    {
+        std::promise<shared_result_t> promise;
+        std::shared_future<shared_result_t> result = promise.get_future().share();
+        size_t followers = 0;
+    };
+
+    mutable std::mutex guard;
+    std::unordered_map<string, std::shared_ptr<flight_t>> flights;
+    stats_t stats;
+};
+
+
+
+/// @brief A client-side token bucket to pace the outgoing requests before the server
+/// starts throttling them. The bucket is refilled with `rate` tokens per second up to its
+/// `capacity`, each request takes one token. The rate is adaptive: it is cut in half every
+/// time the server responds with 429 (and no tokens are given until `retry-after` is over)
+/// and grows back slowly with every successful response
+///
+/// The tokens are given out by priority: a requester is not served while there are some
+/// requesters of a higher priority waiting, and the background ones cannot take the last
+/// `reserve` tokens, so there is always some budget left for the user's actions
+class TEST_API token_bucket
+{
+public:
+    struct settings_t
+    {
+        double rate; // initial amount of tokens per second
+        double capacity; // a maximum burst size
+        double min_rate; // the rate is never cut lower than this
+        double max_rate; // the rate never grows higher than this
+        double increase_step = 0.1; // the rate grows by this value with each success
+        double reserve = 0.; // the amount of tokens, unavailable for the background requests
+    };
+
+    struct state_t
+    {
+        double tokens;
+        double rate;
+        utils::clock_t::time_point blocked_until;
+    };
+public:
+    token_bucket(const settings_t &settings);
+
+    /// @brief Takes a token if available for the given `priority`. Otherwise returns `false`
+    /// and the estimated time to wait in `wait_for`
+    bool try_acquire(utils::clock_t::duration &wait_for,
+        request_priority priority = request_priority::interactive);
+
+    /// @brief Takes a token, blocking the calling thread until it is available. Returns
+    /// `false` if the waiting was interrupted by `is_cancelled` predicate
+    bool acquire(std::function<bool()> is_cancelled,
+        request_priority priority = request_priority::interactive);
+
+    /// @brief Signals the bucket, that the server has throttled a request; decreases
+    /// the rate and blocks the bucket for `retry_after` time
+    void on_throttled(utils::clock_t::duration retry_after);
+
+    /// @brief Signals the bucket, that a request was served well; increases the rate
+    void on_success();
+
+    /// @brief Is the bucket blocked by the server's `retry-after` or has no tokens left
+    bool is_exhausted() const;
+
+    auto get_state() const -> state_t;
+
+    /// @brief Wakes up all the threads, waiting for the tokens, so they can
+    /// check their cancellation predicates
+    void notify_all() { cv.notify_all(); }
+private:
+    /// @brief Adds the tokens accumulated since the last refill
+    void refill(const utils::clock_t::time_point &now);
+
+    /// @brief Whether there are some requesters waiting with a higher than `priority` one
+    bool has_waiting_above(request_priority priority) const;
+private:
+    const settings_t settings;
+
+    mutable std::mutex guard;
+    std::condition_variable cv;
+    double tokens;
+    double rate;
+    utils::clock_t::time_point last_refill;
+    utils::clock_t::time_point blocked_until{};
+
+    /// @brief The amount of the requesters waiting for a token, per priority
+    std::array<size_t, 3> waiting{};
+};
+
+} // namespace spotify
+} // namespace spotifar
+
+#endif // TRANSPORT_HPP_7C0E2B5A_4D1F_4B8E_9E43_2A6F1D3C8B17
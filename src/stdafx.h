@@ -27,10 +27,17 @@
 
 #include <fstream> // IWYU pragma: keep
 #include <map> // IWYU pragma: keep
+#include <set> // IWYU pragma: keep
+#include <deque> // IWYU pragma: keep; std::deque
 #include <vector>
+#include <tuple> // IWYU pragma: keep; std::tuple, std::apply
+#include <optional> // IWYU pragma: keep; std::optional
+#include <compare> // IWYU pragma: keep; operator<=>
+#include <numeric> // IWYU pragma: keep; std::iota
 #include <chrono> // std::chrono::system_clock
 #include <typeindex> // IWYU pragma: keep; std::type_index
 #include <filesystem> // IWYU pragma: keep; std::filesystem::path
+#include <shared_mutex> // IWYU pragma: keep; std::shared_mutex
 #include <shellapi.h>  // for ShellExecute
 #include <shlobj.h> // for SHGetKnownFolderPath
 
@@ -103,6 +110,8 @@ namespace spotifar
 
         // classes
         class http_cache;
+        class objects_cache;
+        class collections_registry;
         class library;
         class playback_cache;
         class devices_cache;
@@ -165,6 +174,7 @@ namespace spotifar
             using rapidjson::kObjectType;
             using rapidjson::kArrayType;
             using rapidjson::ParseResult;
+            using rapidjson::StringRef;
             using Allocator = typename Document::AllocatorType;
         }
 
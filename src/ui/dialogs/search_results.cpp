@@ -239,10 +239,10 @@ void search_results_dialog::rebuild_items()
 
             wstring label = format(
                 tracks_tpl,
-                utils::to_wstring(track.album.get_release_year()),
+                utils::to_wstring(track.album->get_release_year()),
                 utils::trunc(track.name, 25),
                 utils::trunc(track.get_artist().name, 20),
-                utils::trunc(track.album.name, 20),
+                utils::trunc(track.album->name, 20),
                 is_saved ? L" + " : L"",
                 track.is_explicit ? L" * " : L"",
                 track_length.substr(0, 5)
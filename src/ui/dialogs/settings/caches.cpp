@@ -31,6 +31,11 @@ enum controls : int
     auth_clear_button,
     http_cache_label,
     http_clear_button,
+    http_limits_label,
+    http_disk_limit_edit,
+    http_memory_limit_edit,
+    http_evicted_label,
+    http_evicted_value,
     clear_all_button,
 
     releases_separator,
@@ -48,7 +53,7 @@ enum controls : int
 static const int
     logs_box_y = 2, // y position of a panel with logs settings
     caches_box_y = logs_box_y + 5,
-    releases_box_y = caches_box_y + 6,
+    releases_box_y = caches_box_y + 8,
     buttons_box_y = releases_box_y + 6, // y position of a buttons panel
     width = 52, height = buttons_box_y + 4, // overall dialog height is a summ of all the panels included
     center_x = width / 2,
@@ -70,7 +75,12 @@ static const std::vector<FarDialogItem> dlg_items_layout{
     ctrl(DI_BUTTON,      center_x, caches_box_y+1, box_x2, 1,              DIF_NONE),
     ctrl(DI_TEXT,        view_x1, caches_box_y+2, box_x2-center_x, 1,      DIF_RIGHTTEXT),
     ctrl(DI_BUTTON,      center_x, caches_box_y+2, box_x2, 1,              DIF_NONE),
-    ctrl(DI_BUTTON,      center_x, caches_box_y+4, box_x2, 1,              DIF_CENTERGROUP),
+    ctrl(DI_TEXT,        view_x1, caches_box_y+3, center_x-2, 1,           DIF_RIGHTTEXT),
+    ctrl(DI_EDIT,        center_x, caches_box_y+3, center_x+6, 1,          DIF_NONE),
+    ctrl(DI_EDIT,        center_x+8, caches_box_y+3, center_x+14, 1,       DIF_NONE),
+    ctrl(DI_TEXT,        view_x1, caches_box_y+4, center_x-2, 1,           DIF_RIGHTTEXT),
+    ctrl(DI_TEXT,        center_x, caches_box_y+4, box_x2-center_x, 1,     DIF_NONE),
+    ctrl(DI_BUTTON,      center_x, caches_box_y+6, box_x2, 1,              DIF_CENTERGROUP),
 
     ctrl(DI_TEXT,        -1, releases_box_y, box_x2, 1,                    DIF_SEPARATOR),
     ctrl(DI_TEXT,        view_x1, releases_box_y+1, center_x-2, 1,         DIF_RIGHTTEXT),
@@ -135,7 +145,7 @@ static void update_caches_block(HANDLE hdlg)
 {
     no_redraw_caches nr(hdlg);
 
-    static wstring http_btn_label;
+    static wstring http_btn_label, http_evicted_label;
 
     std::error_code ec;
     auto size = fs::file_size(spotify::get_cache_filename(), ec);
@@ -143,12 +153,24 @@ static void update_caches_block(HANDLE hdlg)
     // ignore errors, just show 0B size on the buttong
     http_btn_label = get_vtext(MCfgHttpCacheClearBtn,
         utils::to_wstring(format_size(ec ? 0 : size)));
+
+    // the eviction counters are available only while the plugin is running
+    spotify::http_cache::stats_t stats;
+    if (auto plugin = get_plugin())
+        if (auto api = plugin->get_api())
+            stats = api->get_http_cache()->get_stats();
+
+    http_evicted_label = get_vtext(MCfgHttpCacheEvictedValue, stats.evicted,
+        utils::to_wstring(format_size(stats.evicted_size)), stats.unloaded);
     
     dialogs::set_text(hdlg, caches_separator, get_text(MCfgCaches));
     dialogs::set_text(hdlg, auth_cache_label, get_text(MCfgCredentials));
     dialogs::set_text(hdlg, auth_clear_button, get_text(MCfgCredentialsClearBtn));
     dialogs::set_text(hdlg, http_cache_label, get_text(MCfgHttpCache));
     dialogs::set_text(hdlg, http_clear_button, http_btn_label.c_str());
+    dialogs::set_text(hdlg, http_limits_label, get_text(MCfgHttpCacheLimits));
+    dialogs::set_text(hdlg, http_evicted_label, get_text(MCfgHttpCacheEvicted));
+    dialogs::set_text(hdlg, http_evicted_value, http_evicted_label.c_str());
     dialogs::set_text(hdlg, clear_all_button, get_text(MCfgClearAllCaches));
 }
 
@@ -215,6 +237,14 @@ static void update_releases_scan_block(HANDLE hdlg, plugin_ptr_t plugin)
 
 static bool remove_http_cache()
 {
+    // the running cache holds the file open, so it is cleared in place
+    if (auto plugin = get_plugin())
+        if (auto api = plugin->get_api())
+        {
+            api->get_http_cache()->clear_all();
+            return true;
+        }
+
     const auto &filepath = spotify::get_cache_filename();
     
     std::error_code ec;
@@ -228,6 +258,20 @@ static bool remove_http_cache()
     return true;
 }
 
+/// @brief Reads the limit in megabytes from the `ctrl_id` edit field, the invalid
+/// value keeps the `def` one
+static int get_limit(HANDLE hdlg, int ctrl_id, int def)
+{
+    try
+    {
+        return std::max(std::stoi(dialogs::get_text(hdlg, ctrl_id)), 0);
+    }
+    catch (const std::exception&)
+    {
+        return def;
+    }
+}
+
 static void clear_credentials()
 {
     auto ctx = config::lock_settings();
@@ -258,6 +302,10 @@ void caches_dialog::init()
     update_caches_block(hdlg);
     update_releases_scan_block(hdlg, get_plugin());
 
+    // the limits are edited in megabytes
+    dialogs::set_text(hdlg, http_disk_limit_edit, std::to_string(config::get_http_cache_disk_limit() >> 20));
+    dialogs::set_text(hdlg, http_memory_limit_edit, std::to_string(config::get_http_cache_memory_limit() >> 20));
+
     dialogs::set_text(hdlg, ok_button, get_text(MOk));
     dialogs::set_text(hdlg, cancel_button, get_text(MCancel));
 }
@@ -322,6 +370,24 @@ bool caches_dialog::handle_btn_clicked(int ctrl_id, std::uintptr_t param)
     return false;
 }
 
+intptr_t caches_dialog::handle_result(intptr_t dialog_run_result)
+{
+    if (dialog_run_result == ok_button)
+    {
+        {
+            auto ctx = config::lock_settings();
+            auto &s = ctx->get_settings();
+
+            s.http_cache_disk_limit = get_limit(hdlg, http_disk_limit_edit, s.http_cache_disk_limit);
+            s.http_cache_memory_limit = get_limit(hdlg, http_memory_limit_edit, s.http_cache_memory_limit);
+
+            ctx->fire_events(); // notify all the listeners
+        }
+        config::write();
+    }
+    return FALSE;
+}
+
 void caches_dialog::on_sync_progress_changed(size_t items_left)
 {
     set_releases_sync_status(hdlg);
@@ -19,6 +19,7 @@ protected:
     // modal_dialog
     void init() override;
     bool handle_btn_clicked(int ctrl_id, std::uintptr_t param) override;
+    intptr_t handle_result(intptr_t dialog_run_result) override;
 
     // releases_observer handlers
     void on_sync_progress_changed(size_t items_left) override;
@@ -206,7 +206,7 @@ void notifications_handler::show_now_playing(const spotify::track_t &track, bool
     if (auto api = api_proxy.lock())
     {
         auto *library = api->get_library();
-        auto album_img_path = api->get_image(track.album.get_image(), track.album.id);
+        auto album_img_path = api->get_image(track.album->get_image(), track.album->id);
         auto is_saved = library->is_track_saved(track.id, true);
      
         WinToastTemplate toast(WinToastTemplate::ImageAndText02);
@@ -228,7 +228,7 @@ void notifications_handler::show_now_playing(const spotify::track_t &track, bool
         
         // text
         toast.setTextField(track.name, WinToastTemplate::FirstLine);
-        toast.setTextField(track.album.get_artist().name, WinToastTemplate::SecondLine);
+        toast.setTextField(track.album->get_artist().name, WinToastTemplate::SecondLine);
         toast.setAttributionText(get_text(MToastSpotifyAttibution));
         
         // buttons
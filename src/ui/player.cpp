@@ -496,7 +496,7 @@ bool player::on_artist_label_input_received(void *input_record)
     // and check whether the clicking position happened within range of symbols
     // of this particular name
     const auto &playback = api->get_playback_state();
-    wstring ws = playback.item.album.get_artists_full_name();
+    wstring ws = playback.item.album->get_artists_full_name();
     static std::wregex pattern(L"[^,]+");
 
     auto begin = std::wsregex_iterator{ ws.begin(), ws.end(), pattern };
@@ -516,15 +516,15 @@ bool player::on_artist_label_input_received(void *input_record)
     // if we won't find our artist by name, we pick the main one
     auto simplified_artist = playback.item.get_artist();
     for (const auto &a: playback.item.artists)
-        if (a.name == utils::trim(result))
-            simplified_artist = a;
+        if (a->name == utils::trim(result))
+            simplified_artist = *a;
 
     if (const auto &artist = api->get_artist(simplified_artist.id))
     {
         hide();
 
         ui::events::show_artist(api, artist);
-        ui::events::select_item(playback.item.album.id);
+        ui::events::select_item(playback.item.album->id);
     }
 
     return true;
@@ -798,7 +798,7 @@ void player::on_track_changed(const track_t &track, const track_t &prev_track)
     track_progress.set_higher_boundary(track.duration);
 
     set_control_text(controls::track_name, track.name);
-    set_control_text(controls::artist_name, track.album.get_artists_full_name());
+    set_control_text(controls::artist_name, track.album->get_artists_full_name());
     set_control_text(controls::track_total_time, track_total_time_str);
 
     if (auto api = api_proxy.lock())
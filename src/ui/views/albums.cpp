@@ -23,6 +23,7 @@ albums_base_view::~albums_base_view()
 {
     utils::events::stop_listening<collection_observer>(this);
     items.clear();
+    albums_lengths.clear();
 }
 
 const items_t& albums_base_view::get_items()
@@ -38,11 +39,7 @@ const items_t& albums_base_view::get_items()
 
         if (auto api = api_proxy.lock())
         {
-            auto tracks = api->get_album_tracks(album.id);
-            // collecting the data only from cache if exists
-            if (tracks->fetch(true, true))
-                for (const auto &t: *tracks)
-                    total_length_ms += t.duration_ms;
+            total_length_ms = get_album_length(api.get(), album.id);
 
             auto *library = api->get_library();
             is_saved = library->is_album_saved(album.id);
@@ -204,6 +201,27 @@ bool albums_base_view::request_extra_info(const data_item_t* data)
     return false;
 }
 
+size_t albums_base_view::get_album_length(api_interface *api, const item_id_t &album_id)
+{
+    // collecting the data only from cache if exists; the tracks, fetched before, are
+    // taken from the shared collections, the view does not hold them
+    auto tracks = api->get_album_tracks(album_id);
+    if (!tracks->fetch(true, true))
+        return 0;
+
+    // the tracks, which are not shared, have no version and are summed up every time
+    auto &length = albums_lengths[album_id];
+    if (length.version == 0 || length.version != tracks->get_version())
+    {
+        length.total_length_ms = 0;
+        for (const auto &t: *tracks)
+            length.total_length_ms += t.duration_ms;
+
+        length.version = tracks->get_version();
+    }
+    return length.total_length_ms;
+}
+
 intptr_t albums_base_view::process_key_input(int combined_key)
 {
     using namespace utils::keys;
@@ -659,7 +677,7 @@ void recent_albums_view::rebuild_items()
     // the reverse order is used
     auto play_history = api->get_play_history();
     for (auto it = play_history.rbegin(); it != play_history.rend(); ++it)
-        recent_albums[it->album.id] = *it;
+        recent_albums[it->album->id] = *it;
 
     if (recent_albums.size() > 0)
     {
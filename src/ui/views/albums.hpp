@@ -47,9 +47,20 @@ protected:
     // collection_observer
     void on_albums_statuses_changed(const item_ids_t &ids) override;
     void on_albums_statuses_received(const item_ids_t &ids) override;
+
+    /// @brief Returns the album's total length, if its tracks are cached, or zero
+    auto get_album_length(api_interface *api, const item_id_t &album_id) -> size_t;
 protected:
+    /// @brief The album's tracks length, summed up once per the tracks' version
+    struct album_length_t
+    {
+        uint64_t version = 0;
+        size_t total_length_ms = 0;
+    };
+
     api_weak_ptr_t api_proxy;
     items_t items;
+    std::unordered_map<item_id_t, album_length_t> albums_lengths;
 
     // this flag is set to true between the calls of 'rebuild_panels' and actual
     // items udpate 'get_albums'; during this time the items are being rebuild
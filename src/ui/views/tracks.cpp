@@ -75,7 +75,7 @@ const items_t& tracks_base_view::get_items()
         
         // column C2 - album's release year
         columns.push_back(utils::format(L"{: ^6}",
-            utils::to_wstring(track.album.get_release_year())));
+            utils::to_wstring(track.album->get_release_year())));
 
         // column C3 - main artist's name
         columns.push_back(track.get_artist().name);
@@ -84,10 +84,10 @@ const items_t& tracks_base_view::get_items()
         columns.push_back(utils::format(L"{:5}", track.popularity));
 
         // column C5 - album's name
-        columns.push_back(track.album.name);
+        columns.push_back(track.album->name);
 
         // column C6 - album's type
-        columns.push_back(utils::format(L"{: ^6}", track.album.get_type_abbrev()));
+        columns.push_back(utils::format(L"{: ^6}", track.album->get_type_abbrev()));
 
         // column C7 - is saved in collection status
         columns.push_back(is_saved ? L" + " : L"");
@@ -106,6 +106,17 @@ const items_t& tracks_base_view::get_items()
             is_selected
         });
     }
+
+    sort_columns.reset();
+    if (items.size() >= sort_columns_min_size)
+    {
+        std::vector<const track_t*> tracks;
+        tracks.reserve(items.size());
+        for (const auto &item: items)
+            tracks.push_back(static_cast<const track_t*>(item.user_data));
+
+        sort_columns = std::make_unique<tracks_columns_t<track_t>>(std::move(tracks));
+    }
     return items;
 }
 
@@ -167,11 +178,11 @@ wstring tracks_base_view::get_quick_item_info(const data_item_t *data)
             << space << get_text(MQWExplicit)       << " " << (track->is_explicit ? get_text(MQWYes) : get_text(MQWNo)) << endl
             << space << get_text(MQWSaved)          << " " << (library->is_track_saved(track->id) ? get_text(MQWYes) : get_text(MQWNo)) << endl
             << endl
-            << space << get_text(MQWAlbumName)      << " " << track->album.name << endl
-            << space << get_text(MQWReleaseType)    << " " << track->album.get_type_abbrev() << endl
-            << space << get_text(MQWReleaseYear)    << " " << utils::to_wstring(track->album.get_release_year()) << endl;
+            << space << get_text(MQWAlbumName)      << " " << track->album->name << endl
+            << space << get_text(MQWReleaseType)    << " " << track->album->get_type_abbrev() << endl
+            << space << get_text(MQWReleaseYear)    << " " << utils::to_wstring(track->album->get_release_year()) << endl;
 
-        if (const auto album = api->get_album(track->album.id))
+        if (const auto album = api->get_album(track->album->id))
         {
             std::vector<wstring> copyrights;
             std::transform(album.copyrights.cbegin(), album.copyrights.cend(), back_inserter(copyrights),
@@ -194,6 +205,28 @@ wstring tracks_base_view::get_quick_item_info(const data_item_t *data)
     return L"";
 }
 
+/// @brief Returns the column of the columnar store the given sort mode sorts the tracks by
+static auto get_sort_column(OPENPANELINFO_SORTMODES far_sort_mode)
+    -> std::optional<tracks_columns_t<track_t>::column_t>
+{
+    using column_t = tracks_columns_t<track_t>::column_t;
+
+    #if defined (__clang__)
+    #   pragma clang diagnostic ignored "-Wswitch"
+    #endif
+    // the names are unique mostly, ranking them costs as much as sorting by them, so the
+    // tracks are compared by their own names
+    switch (far_sort_mode)
+    {
+        case SM_SIZE: return column_t::duration;
+        case SM_COMPRESSEDSIZE: return column_t::popularity;
+        case SM_OWNER: return column_t::album;
+        case SM_CHTIME: return column_t::artist;
+        case SM_ATIME: return column_t::release_date;
+    }
+    return std::nullopt;
+}
+
 intptr_t tracks_base_view::compare_items(const sort_mode_t &sort_mode,
     const data_item_t *data1, const data_item_t *data2)
 {
@@ -201,6 +234,11 @@ intptr_t tracks_base_view::compare_items(const sort_mode_t &sort_mode,
         &item1 = static_cast<const track_t*>(data1),
         &item2 = static_cast<const track_t*>(data2);
 
+    if (sort_columns)
+        if (auto column = get_sort_column(sort_mode.far_sort_mode))
+            if (auto result = sort_columns->compare(*column, item1, item2); result != -2)
+                return result;
+
     #if defined (__clang__)
     #   pragma clang diagnostic ignored "-Wswitch"
     #endif
@@ -220,13 +258,13 @@ intptr_t tracks_base_view::compare_items(const sort_mode_t &sort_mode,
             return 0;
 
         case SM_OWNER: // by album name
-            return item1->album.name.compare(item2->album.name);
+            return item1->album->name.compare(item2->album->name);
 
         case SM_CHTIME: // by artist name
             return item1->get_artist().name.compare(item2->get_artist().name);
 
         case SM_ATIME: // by release date
-            return item1->album.release_date.compare(item2->album.release_date);
+            return item1->album->release_date.compare(item2->album->release_date);
     }
     return -2;
 }
@@ -314,7 +352,7 @@ intptr_t tracks_base_view::process_key_input(int combined_key)
                     if (auto api = api_proxy.lock())
                     {
                         const auto *track = static_cast<const track_t*>(user_data);
-                        if (const auto album = api->get_album(track->album.id); *track)
+                        if (const auto album = api->get_album(track->album->id); *track)
                             events::show_album_tracks(api_proxy, album);
                     }
                 }
@@ -574,7 +612,7 @@ std::vector<wstring> album_tracks_view::get_extra_columns(const track_t& track)
 
 void album_tracks_view::on_track_changed(const track_t &track, const track_t &prev_track)
 {
-    if (album.id == track.album.id) // the currently playing track is from this album
+    if (album.id == track.album->id) // the currently playing track is from this album
         events::refresh_panel(get_panel_handle());
 }
 
@@ -1079,8 +1117,10 @@ playlist_view::playlist_view(HANDLE panel, api_weak_ptr_t api_proxy, const playl
 {
     if (auto api = api_proxy.lock())
     {
+        // the long playlists are shown right after their first page is received, the rest
+        // of the tracks are added to the panel as they come
         collection = api->get_playlist_tracks(p.id);
-        collection->fetch();
+        collection->stream([panel](bool is_finished) { events::refresh_panel(panel); });
     }
     
     utils::events::start_listening<playback_observer>(this, true);
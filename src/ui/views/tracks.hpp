@@ -6,6 +6,7 @@
 #include "view.hpp"
 #include "spotify/interfaces.hpp"
 #include "spotify/observer_protocols.hpp"
+#include "spotify/columns.hpp"
 
 namespace spotifar { namespace ui {
 
@@ -42,6 +43,11 @@ protected:
 protected:
     api_weak_ptr_t api_proxy;
     items_t items;
+private:
+    /// @brief The lists this long are sorted by the columnar copy of their keys
+    static constexpr size_t sort_columns_min_size = 1000;
+
+    std::unique_ptr<tracks_columns_t<track_t>> sort_columns;
 };
 
 
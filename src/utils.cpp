@@ -2,6 +2,8 @@
 #include "config.hpp"
 #include "lng.hpp"
 
+#include <zlib.h>
+#include <bit>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/daily_file_sink.h>
 #include <spdlog/sinks/sink.h>
@@ -11,6 +13,12 @@
 #   include <spdlog/sinks/msvc_sink.h>
 #endif
 
+// SSE2 is a part of any x64 cpu, on x86 it depends on the target architecture flags
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define UTILS_USE_SSE2
+#   include <emmintrin.h>
+#endif
+
 bool operator==(const FarKey &lhs, const FarKey &rhs)
 {
     return (lhs.VirtualKeyCode == rhs.VirtualKeyCode &&
@@ -774,7 +782,7 @@ namespace log
     }
 }
 
-wstring utf8_decode(const string &s)
+static wstring utf8_decode_system(const string &s)
 {
     int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), NULL, 0);
     wstring out(len, 0);
@@ -782,7 +790,7 @@ wstring utf8_decode(const string &s)
     return out;
 }
 
-string utf8_encode(const wstring &ws)
+static string utf8_encode_system(const wstring &ws)
 {
     int len = WideCharToMultiByte(CP_UTF8, 0, ws.c_str(), (int)ws.size(), NULL, 0, NULL, NULL);
     string out(len, 0);
@@ -790,6 +798,148 @@ string utf8_encode(const wstring &ws)
     return out;
 }
 
+wstring utf8_decode(const string &s)
+{
+    static_assert(sizeof(wchar_t) == 2, "the wide strings are expected to be utf16");
+
+    // every utf8 sequence gives no more utf16 units than its length
+    wstring out(s.size(), 0);
+
+    auto *src = reinterpret_cast<const uint8_t*>(s.data()), *end = src + s.size();
+    auto *dst = out.data();
+
+    while (src < end)
+    {
+#ifdef UTILS_USE_SSE2
+        if (end - src >= 16)
+        {
+            const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            const auto non_ascii = (unsigned)_mm_movemask_epi8(chunk);
+            if (non_ascii == 0)
+            {
+                const auto zero = _mm_setzero_si128();
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi8(chunk, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), _mm_unpackhi_epi8(chunk, zero));
+                src += 16, dst += 16;
+                continue;
+            }
+
+            // the ascii bytes before the first multi-byte sequence
+            for (int i = std::countr_zero(non_ascii); i > 0; --i)
+                *dst++ = *src++;
+        }
+#endif
+        uint32_t c = *src;
+        if (c < 0x80)
+        {
+            *dst++ = (wchar_t)c;
+            ++src;
+            continue;
+        }
+
+        size_t tail;
+        uint32_t min_code;
+        if ((c & 0xE0) == 0xC0)
+            tail = 1, c &= 0x1F, min_code = 0x80;
+        else if ((c & 0xF0) == 0xE0)
+            tail = 2, c &= 0x0F, min_code = 0x800;
+        else if ((c & 0xF8) == 0xF0)
+            tail = 3, c &= 0x07, min_code = 0x10000;
+        else
+            return utf8_decode_system(s);
+
+        if ((size_t)(end - src) <= tail)
+            return utf8_decode_system(s);
+
+        for (size_t i = 1; i <= tail; ++i)
+        {
+            if ((src[i] & 0xC0) != 0x80)
+                return utf8_decode_system(s);
+            c = (c << 6) | (src[i] & 0x3F);
+        }
+
+        // overlong forms, surrogates and the codes out of the unicode range are not valid utf8
+        if (c < min_code || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+            return utf8_decode_system(s);
+
+        src += tail + 1;
+
+        if (c >= 0x10000)
+        {
+            c -= 0x10000;
+            *dst++ = (wchar_t)(0xD800 + (c >> 10));
+            *dst++ = (wchar_t)(0xDC00 + (c & 0x3FF));
+        }
+        else
+            *dst++ = (wchar_t)c;
+    }
+
+    out.resize(dst - out.data());
+    return out;
+}
+
+string utf8_encode(const wstring &ws)
+{
+    // a utf16 unit gives three utf8 bytes at most, a surrogate pair gives four
+    string out(ws.size() * 3, 0);
+
+    auto *src = ws.data(), *end = src + ws.size();
+    auto *dst = reinterpret_cast<uint8_t*>(out.data());
+
+    while (src < end)
+    {
+#ifdef UTILS_USE_SSE2
+        if (end - src >= 8)
+        {
+            const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            const auto high_bits = _mm_and_si128(chunk, _mm_set1_epi16((short)0xFF80));
+            const auto ascii = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(high_bits, _mm_setzero_si128()));
+            if (ascii == 0xFFFF)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(chunk, chunk));
+                src += 8, dst += 8;
+                continue;
+            }
+
+            // the ascii units before the first wider one, two mask bits per unit
+            for (int i = std::countr_one(ascii) / 2; i > 0; --i)
+                *dst++ = (uint8_t)*src++;
+        }
+#endif
+        uint32_t c = *src++;
+        if (c < 0x80)
+        {
+            *dst++ = (uint8_t)c;
+        }
+        else if (c < 0x800)
+        {
+            *dst++ = (uint8_t)(0xC0 | (c >> 6));
+            *dst++ = (uint8_t)(0x80 | (c & 0x3F));
+        }
+        else if (c >= 0xD800 && c <= 0xDFFF)
+        {
+            if (c > 0xDBFF || src == end || *src < 0xDC00 || *src > 0xDFFF)
+                return utf8_encode_system(ws);
+
+            c = 0x10000 + ((c - 0xD800) << 10) + ((uint32_t)*src++ - 0xDC00);
+
+            *dst++ = (uint8_t)(0xF0 | (c >> 18));
+            *dst++ = (uint8_t)(0x80 | ((c >> 12) & 0x3F));
+            *dst++ = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+            *dst++ = (uint8_t)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            *dst++ = (uint8_t)(0xE0 | (c >> 12));
+            *dst++ = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+            *dst++ = (uint8_t)(0x80 | (c & 0x3F));
+        }
+    }
+
+    out.resize(dst - reinterpret_cast<uint8_t*>(out.data()));
+    return out;
+}
+
 wstring to_wstring(const string &s)
 {
     return wstring(s.begin(), s.end());
@@ -807,6 +957,63 @@ wstring strip_invalid_filename_chars(const wstring &filename)
     return std::regex_replace(filename, r, L"_");
 }
 
+string gzip_compress(const string &data)
+{
+    z_stream zs{};
+
+    // windowBits 15+16 tells zlib to write a gzip header; the fastest level is used, as for
+    // the json the ratio is almost the same as the default one's, while being much cheaper
+    if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("could not initialize gzip compressor");
+
+    string out(deflateBound(&zs, (uLong)data.size()), '\0');
+
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = (uInt)data.size();
+    zs.next_out = (Bytef*)out.data();
+    zs.avail_out = (uInt)out.size();
+
+    auto ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+
+    if (ret != Z_STREAM_END)
+        throw std::runtime_error(format("gzip compression error {}", ret));
+
+    return out;
+}
+
+string gzip_decompress(const string &data)
+{
+    z_stream zs{};
+
+    // windowBits 15+32 enables automatic gzip/zlib header detection
+    if (inflateInit2(&zs, 15 + 32) != Z_OK)
+        throw std::runtime_error("could not initialize gzip decompressor");
+
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = (uInt)data.size();
+
+    string out;
+    char buffer[32 * 1024];
+
+    int ret = Z_OK;
+    while (ret == Z_OK)
+    {
+        zs.next_out = (Bytef*)buffer;
+        zs.avail_out = sizeof(buffer);
+
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+
+    if (ret != Z_STREAM_END)
+        throw std::runtime_error(format("gzip decompression error {}", ret));
+
+    return out;
+}
+
 string get_last_system_error()
 {
     struct deleter
@@ -966,6 +1173,11 @@ namespace http
         return status_code == OK_200 || status_code == NoContent_204 ||
             status_code == NotModified_304;
     }
+
+    bool is_stale(const http::Result &res)
+    {
+        return res && res->get_header_value("Warning") == stale_warning;
+    }
     
     string get_status_message(const http::Result &res)
     {
@@ -1164,6 +1376,17 @@ namespace json
         j.SetBool(result);
     }
 
+    // wstring
+    void from_json(const Value &j, wstring &result)
+    {
+        result = utf8_decode(string(j.GetString(), j.GetStringLength()));
+    }
+
+    void to_json(Value &j, const wstring &result, Allocator &allocator)
+    {
+        j.SetString(utf8_encode(result), allocator);
+    }
+
     void pretty_print(Value &v)
     {
         StringBuffer sb;
@@ -1171,6 +1394,244 @@ namespace json
         v.Accept(writer);
         log::global->debug(sb.GetString());
     }
+
+    static const unsigned page_parse_flags = rapidjson::kParseDefaultFlags;
+
+    /// @brief A SAX handler, which forwards all the events to the `target` one,
+    /// tracking the nesting depth of the forwarded value
+    template<class H>
+    struct forwarding_handler
+    {
+        H &target;
+        int depth = 0;
+
+        bool Null() { return target.Null(); }
+        bool Bool(bool b) { return target.Bool(b); }
+        bool Int(int i) { return target.Int(i); }
+        bool Uint(unsigned u) { return target.Uint(u); }
+        bool Int64(int64_t i) { return target.Int64(i); }
+        bool Uint64(uint64_t u) { return target.Uint64(u); }
+        bool Double(double d) { return target.Double(d); }
+        bool RawNumber(const char *s, SizeType len, bool copy) { return target.RawNumber(s, len, copy); }
+        bool String(const char *s, SizeType len, bool copy) { return target.String(s, len, copy); }
+        bool Key(const char *s, SizeType len, bool copy) { return target.Key(s, len, copy); }
+        bool StartObject() { depth++; return target.StartObject(); }
+        bool EndObject(SizeType count) { depth--; return target.EndObject(count); }
+        bool StartArray() { depth++; return target.StartArray(); }
+        bool EndArray(SizeType count) { depth--; return target.EndArray(count); }
+    };
+
+    /// @brief A SAX handler of the page level events: finds the page object and its
+    /// `items` array, picks up `total` and `next` fields; the start of each item is
+    /// reported via `item_start`, so the item itself can be read by somebody else
+    struct page_handler: public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, page_handler>
+    {
+        enum item_start_t { none, object, array, scalar, null };
+
+        string fieldname;
+        std::vector<string> keys; // the current key on each nesting level
+        int page_depth = 0, items_depth = 0;
+        item_start_t item_start = none;
+
+        size_t total = 0;
+        string next;
+        bool is_next_read = false; // the `next` url is read and not reported yet
+        bool is_total_read = false;
+
+        page_handler(const string &fieldname): fieldname(fieldname) {}
+
+        bool is_items_level() const { return items_depth > 0 && (int)keys.size() == items_depth; }
+        bool is_page_level() const { return page_depth > 0 && (int)keys.size() == page_depth; }
+        auto get_page_key() const -> const string& { return keys.back(); }
+
+        bool Default()
+        {
+            if (is_items_level())
+                item_start = scalar;
+            return true;
+        }
+
+        bool Null()
+        {
+            if (is_items_level())
+                item_start = null;
+            else if (is_page_level() && get_page_key() == "next")
+                next.clear();
+            return true;
+        }
+
+        bool Uint(unsigned u) { return Uint64(u); }
+        bool Uint64(uint64_t u)
+        {
+            if (is_page_level() && get_page_key() == "total")
+            {
+                total = (size_t)u;
+                is_total_read = true;
+            }
+            return Default();
+        }
+
+        bool String(const char *s, SizeType len, bool)
+        {
+            if (is_page_level() && get_page_key() == "next")
+            {
+                next.assign(s, len);
+                is_next_read = !next.empty();
+            }
+            return Default();
+        }
+
+        bool Key(const char *s, SizeType len, bool)
+        {
+            keys.back().assign(s, len);
+            return true;
+        }
+
+        bool StartObject()
+        {
+            if (is_items_level())
+            {
+                item_start = object;
+                return true;
+            }
+
+            keys.emplace_back();
+
+            // the page object is either the root one or nested under `fieldname` key
+            if (page_depth == 0 && (fieldname.empty() ? keys.size() == 1 :
+                    keys.size() == 2 && keys[0] == fieldname))
+                page_depth = (int)keys.size();
+
+            return true;
+        }
+
+        bool StartArray()
+        {
+            if (is_items_level())
+            {
+                item_start = array;
+                return true;
+            }
+
+            if (is_page_level() && get_page_key() == "items")
+                items_depth = page_depth + 1;
+
+            keys.emplace_back();
+            return true;
+        }
+
+        bool EndObject(SizeType) { return end_scope(); }
+        bool EndArray(SizeType) { return end_scope(); }
+
+        bool end_scope()
+        {
+            if (is_items_level())
+                items_depth = 0;
+            else if (is_page_level())
+                page_depth = -1; // the page is read, the rest is skipped
+
+            keys.pop_back();
+            return true;
+        }
+    };
+
+    static void throw_page_parse_error(const rapidjson::Reader &reader)
+    {
+        throw std::runtime_error(utils::format("json parse error '{}' at {}",
+            GetParseError_En(reader.GetParseErrorCode()), reader.GetErrorOffset()));
+    }
+
+    void page_reader::read(const string &json, const string &fieldname, item_handler_t on_item,
+        next_handler_t on_next)
+    {
+        rapidjson::Reader reader;
+        rapidjson::StringStream stream(json.c_str());
+        page_handler handler(fieldname);
+
+        // each item's DOM is built on top of the same buffer, so the items of the regular
+        // sizes do not allocate anything
+        std::vector<char> items_buffer(32 * 1024);
+
+        auto throw_parse_error = [&reader] { throw_page_parse_error(reader); };
+
+        reader.IterativeParseInit();
+        while (!reader.IterativeParseComplete())
+        {
+            if (!reader.IterativeParseNext<page_parse_flags>(stream, handler))
+                throw_parse_error();
+
+            if (std::exchange(handler.is_next_read, false) && on_next)
+                on_next(handler.next);
+
+            if (handler.item_start == page_handler::none)
+                continue;
+
+            auto item_start = std::exchange(handler.item_start, page_handler::none);
+            if (item_start == page_handler::null || item_start == page_handler::scalar)
+            {
+                on_item(Value());
+                continue;
+            }
+
+            rapidjson::MemoryPoolAllocator<> allocator(items_buffer.data(), items_buffer.size());
+            Document item(&allocator);
+
+            // the item's opening event has been consumed by the page handler already, so it
+            // is replayed first, the rest of the item is read right into the document
+            auto generator = [&](Document &target)
+            {
+                forwarding_handler<Document> forwarder{ target };
+
+                if (!(item_start == page_handler::object ? forwarder.StartObject() : forwarder.StartArray()))
+                    return false;
+
+                while (forwarder.depth > 0)
+                    if (!reader.IterativeParseNext<page_parse_flags>(stream, forwarder))
+                        return false;
+
+                return true;
+            };
+            item.Populate(generator);
+
+            if (reader.HasParseError())
+                throw_parse_error();
+
+            on_item(item);
+        }
+
+        total = handler.total;
+        next = handler.next;
+    }
+
+    void page_reader::read_total(const string &json, const string &fieldname)
+    {
+        rapidjson::Reader reader;
+        rapidjson::StringStream stream(json.c_str());
+        page_handler handler(fieldname);
+
+        // the items' events are consumed by the handler, which does nothing but tracks
+        // the depth, so the item's end is found
+        rapidjson::BaseReaderHandler<> sink;
+        forwarding_handler<rapidjson::BaseReaderHandler<>> skipper{ sink };
+
+        reader.IterativeParseInit();
+        while (!reader.IterativeParseComplete() && !handler.is_total_read)
+        {
+            if (!reader.IterativeParseNext<page_parse_flags>(stream, handler))
+                throw_page_parse_error(reader);
+
+            auto item_start = std::exchange(handler.item_start, page_handler::none);
+            if (item_start != page_handler::object && item_start != page_handler::array)
+                continue;
+
+            for (skipper.depth = 1; skipper.depth > 0;)
+                if (!reader.IterativeParseNext<page_parse_flags>(stream, skipper))
+                    throw_page_parse_error(reader);
+        }
+
+        total = handler.total;
+        next = handler.next;
+    }
 }
 
 } // namespace utils
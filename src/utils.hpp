@@ -8,10 +8,15 @@
 namespace spotifar { namespace utils {
 
 /// @brief Converts utf8 encoded string into wide-char one
+/// @note the ascii runs are widened 16 bytes at a time, the rest is decoded in place; an
+/// invalid input is handed over to the system's conversion, so the replacement characters
+/// are the same as they were
 TEST_API wstring utf8_decode(const string &s);
 
 /// @brief Converts wide-char string into utf8 encoded string
-string utf8_encode(const wstring &ws);
+/// @note the same way as `utf8_decode` does: vectorised ascii runs, the system's conversion
+/// for the unpaired surrogates
+TEST_API string utf8_encode(const wstring &ws);
 
 /// @brief Bluntly converts char string into wide-char string
 /// @note The function does not care about string encoding, all the multi-byte
@@ -27,6 +32,13 @@ string to_string(const wstring &ws);
 /// with the underscore
 TEST_API wstring strip_invalid_filename_chars(const wstring &filename);
 
+/// @brief Compresses the given `data` into the gzip format
+TEST_API string gzip_compress(const string &data);
+
+/// @brief Decompresses the given gzip or zlib compressed `data`. Throws
+/// std::runtime_error in case the data is corrupted
+TEST_API string gzip_decompress(const string &data);
+
 /// @brief Returns the message of GetLastError function
 string get_last_system_error();
 
@@ -538,20 +550,24 @@ namespace far3
 namespace json
 {
     /// @brief string support for rapidjson parse/pack
-    void from_json(const Value &j, string &result);
-    void to_json(Value &j, const string &result, Allocator &allocator);
+    TEST_API void from_json(const Value &j, string &result);
+    TEST_API void to_json(Value &j, const string &result, Allocator &allocator);
     
     /// @brief integer support for rapidjson parse/pack
-    void from_json(const Value &j, int &result);
-    void to_json(Value &j, const int &result, Allocator &allocator);
+    TEST_API void from_json(const Value &j, int &result);
+    TEST_API void to_json(Value &j, const int &result, Allocator &allocator);
     
     /// @brief size_t support for rapidjson parse/pack
-    void from_json(const Value &j, size_t &result);
-    void to_json(Value &j, const size_t &result, Allocator &allocator);
+    TEST_API void from_json(const Value &j, size_t &result);
+    TEST_API void to_json(Value &j, const size_t &result, Allocator &allocator);
     
     /// @brief bool support for json parse/pack
-    void from_json(const Value &j, bool &result);
-    void to_json(Value &j, const bool &result, Allocator &allocator);
+    TEST_API void from_json(const Value &j, bool &result);
+    TEST_API void to_json(Value &j, const bool &result, Allocator &allocator);
+
+    /// @brief wstring support for rapidjson parse/pack, the text is kept utf8 encoded in json
+    TEST_API void from_json(const Value &j, wstring &result);
+    TEST_API void to_json(Value &j, const wstring &result, Allocator &allocator);
 
     /// @brief vector support for rapidjson parse/pack
     /// @note the vector's type T should support packing as well
@@ -667,6 +683,228 @@ namespace json
         }
     }
 
+    /// @brief A compile-time description of an object's json layout: a tuple of the field
+    /// descriptors, from which both the reader and the writer of the object are generated.
+    /// The reader walks the object's members once and dispatches each of them to its
+    /// descriptor by the name, instead of looking every field up with `HasMember`/`operator[]`,
+    /// each of which is a linear scan of the members in rapidjson.
+    /// @code
+    /// static constexpr auto image_fields = std::tuple{
+    ///     schema::field("url", &image_t::url),
+    ///     schema::field("width", &image_t::width),
+    /// };
+    /// static constexpr auto artist_fields = std::tuple_cat(simplified_artist_fields, std::tuple{
+    ///     schema::object("followers", std::tuple{
+    ///         schema::field("total", &artist_t::followers_total) }),
+    /// });
+    /// @endcode
+    /// Every descriptor provides the same interface: a `name` of the json member it handles;
+    /// `begin` called before the members walk; `read` called with the member's value once it
+    /// is met; `finish` called after the walk with a flag whether the member was met; and
+    /// `write` to add the member to the resulting object
+    namespace schema
+    {
+        /// @brief `optional` - the member can be absent, `nullable` - the member can be null;
+        /// in both cases the field is reset to its value-initialized state
+        enum flags_t: uint8_t
+        {
+            required = 0,
+            optional = 1 << 0,
+            nullable = 1 << 1,
+        };
+
+        /// @brief An object's field mapped to the json member of the same type, the member
+        /// pointer can belong to the object's base class, so the base's fields can be reused
+        /// by the derived types' schemas as they are
+        template<class O, class M>
+        struct field_t
+        {
+            std::string_view name;
+            M O::*member;
+            uint8_t flags = required;
+
+            template<class T>
+            void begin(T &obj) const {}
+
+            template<class T>
+            void read(const Value &j, T &obj) const
+            {
+                if ((flags & nullable) && j.IsNull())
+                    obj.*member = M{};
+                else
+                    from_json(j, obj.*member);
+            }
+
+            template<class T>
+            void finish(T &obj, bool is_met) const
+            {
+                if (is_met)
+                    return;
+
+                if (!(flags & optional))
+                    throw std::runtime_error(format("json error, no required member '{}'", name));
+
+                obj.*member = M{};
+            }
+
+            template<class T>
+            void write(Value &result, const T &obj, Allocator &allocator) const
+            {
+                Value value;
+                to_json(value, obj.*member, allocator);
+                result.AddMember(Value(StringRef(name.data(), (SizeType)name.size())), value, allocator);
+            }
+        };
+
+        /// @brief A nested json object with the fields of the same object, e.g. the `followers`
+        /// object with the only `total` field or the `track` object wrapping the saved track
+        template<class... F>
+        struct object_t
+        {
+            std::string_view name;
+            std::tuple<F...> fields;
+            uint8_t flags = required;
+
+            template<class T>
+            void begin(T &obj) const {}
+
+            template<class T>
+            void read(const Value &j, T &obj) const;
+
+            template<class T>
+            void finish(T &obj, bool is_met) const
+            {
+                if (!is_met && !(flags & optional))
+                    throw std::runtime_error(format("json error, no required member '{}'", name));
+            }
+
+            template<class T>
+            void write(Value &result, const T &obj, Allocator &allocator) const;
+        };
+
+        /// @brief A boolean field stored inverted in json and only when it is off, the way
+        /// the playback `disallows` object lists the actions: the ones absent are allowed
+        template<class O>
+        struct flag_t
+        {
+            std::string_view name;
+            bool O::*member;
+
+            template<class T>
+            void begin(T &obj) const { obj.*member = true; }
+
+            template<class T>
+            void read(const Value &j, T &obj) const { obj.*member = !j.GetBool(); }
+
+            template<class T>
+            void finish(T &obj, bool is_met) const {}
+
+            template<class T>
+            void write(Value &result, const T &obj, Allocator &allocator) const
+            {
+                if (!(obj.*member))
+                    result.AddMember(Value(StringRef(name.data(), (SizeType)name.size())), Value(true), allocator);
+            }
+        };
+
+        /// @brief Not a member, a hook called once all the object's members are read, to fill
+        /// the fields derived from the others
+        template<class O>
+        struct then_t
+        {
+            void (*handler)(O &obj);
+            std::string_view name{};
+
+            template<class T>
+            void begin(T &obj) const {}
+
+            template<class T>
+            void read(const Value &j, T &obj) const {}
+
+            template<class T>
+            void finish(T &obj, bool is_met) const { handler(obj); }
+
+            template<class T>
+            void write(Value &result, const T &obj, Allocator &allocator) const {}
+        };
+
+        template<class O, class M>
+        constexpr auto field(std::string_view name, M O::*member, uint8_t flags = required)
+        {
+            return field_t<O, M>{ name, member, flags };
+        }
+
+        template<class... F>
+        constexpr auto object(std::string_view name, std::tuple<F...> fields, uint8_t flags = required)
+        {
+            return object_t<F...>{ name, fields, flags };
+        }
+
+        template<class O>
+        constexpr auto flag(std::string_view name, bool O::*member)
+        {
+            return flag_t<O>{ name, member };
+        }
+
+        template<class O>
+        constexpr auto then(void (*handler)(O &obj))
+        {
+            return then_t<O>{ handler };
+        }
+
+        /// @brief Reads the json object `j` into `obj` with the given fields descriptors in
+        /// one pass over its members; the members not described are skipped
+        template<class T, class... F>
+        void read(const Value &j, T &obj, const std::tuple<F...> &fields)
+        {
+            static_assert(sizeof...(F) <= 64, "too many fields to track the met ones");
+
+            if (!j.IsObject())
+                throw std::runtime_error("json error, an object is expected");
+
+            [&]<size_t... I>(std::index_sequence<I...>)
+            {
+                (std::get<I>(fields).begin(obj), ...);
+
+                uint64_t met = 0;
+                for (auto it = j.MemberBegin(); it != j.MemberEnd(); ++it)
+                {
+                    const std::string_view key(it->name.GetString(), it->name.GetStringLength());
+                    (void)((std::get<I>(fields).name == key &&
+                        (std::get<I>(fields).read(it->value, obj), met |= 1ull << I, true)) || ...);
+                }
+
+                (std::get<I>(fields).finish(obj, (met & (1ull << I)) != 0), ...);
+            }(std::index_sequence_for<F...>{});
+        }
+
+        /// @brief Writes `obj` into `result` as a json object with the given fields descriptors
+        template<class T, class... F>
+        void write(Value &result, const T &obj, const std::tuple<F...> &fields, Allocator &allocator)
+        {
+            result.SetObject();
+            std::apply([&](const auto&... field) {
+                (field.write(result, obj, allocator), ...);
+            }, fields);
+        }
+
+        template<class... F>
+        template<class T>
+        void object_t<F...>::read(const Value &j, T &obj) const
+        {
+            schema::read(j, obj, fields);
+        }
+
+        template<class... F>
+        template<class T>
+        void object_t<F...>::write(Value &result, const T &obj, Allocator &allocator) const
+        {
+            Value value;
+            schema::write(value, obj, fields, allocator);
+            result.AddMember(Value(StringRef(name.data(), (SizeType)name.size())), value, allocator);
+        }
+    }
+
     /// @brief Dumps a given object supporting serialization to string. Returns a shared_ptr to StringBuffer
     /// @tparam T `value` object type, must support jsong serialization (from_json/to_json methods)
     template<class T>
@@ -706,6 +944,57 @@ namespace json
     }
 
     void pretty_print(Value &doc);
+
+    /// @brief A streaming reader of the API collection pages: {"items": [...], "total": N,
+    /// "next": "url", ...}, optionally nested under some `fieldname` key. Instead of building
+    /// a DOM of the whole page, the body is walked with SAX events and only one item at a time
+    /// is materialized into a small temporary document, which is handed to the caller and
+    /// dropped right after. The page's `total` and `next` fields are picked up on the way
+    class TEST_API page_reader
+    {
+    public:
+        using item_handler_t = std::function<void(const Value &item)>;
+        using next_handler_t = std::function<void(const string &next)>;
+    public:
+        /// @brief Reads the page from the `json` string, calling `on_item` for each of the
+        /// page's items in order; the `null` items are passed as null values. Throws
+        /// std::runtime_error in case of malformed json
+        /// @param on_next is called as soon as the page's non-empty `next` url is read, the
+        /// cursor-paged responses have it ahead of the items
+        void read(const string &json, const string &fieldname, item_handler_t on_item,
+            next_handler_t on_next = nullptr);
+
+        /// @brief Reads only the page's `total` from the `json` string: the items are walked
+        /// through with no documents built, the reading stops once the total is read. Throws
+        /// std::runtime_error in case of malformed json
+        void read_total(const string &json, const string &fieldname);
+
+        auto get_total() const -> size_t { return total; }
+        auto get_next() const -> const string& { return next; }
+    private:
+        size_t total = 0;
+        string next;
+    };
+
+    /// @brief Reads the collection page `json` straight into the `items` container,
+    /// see `page_reader` for details
+    template<class T>
+    void read_page(const string &json, const string &fieldname, std::vector<T> &items,
+        size_t &total, string &next, page_reader::next_handler_t on_next = nullptr)
+    {
+        items.clear();
+
+        page_reader reader;
+        reader.read(json, fieldname, [&items](const Value &item)
+        {
+            auto &value = items.emplace_back();
+            if (!item.IsNull())
+                from_json(item, value);
+        }, on_next);
+
+        total = reader.get_total();
+        next = reader.get_next();
+    }
 }
 
 namespace http
@@ -724,6 +1013,13 @@ namespace http
     /// @param status_code httplib::Result->status
     bool is_success(int status_code);
 
+    /// @brief The `Warning` header value of a response, served from cache after it expired,
+    /// see https://www.rfc-editor.org/rfc/rfc7234#section-5.5.1
+    static const char *const stale_warning = "110 - \"Response is Stale\"";
+
+    /// @brief Returns whether the response was served from cache after it had expired
+    bool is_stale(const http::Result &res);
+
     /// @brief Returns a string message, representing a response result
     string get_status_message(const http::Result &res);
     
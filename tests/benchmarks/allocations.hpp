@@ -0,0 +1,46 @@
+#ifndef ALLOCATIONS_HPP_3C1D7A52_9E84_4F0B_A6C2_5D27E81B4F93
+#define ALLOCATIONS_HPP_3C1D7A52_9E84_4F0B_A6C2_5D27E81B4F93
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/// @brief The bytes allocated by the counted containers of the benchmarks and not freed yet:
+/// the nodes, the buckets, the strings' heap buffers
+inline size_t allocated_bytes = 0;
+
+/// @brief The number of the allocations made by the counted containers so far
+inline size_t allocations_count = 0;
+
+template<class T>
+struct counting_allocator
+{
+    using value_type = T;
+
+    counting_allocator() = default;
+    template<class U> counting_allocator(const counting_allocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        allocated_bytes += n * sizeof(T);
+        ++allocations_count;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        allocated_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<class U> bool operator==(const counting_allocator<U>&) const { return true; }
+};
+
+using counted_string = std::basic_string<char, std::char_traits<char>, counting_allocator<char>>;
+using counted_wstring = std::basic_string<wchar_t, std::char_traits<wchar_t>, counting_allocator<wchar_t>>;
+
+template<class T>
+using counted_vector = std::vector<T, counting_allocator<T>>;
+
+#endif // ALLOCATIONS_HPP_3C1D7A52_9E84_4F0B_A6C2_5D27E81B4F93
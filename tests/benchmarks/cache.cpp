@@ -0,0 +1,498 @@
+#include <benchmark/benchmark.h>
+#include "spotify/cache.hpp"
+#include "allocations.hpp"
+
+using namespace spotifar;
+using namespace spotifar::utils;
+using namespace spotifar::spotify;
+
+/// @brief The amount of the cached responses, a big library synced several times
+static const size_t entries_count = 50000;
+
+/// @brief A size of a typical stored (compressed) response body
+static const size_t body_size = 1024;
+
+static auto get_url(size_t idx) -> string
+{
+    return format("https://api.spotify.com/v1/albums/{:022}/tracks?limit=50&offset=0", idx);
+}
+
+static auto get_body(size_t idx) -> string
+{
+    string body(body_size, '\0');
+    for (size_t i = 0; i < body_size; ++i)
+        body[i] = (char)((idx * 31 + i * 17) & 0xFF);
+    return body;
+}
+
+static auto get_bench_folder() -> std::filesystem::path
+{
+    auto folder = std::filesystem::temp_directory_path() / "spotifar_benchmarks";
+    std::filesystem::create_directories(folder);
+    return folder;
+}
+
+/// @brief Builds the binary cache file with `entries_count` responses once per run
+static auto get_storage_file() -> const std::filesystem::path&
+{
+    static const auto filepath = []
+    {
+        auto filepath = get_bench_folder() / "responses.dat";
+        std::filesystem::remove(filepath);
+
+        cache_storage storage;
+        storage.open(filepath);
+        for (size_t idx = 0; idx < entries_count; ++idx)
+            storage.put(get_url(idx), format("\"{:032x}\"", idx), get_body(idx),
+                utils::clock_t::now() + 24h, true);
+        storage.close();
+
+        return filepath;
+    }();
+    return filepath;
+}
+
+/// @brief Builds the json cache file of the previous format with the same responses,
+/// the binary bodies were stored base64 encoded, so the body is of the same size here
+static auto get_json_file() -> const std::filesystem::path&
+{
+    static const auto filepath = []
+    {
+        auto filepath = get_bench_folder() / "responses.json";
+
+        StringBuffer sb;
+        json::Writer<StringBuffer> w(sb);
+
+        w.StartObject();
+        for (size_t idx = 0; idx < entries_count; ++idx)
+        {
+            w.Key(get_url(idx));
+            w.StartObject();
+            w.Key("etag"); w.String(format("\"{:032x}\"", idx));
+            w.Key("body-gz"); w.String(string(body_size * 4 / 3, 'A'));
+            w.Key("cached-until"); w.Int64((utils::clock_t::now() + 24h).time_since_epoch().count());
+            w.EndObject();
+        }
+        w.EndObject();
+
+        std::ofstream(filepath, std::ios::binary).write(sb.GetString(), sb.GetSize());
+
+        return filepath;
+    }();
+    return filepath;
+}
+
+/// @brief The previous way: the whole file is read and parsed into a DOM on startup
+static void BM_cache_load_json(benchmark::State &state)
+{
+    const auto &filepath = get_json_file();
+
+    for (auto _: state)
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        json::Document doc;
+        doc.Parse(buffer);
+
+        benchmark::DoNotOptimize(doc.MemberCount());
+    }
+
+    state.SetItemsProcessed(state.iterations() * entries_count);
+}
+
+/// @brief The binary file: only the index is read, the bodies stay on disk
+static void BM_cache_load_binary(benchmark::State &state)
+{
+    const auto &filepath = get_storage_file();
+
+    for (auto _: state)
+    {
+        cache_storage storage;
+        storage.open(filepath);
+
+        benchmark::DoNotOptimize(storage.get_stats().entries);
+    }
+
+    state.SetItemsProcessed(state.iterations() * entries_count);
+}
+
+/// @brief Reading one body on demand from the mapped file
+static void BM_cache_read_body(benchmark::State &state)
+{
+    cache_storage storage;
+    storage.open(get_storage_file());
+
+    size_t idx = 0;
+    for (auto _: state)
+    {
+        const auto *record = storage.find(get_url(idx++ % entries_count));
+        benchmark::DoNotOptimize(storage.read_body(*record));
+    }
+}
+
+/// @brief Concurrent lookups of the in-memory entries from several request threads,
+/// with a writer publishing new versions in the background
+static void BM_http_cache_get(benchmark::State &state)
+{
+    static http_cache cache;
+    static const size_t urls_count = 1000;
+
+    if (state.thread_index() == 0)
+        for (size_t idx = 0; idx < urls_count; ++idx)
+            cache.store(get_url(idx), get_body(idx), std::to_string(idx), 1h);
+
+    size_t idx = state.thread_index();
+    for (auto _: state)
+    {
+        auto url = get_url(idx++ % urls_count);
+        if (state.thread_index() == 0 && idx % 64 == 0)
+            cache.store(url, get_body(idx), std::to_string(idx), 1h);
+        else
+            benchmark::DoNotOptimize(cache.get(url));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief Invalidation after a successful PUT/POST/DELETE request, in a cache filled with the
+/// responses of the different endpoints; the first one does not match any, the second one
+/// matches a few dozens of the saved tracks pages
+static void BM_http_cache_invalidate(benchmark::State &state)
+{
+    http_cache cache;
+    for (size_t idx = 0; idx < (size_t)state.range(0); ++idx)
+    {
+        auto url = idx % 1000 == 0 ?
+            format("/v1/me/tracks?limit=50&offset={}", idx) : get_url(idx);
+        cache.store(url, http_cache::cache_entry{ "etag", "{}", utils::clock_t::now() + 1h });
+    }
+
+    size_t idx = 0;
+    for (auto _: state)
+        cache.invalidate(idx++ % 2 ? "/v1/me/player/volume?volume_percent=50" : "/v1/me/tracks?ids=1");
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief A light stand-in for the `simplified_track_t` item, the fields the albums view needs
+struct bench_album_track_t
+{
+    string id, name;
+    std::vector<string> artists;
+    size_t duration_ms = 0;
+};
+
+static void from_json(const json::Value &j, bench_album_track_t &t)
+{
+    t.id = j["id"].GetString();
+    t.name = j["name"].GetString();
+    t.duration_ms = j["duration_ms"].GetUint();
+
+    for (const auto &artist: j["artists"].GetArray())
+        t.artists.push_back(artist["name"].GetString());
+}
+
+/// @brief Builds a `/v1/albums/{id}/tracks` response page of a typical album
+static auto get_album_tracks_body(size_t idx) -> string
+{
+    StringBuffer sb;
+    json::Writer<StringBuffer> w(sb);
+
+    w.StartObject();
+    w.Key("items");
+    w.StartArray();
+    for (size_t t = 0; t < 12; ++t)
+    {
+        auto track_id = format("{:022}", idx * 100 + t);
+        w.StartObject();
+        w.Key("artists"); w.StartArray();
+        w.StartObject();
+        w.Key("id"); w.String(format("{:022}", idx));
+        w.Key("name"); w.String(format("Artist name {}", idx));
+        w.Key("uri"); w.String(format("spotify:artist:{:022}", idx));
+        w.EndObject();
+        w.EndArray();
+        w.Key("disc_number"); w.Uint(1);
+        w.Key("duration_ms"); w.Uint(215000 + (unsigned)t);
+        w.Key("explicit"); w.Bool(false);
+        w.Key("href"); w.String(format("https://api.spotify.com/v1/tracks/{}", track_id));
+        w.Key("id"); w.String(track_id);
+        w.Key("name"); w.String(format("Track name #{}", t));
+        w.Key("track_number"); w.Uint((unsigned)t + 1);
+        w.Key("uri"); w.String(format("spotify:track:{}", track_id));
+        w.EndObject();
+    }
+    w.EndArray();
+    w.Key("next"); w.Null();
+    w.Key("total"); w.Uint(12);
+    w.EndObject();
+
+    return sb.GetString();
+}
+
+/// @brief The amount of the albums on the panel
+static const size_t panel_albums_count = 500;
+
+/// @brief Fills the http cache with the albums' tracks responses, the way they are after
+/// the panel was shown once
+static void fill_album_tracks(http_cache &cache)
+{
+    for (size_t idx = 0; idx < panel_albums_count; ++idx)
+        cache.store(get_url(idx), get_album_tracks_body(idx), "", 24h);
+}
+
+/// @brief Sums up the album's length from its tracks, the way the albums panel does
+static size_t get_album_length(const std::vector<bench_album_track_t> &tracks)
+{
+    size_t total_length_ms = 0;
+    for (const auto &t: tracks)
+        total_length_ms += t.duration_ms;
+    return total_length_ms;
+}
+
+/// @brief The panel refresh reading the albums' tracks from the warm http cache: every
+/// cached body is decompressed and parsed on every refresh
+static void BM_panel_refresh_responses(benchmark::State &state)
+{
+    http_cache cache;
+    fill_album_tracks(cache);
+
+    for (auto _: state)
+    {
+        for (size_t idx = 0; idx < panel_albums_count; ++idx)
+        {
+            std::vector<bench_album_track_t> tracks;
+            size_t total = 0;
+            string next;
+
+            json::read_page(cache.get(get_url(idx))->get_body(), "", tracks, total, next);
+            benchmark::DoNotOptimize(get_album_length(tracks));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * panel_albums_count);
+}
+
+/// @brief The same refresh with the parsed objects cache: the ready tracks are copied out
+static void BM_panel_refresh_objects(benchmark::State &state)
+{
+    using tracks_t = std::vector<bench_album_track_t>;
+
+    http_cache cache;
+    fill_album_tracks(cache);
+
+    objects_cache objects(cache);
+
+    for (auto _: state)
+    {
+        for (size_t idx = 0; idx < panel_albums_count; ++idx)
+        {
+            const auto &url = get_url(idx);
+
+            tracks_t tracks;
+            if (auto object = objects.get(url, typeid(tracks_t)))
+            {
+                tracks = *std::static_pointer_cast<const tracks_t>(object);
+            }
+            else
+            {
+                auto version = objects.get_version(url);
+                size_t total = 0;
+                string next;
+
+                json::read_page(cache.get(url)->get_body(), "", tracks, total, next);
+                objects.put(url, typeid(tracks_t), version, std::make_shared<const tracks_t>(tracks));
+            }
+            benchmark::DoNotOptimize(get_album_length(tracks));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * panel_albums_count);
+}
+
+/// @brief The same album's track with the counted strings, so the copies of the tracks
+/// made while navigating are reported
+struct counted_album_track_t
+{
+    counted_string id, name;
+    counted_vector<counted_string> artists;
+    size_t duration_ms = 0;
+};
+
+static void from_json(const json::Value &j, counted_album_track_t &t)
+{
+    t.id.assign(j["id"].GetString(), j["id"].GetStringLength());
+    t.name.assign(j["name"].GetString(), j["name"].GetStringLength());
+    t.duration_ms = j["duration_ms"].GetUint();
+
+    for (const auto &artist: j["artists"].GetArray())
+        t.artists.emplace_back(artist["name"].GetString(), artist["name"].GetStringLength());
+}
+
+using counted_tracks_t = std::vector<counted_album_track_t>;
+
+/// @brief The navigation: the artist's albums are listed, the panel is redrawn several times,
+/// summing up every album's length, then one album's tracks are opened and the albums are
+/// listed back again; the artists are visited in turns
+static const size_t artists_count = 10, artist_albums_count = 20, panel_redraws_count = 3;
+
+/// @brief Returns the album's tracks the way the requester does: copied out of the parsed
+/// page of the objects cache, or parsed, if there is none
+static auto request_album_tracks(http_cache &cache, objects_cache &objects, size_t idx,
+    uint64_t &version) -> counted_tracks_t
+{
+    const auto &url = get_url(idx);
+
+    counted_tracks_t tracks;
+    version = objects.get_version(url);
+
+    if (auto object = objects.get(url, typeid(counted_tracks_t)))
+        return *std::static_pointer_cast<const counted_tracks_t>(object);
+
+    size_t total = 0;
+    string next;
+    json::read_page(cache.get(url)->get_body(), "", tracks, total, next);
+    objects.put(url, typeid(counted_tracks_t), version, std::make_shared<const counted_tracks_t>(tracks));
+
+    return tracks;
+}
+
+/// @brief Reports the allocations, made per one navigation round, and all the tracks' memory
+/// held, when the album is opened: the parsed pages, the shared snapshots and the views' ones
+static void report_navigation(benchmark::State &state, size_t allocations, size_t held_bytes)
+{
+    state.counters["allocs_per_round"] = benchmark::Counter((double)allocations,
+        benchmark::Counter::kAvgIterations);
+    state.counters["held_kb"] = (double)held_bytes / 1024;
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief Every view gets its own collection: the albums panel fetches a temporary one per
+/// album on every redraw, the tracks view fetches the album once more
+static void BM_navigation_collections(benchmark::State &state)
+{
+    http_cache cache;
+    fill_album_tracks(cache);
+    objects_cache objects(cache);
+
+    const auto bytes_before = allocated_bytes;
+
+    size_t artist = 0, allocations = 0, held_bytes = 0;
+    for (auto _: state)
+    {
+        const auto first_album = (artist++ % artists_count) * artist_albums_count;
+        const auto allocations_before = allocations_count;
+
+        auto list_albums = [&]
+        {
+            for (size_t redraw = 0; redraw < panel_redraws_count; ++redraw)
+                for (size_t idx = first_album; idx < first_album + artist_albums_count; ++idx)
+                {
+                    uint64_t version = 0;
+                    benchmark::DoNotOptimize(get_album_length(request_album_tracks(cache, objects, idx, version)));
+                }
+        };
+
+        list_albums();
+        {
+            uint64_t version = 0;
+            auto tracks_view = request_album_tracks(cache, objects, first_album, version);
+            held_bytes = allocated_bytes - bytes_before;
+
+            benchmark::DoNotOptimize(tracks_view.data());
+        }
+        list_albums();
+
+        allocations += allocations_count - allocations_before;
+    }
+
+    report_navigation(state, allocations, held_bytes);
+}
+
+/// @brief The collections take the shared snapshots from the registry: the albums view holds
+/// the albums' tracks and sums them up once per version, the tracks view shares the album's
+/// ones, the albums listed back find them among the retained
+static void BM_navigation_registry(benchmark::State &state)
+{
+    using snapshot_t = std::shared_ptr<const counted_tracks_t>;
+
+    http_cache cache;
+    fill_album_tracks(cache);
+    objects_cache objects(cache);
+    collections_registry registry(cache);
+
+    // the collection's fetching: the current snapshot or a new one, published right away
+    auto fetch = [&](size_t idx, uint64_t &version) -> snapshot_t
+    {
+        if (auto shared = registry.find(get_url(idx), typeid(counted_tracks_t), version))
+            return std::static_pointer_cast<const counted_tracks_t>(shared);
+
+        uint64_t page_version = 0;
+        auto snapshot = std::make_shared<const counted_tracks_t>(request_album_tracks(cache, objects, idx, page_version));
+        version = registry.publish(get_url(idx), typeid(counted_tracks_t), { { get_url(idx), page_version } }, snapshot);
+        return snapshot;
+    };
+
+    struct album_length_t
+    {
+        snapshot_t tracks;
+        uint64_t version = 0;
+        size_t total_length_ms = 0;
+    };
+
+    const auto bytes_before = allocated_bytes;
+
+    size_t artist = 0, allocations = 0, held_bytes = 0;
+    for (auto _: state)
+    {
+        const auto first_album = (artist++ % artists_count) * artist_albums_count;
+        const auto allocations_before = allocations_count;
+
+        auto list_albums = [&](std::unordered_map<size_t, album_length_t> &lengths)
+        {
+            for (size_t redraw = 0; redraw < panel_redraws_count; ++redraw)
+                for (size_t idx = first_album; idx < first_album + artist_albums_count; ++idx)
+                {
+                    auto &length = lengths[idx];
+
+                    uint64_t version = 0;
+                    length.tracks = fetch(idx, version);
+                    if (length.version == 0 || length.version != version)
+                    {
+                        length.total_length_ms = get_album_length(*length.tracks);
+                        length.version = version;
+                    }
+                    benchmark::DoNotOptimize(length.total_length_ms);
+                }
+        };
+
+        std::unordered_map<size_t, album_length_t> albums_view;
+        list_albums(albums_view);
+        {
+            uint64_t version = 0;
+            auto tracks_view = fetch(first_album, version);
+            held_bytes = allocated_bytes - bytes_before;
+
+            benchmark::DoNotOptimize(tracks_view->data());
+        }
+
+        // the albums view is built anew, while the previous one is still there
+        std::unordered_map<size_t, album_length_t> albums_view_back;
+        list_albums(albums_view_back);
+
+        allocations += allocations_count - allocations_before;
+    }
+
+    report_navigation(state, allocations, held_bytes);
+}
+
+BENCHMARK(BM_cache_load_json)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_cache_load_binary)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_cache_read_body);
+BENCHMARK(BM_http_cache_get)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_http_cache_invalidate)->Arg(10000)->Arg(50000)->Arg(100000);
+BENCHMARK(BM_panel_refresh_responses)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_panel_refresh_objects)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_navigation_collections)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_navigation_registry)->Unit(benchmark::kMicrosecond);
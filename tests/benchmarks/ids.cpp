@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+#include "spotify/ids.hpp"
+#include "allocations.hpp"
+
+using namespace spotifar;
+using namespace spotifar::utils;
+using namespace spotifar::spotify;
+
+/// @brief The amount of the ids in the library statuses cache, a big library
+static const size_t ids_count = 50000;
+
+struct counted_string_hash
+{
+    size_t operator()(const counted_string &s) const
+    {
+        return std::hash<std::string_view>{}(std::string_view(s.data(), s.size()));
+    }
+};
+
+/// @brief The previous statuses container, keyed by the id strings
+using string_statuses_t = std::unordered_map<counted_string, bool, counted_string_hash,
+    std::equal_to<counted_string>, counting_allocator<std::pair<const counted_string, bool>>>;
+
+/// @brief The current one, keyed by the compact ids
+using compact_statuses_t = std::unordered_map<spotify_id_t, bool, std::hash<spotify_id_t>,
+    std::equal_to<spotify_id_t>, counting_allocator<std::pair<const spotify_id_t, bool>>>;
+
+static auto get_ids() -> const item_ids_t&
+{
+    static const item_ids_t ids = []
+    {
+        static const char alphabet[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+        item_ids_t ids;
+        uint64_t seed = 42;
+        for (size_t idx = 0; idx < ids_count; ++idx)
+        {
+            string id(spotify_id_t::length, '0');
+            for (size_t c = 1; c < id.size(); ++c)
+            {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                id[c] = alphabet[(seed >> 33) % 62];
+            }
+            ids.push_back(id);
+        }
+        return ids;
+    }();
+    return ids;
+}
+
+/// @brief Fills the statuses container with all the ids, reporting the memory it takes
+template<class C, class K>
+static auto fill_statuses(benchmark::State &state, const std::vector<K> &keys) -> C
+{
+    const auto before = allocated_bytes;
+
+    C statuses;
+    for (const auto &key: keys)
+        statuses.emplace(key, true);
+
+    state.counters["bytes_per_id"] = (double)(allocated_bytes - before) / keys.size();
+    return statuses;
+}
+
+/// @brief Lookups of the known ids, the views hold the ids as strings
+static void BM_statuses_string_ids(benchmark::State &state)
+{
+    std::vector<counted_string> keys;
+    for (const auto &id: get_ids())
+        keys.emplace_back(id.data(), id.size());
+
+    auto statuses = fill_statuses<string_statuses_t>(state, keys);
+
+    size_t idx = 0;
+    for (auto _: state)
+        benchmark::DoNotOptimize(statuses.find(keys[idx++ % keys.size()]));
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief The same lookups in the compact container, paying for the ids parsing as well
+static void BM_statuses_compact_ids(benchmark::State &state)
+{
+    const auto &ids = get_ids();
+
+    std::vector<spotify_id_t> keys;
+    for (const auto &id: ids)
+        keys.emplace_back(id);
+
+    auto statuses = fill_statuses<compact_statuses_t>(state, keys);
+
+    size_t idx = 0;
+    for (auto _: state)
+        benchmark::DoNotOptimize(statuses.find(spotify_id_t(ids[idx++ % ids.size()])));
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief The lookups with the ids parsed already, the way the container's own code does
+/// while resyncing and updating the statuses
+static void BM_statuses_compact_ids_parsed(benchmark::State &state)
+{
+    std::vector<spotify_id_t> keys;
+    for (const auto &id: get_ids())
+        keys.emplace_back(id);
+
+    auto statuses = fill_statuses<compact_statuses_t>(state, keys);
+
+    size_t idx = 0;
+    for (auto _: state)
+        benchmark::DoNotOptimize(statuses.find(keys[idx++ % keys.size()]));
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_statuses_string_ids);
+BENCHMARK(BM_statuses_compact_ids);
+BENCHMARK(BM_statuses_compact_ids_parsed);
@@ -0,0 +1,504 @@
+#include <benchmark/benchmark.h>
+#include "utils.hpp"
+
+using namespace spotifar;
+using namespace spotifar::utils;
+
+/// @brief Light stand-ins for the plugin's items, with the same hierarchy and the same fields,
+/// so the benchmark does not depend on the plugin's items implementation. Every item is read
+/// two ways: the hand-written one, the way the items were read before, looking up each field
+/// by its name and reading the base via `dynamic_cast`; and with the fields schema
+namespace bench_items
+{
+    struct artist_t
+    {
+        string id;
+        wstring name;
+        string url;
+    };
+
+    struct image_t
+    {
+        string url;
+        size_t width = 0, height = 0;
+    };
+
+    struct album_t
+    {
+        string id;
+        wstring name;
+        size_t total_tracks = 0;
+        string album_type, release_date, href, url;
+        std::vector<image_t> images;
+        std::vector<artist_t> artists;
+    };
+
+    struct simplified_track_t
+    {
+        string id;
+        wstring name;
+        int duration_ms = 0, duration = 0;
+        size_t disc_number = 0, track_number = 0;
+        bool is_explicit = false;
+        std::vector<artist_t> artists;
+        string url;
+
+        virtual ~simplified_track_t() = default;
+    };
+
+    struct track_t: public simplified_track_t
+    {
+        album_t album;
+        size_t popularity = 0;
+    };
+
+    struct saved_track_t: public track_t
+    {
+        string added_at;
+    };
+
+    struct device_t
+    {
+        string id, type;
+        wstring name;
+        bool is_active = false, supports_volume = false, is_private_session = false, is_restricted = false;
+        int volume_percent = 100;
+    };
+
+    struct context_t
+    {
+        string type, uri, href;
+    };
+
+    struct playback_state_t
+    {
+        device_t device;
+        string repeat_state;
+        bool shuffle_state = false, is_playing = false;
+        int progress_ms = 0, progress = 0;
+        track_t item;
+        context_t context;
+    };
+
+    // the hand-written readers
+    //-------------------------------------------------------------------------------------
+
+    template<class T>
+    static void read_array(const json::Value &j, std::vector<T> &result)
+    {
+        result.resize(j.Size());
+        for (json::SizeType i = 0; i < j.Size(); i++)
+            if (!j[i].IsNull())
+                read(j[i], result[i]);
+    }
+
+    static void read(const json::Value &j, artist_t &a)
+    {
+        a.id = j["id"].GetString();
+        a.name = utf8_decode(j["name"].GetString());
+        a.url = j["external_urls"]["spotify"].GetString();
+    }
+
+    static void read(const json::Value &j, image_t &i)
+    {
+        i.url = j["url"].GetString();
+        i.width = j["width"].GetUint();
+        i.height = j["height"].GetUint();
+    }
+
+    static void read(const json::Value &j, album_t &a)
+    {
+        a.id = j["id"].GetString();
+        a.name = utf8_decode(j["name"].GetString());
+        a.total_tracks = j["total_tracks"].GetUint();
+        a.album_type = j["album_type"].GetString();
+        a.release_date = j["release_date"].GetString();
+
+        if (j.HasMember("release_date_precision"))
+        {
+            string precision = j["release_date_precision"].GetString();
+            if (precision == "year")
+                a.release_date = format("{}-01-01", a.release_date);
+            else if (precision == "month")
+                a.release_date = format("{}-01", a.release_date);
+        }
+
+        a.href = j["href"].GetString();
+        a.url = j["external_urls"]["spotify"].GetString();
+
+        read_array(j["images"], a.images);
+        read_array(j["artists"], a.artists);
+    }
+
+    static void read(const json::Value &j, simplified_track_t &t)
+    {
+        t.id = j["id"].GetString();
+        t.track_number = j["track_number"].GetUint();
+        t.disc_number = j["disc_number"].GetUint();
+        t.duration_ms = j["duration_ms"].GetInt();
+        t.is_explicit = j["explicit"].GetBool();
+        t.duration = t.duration_ms / 1000;
+        t.name = utf8_decode(j["name"].GetString());
+        t.url = j["external_urls"]["spotify"].GetString();
+
+        read_array(j["artists"], t.artists);
+    }
+
+    static void read(const json::Value &j, track_t &t)
+    {
+        read(j, dynamic_cast<simplified_track_t&>(t));
+        read(j["album"], t.album);
+        t.popularity = j["popularity"].GetUint();
+    }
+
+    static void read(const json::Value &j, saved_track_t &t)
+    {
+        read(j["track"], dynamic_cast<track_t&>(t));
+        t.added_at = j["added_at"].GetString();
+    }
+
+    static void read(const json::Value &j, device_t &d)
+    {
+        d.id = j["id"].GetString();
+        d.is_active = j["is_active"].GetBool();
+        d.type = j["type"].GetString();
+        d.supports_volume = j["supports_volume"].GetBool();
+        d.is_private_session = j["is_private_session"].GetBool();
+        d.is_restricted = j["is_restricted"].GetBool();
+        d.name = utf8_decode(j["name"].GetString());
+        d.volume_percent = j.HasMember("volume_percent") ? j["volume_percent"].GetInt() : 0;
+    }
+
+    static void read(const json::Value &j, context_t &c)
+    {
+        c.type = j["type"].GetString();
+        c.uri = j["uri"].GetString();
+        c.href = j["href"].GetString();
+    }
+
+    static void read(const json::Value &j, playback_state_t &p)
+    {
+        read(j["device"], p.device);
+
+        if (j.HasMember("context") && !j["context"].IsNull())
+            read(j["context"], p.context);
+
+        if (j.HasMember("item") && !j["item"].IsNull())
+            read(j["item"], p.item);
+
+        p.progress_ms = j.HasMember("progress_ms") ? j["progress_ms"].GetInt() : 0;
+        p.progress = p.progress_ms / 1000;
+
+        p.repeat_state = j["repeat_state"].GetString();
+        p.shuffle_state = j["shuffle_state"].GetBool();
+        p.is_playing = j["is_playing"].GetBool();
+    }
+
+    // the schema readers
+    //-------------------------------------------------------------------------------------
+
+    static constexpr auto artist_fields = std::tuple{
+        json::schema::field("id", &artist_t::id),
+        json::schema::field("name", &artist_t::name),
+        json::schema::object("external_urls", std::tuple{
+            json::schema::field("spotify", &artist_t::url),
+        }),
+    };
+
+    static constexpr auto image_fields = std::tuple{
+        json::schema::field("url", &image_t::url),
+        json::schema::field("width", &image_t::width),
+        json::schema::field("height", &image_t::height),
+    };
+
+    static constexpr auto album_fields = std::tuple{
+        json::schema::field("id", &album_t::id),
+        json::schema::field("name", &album_t::name),
+        json::schema::field("total_tracks", &album_t::total_tracks),
+        json::schema::field("album_type", &album_t::album_type),
+        json::schema::field("release_date", &album_t::release_date),
+        json::schema::field("href", &album_t::href),
+        json::schema::field("images", &album_t::images),
+        json::schema::field("artists", &album_t::artists),
+        json::schema::object("external_urls", std::tuple{
+            json::schema::field("spotify", &album_t::url),
+        }),
+        json::schema::then(+[](album_t &a)
+        {
+            if (a.release_date.size() == 4)
+                a.release_date += "-01-01";
+            else if (a.release_date.size() == 7)
+                a.release_date += "-01";
+        }),
+    };
+
+    static constexpr auto simplified_track_fields = std::tuple{
+        json::schema::field("id", &simplified_track_t::id),
+        json::schema::field("name", &simplified_track_t::name),
+        json::schema::field("duration_ms", &simplified_track_t::duration_ms),
+        json::schema::field("track_number", &simplified_track_t::track_number),
+        json::schema::field("disc_number", &simplified_track_t::disc_number),
+        json::schema::field("explicit", &simplified_track_t::is_explicit),
+        json::schema::field("artists", &simplified_track_t::artists),
+        json::schema::object("external_urls", std::tuple{
+            json::schema::field("spotify", &simplified_track_t::url),
+        }),
+        json::schema::then(+[](simplified_track_t &t) { t.duration = t.duration_ms / 1000; }),
+    };
+
+    static constexpr auto track_fields = std::tuple_cat(simplified_track_fields, std::tuple{
+        json::schema::field("album", &track_t::album),
+        json::schema::field("popularity", &track_t::popularity),
+    });
+
+    static constexpr auto saved_track_fields = std::tuple{
+        json::schema::field("added_at", &saved_track_t::added_at),
+        json::schema::object("track", track_fields),
+    };
+
+    static constexpr auto device_fields = std::tuple{
+        json::schema::field("id", &device_t::id),
+        json::schema::field("name", &device_t::name),
+        json::schema::field("is_active", &device_t::is_active),
+        json::schema::field("type", &device_t::type),
+        json::schema::field("volume_percent", &device_t::volume_percent, json::schema::optional),
+        json::schema::field("supports_volume", &device_t::supports_volume),
+        json::schema::field("is_private_session", &device_t::is_private_session),
+        json::schema::field("is_restricted", &device_t::is_restricted),
+    };
+
+    static constexpr auto context_fields = std::tuple{
+        json::schema::field("type", &context_t::type),
+        json::schema::field("uri", &context_t::uri),
+        json::schema::field("href", &context_t::href),
+    };
+
+    static constexpr auto playback_state_fields = std::tuple{
+        json::schema::field("repeat_state", &playback_state_t::repeat_state),
+        json::schema::field("shuffle_state", &playback_state_t::shuffle_state),
+        json::schema::field("progress_ms", &playback_state_t::progress_ms, json::schema::optional),
+        json::schema::field("is_playing", &playback_state_t::is_playing),
+        json::schema::field("device", &playback_state_t::device),
+        json::schema::field("item", &playback_state_t::item, json::schema::optional | json::schema::nullable),
+        json::schema::field("context", &playback_state_t::context, json::schema::optional | json::schema::nullable),
+        json::schema::then(+[](playback_state_t &p) { p.progress = p.progress_ms / 1000; }),
+    };
+
+    static void from_json(const json::Value &j, artist_t &a) { json::schema::read(j, a, artist_fields); }
+    static void from_json(const json::Value &j, image_t &i) { json::schema::read(j, i, image_fields); }
+    static void from_json(const json::Value &j, album_t &a) { json::schema::read(j, a, album_fields); }
+    static void from_json(const json::Value &j, track_t &t) { json::schema::read(j, t, track_fields); }
+    static void from_json(const json::Value &j, saved_track_t &t) { json::schema::read(j, t, saved_track_fields); }
+    static void from_json(const json::Value &j, device_t &d) { json::schema::read(j, d, device_fields); }
+    static void from_json(const json::Value &j, context_t &c) { json::schema::read(j, c, context_fields); }
+    static void from_json(const json::Value &j, playback_state_t &p) { json::schema::read(j, p, playback_state_fields); }
+}
+
+/// @brief Writes a full track object, as the API returns it, with the fields the plugin skips
+static void write_track(json::Writer<StringBuffer> &w, size_t idx)
+{
+    auto track_id = format("{:022}", idx), album_id = format("{:022}", idx + 1000);
+
+    auto write_urls = [&w](const string &url)
+    {
+        w.Key("external_urls"); w.StartObject();
+        w.Key("spotify"); w.String(url);
+        w.EndObject();
+    };
+
+    auto write_artists = [&w, &write_urls, idx]
+    {
+        w.Key("artists"); w.StartArray();
+        for (size_t a = 0; a < 2; ++a)
+        {
+            auto id = format("{:022}", idx * 10 + a);
+            w.StartObject();
+            write_urls(format("https://open.spotify.com/artist/{}", id));
+            w.Key("href"); w.String(format("https://api.spotify.com/v1/artists/{}", id));
+            w.Key("id"); w.String(id);
+            w.Key("name"); w.String(format("Artist name {}", a));
+            w.Key("type"); w.String("artist");
+            w.Key("uri"); w.String(format("spotify:artist:{}", id));
+            w.EndObject();
+        }
+        w.EndArray();
+    };
+
+    auto write_markets = [&w]
+    {
+        w.Key("available_markets"); w.StartArray();
+        for (const char *m: { "AD", "AE", "AG", "AL", "AM", "AO", "AR", "AT", "AU", "AZ", "BA", "BB" })
+            w.String(m);
+        w.EndArray();
+    };
+
+    w.StartObject();
+    w.Key("album"); w.StartObject();
+    {
+        w.Key("album_type"); w.String("album");
+        write_artists();
+        write_markets();
+        write_urls(format("https://open.spotify.com/album/{}", album_id));
+        w.Key("href"); w.String(format("https://api.spotify.com/v1/albums/{}", album_id));
+        w.Key("id"); w.String(album_id);
+        w.Key("images"); w.StartArray();
+        for (unsigned size: { 640, 300, 64 })
+        {
+            w.StartObject();
+            w.Key("height"); w.Uint(size);
+            w.Key("url"); w.String("https://i.scdn.co/image/ab67616d0000b2732c5b24ecfa39523a75c993c4");
+            w.Key("width"); w.Uint(size);
+            w.EndObject();
+        }
+        w.EndArray();
+        w.Key("name"); w.String(format("Some long enough album name #{}", idx));
+        w.Key("release_date"); w.String("2016-09");
+        w.Key("release_date_precision"); w.String("month");
+        w.Key("total_tracks"); w.Uint(12);
+        w.Key("type"); w.String("album");
+        w.Key("uri"); w.String(format("spotify:album:{}", album_id));
+    }
+    w.EndObject();
+    write_artists();
+    write_markets();
+    w.Key("disc_number"); w.Uint(1);
+    w.Key("duration_ms"); w.Uint(215000 + (unsigned)idx);
+    w.Key("explicit"); w.Bool(false);
+    w.Key("external_ids"); w.StartObject();
+    w.Key("isrc"); w.String("USUM71612345");
+    w.EndObject();
+    write_urls(format("https://open.spotify.com/track/{}", track_id));
+    w.Key("href"); w.String(format("https://api.spotify.com/v1/tracks/{}", track_id));
+    w.Key("id"); w.String(track_id);
+    w.Key("is_local"); w.Bool(false);
+    w.Key("name"); w.String(format("Track name #{}", idx));
+    w.Key("popularity"); w.Uint(54);
+    w.Key("preview_url"); w.Null();
+    w.Key("track_number"); w.Uint((unsigned)idx % 12 + 1);
+    w.Key("type"); w.String("track");
+    w.Key("uri"); w.String(format("spotify:track:{}", track_id));
+    w.EndObject();
+}
+
+/// @brief An array of the saved tracks, the way they come in the `/v1/me/tracks` pages
+static auto make_saved_tracks(size_t items_count) -> string
+{
+    StringBuffer sb;
+    json::Writer<StringBuffer> w(sb);
+
+    w.StartArray();
+    for (size_t idx = 0; idx < items_count; ++idx)
+    {
+        w.StartObject();
+        w.Key("added_at"); w.String("2024-11-03T12:09:41Z");
+        w.Key("track"); write_track(w, idx);
+        w.EndObject();
+    }
+    w.EndArray();
+
+    return sb.GetString();
+}
+
+/// @brief An array of the `/v1/me/player` responses, the way the player polls them
+static auto make_playback_states(size_t items_count) -> string
+{
+    StringBuffer sb;
+    json::Writer<StringBuffer> w(sb);
+
+    w.StartArray();
+    for (size_t idx = 0; idx < items_count; ++idx)
+    {
+        w.StartObject();
+        w.Key("device"); w.StartObject();
+        {
+            w.Key("id"); w.String("ed01a3ca8def0a1772eab7be6c4b0bb37b06163e");
+            w.Key("is_active"); w.Bool(true);
+            w.Key("is_private_session"); w.Bool(false);
+            w.Key("is_restricted"); w.Bool(false);
+            w.Key("name"); w.String("Living Room Speaker");
+            w.Key("supports_volume"); w.Bool(true);
+            w.Key("type"); w.String("Computer");
+            w.Key("volume_percent"); w.Uint(59);
+        }
+        w.EndObject();
+        w.Key("shuffle_state"); w.Bool(false);
+        w.Key("smart_shuffle"); w.Bool(false);
+        w.Key("repeat_state"); w.String("off");
+        w.Key("timestamp"); w.Uint64(1731245236000 + idx);
+        w.Key("context"); w.StartObject();
+        {
+            w.Key("external_urls"); w.StartObject();
+            w.Key("spotify"); w.String("https://open.spotify.com/collection/tracks");
+            w.EndObject();
+            w.Key("href"); w.String("https://api.spotify.com/v1/me/tracks");
+            w.Key("type"); w.String("collection");
+            w.Key("uri"); w.String("spotify:user:someone:collection");
+        }
+        w.EndObject();
+        w.Key("progress_ms"); w.Uint(61000 + (unsigned)idx);
+        w.Key("item"); write_track(w, idx);
+        w.Key("currently_playing_type"); w.String("track");
+        w.Key("actions"); w.StartObject();
+        {
+            w.Key("disallows"); w.StartObject();
+            w.Key("resuming"); w.Bool(true);
+            w.EndObject();
+        }
+        w.EndObject();
+        w.Key("is_playing"); w.Bool(true);
+        w.EndObject();
+    }
+    w.EndArray();
+
+    return sb.GetString();
+}
+
+/// @brief The amount of the items in the array, a page of the saved tracks
+static const size_t items_count = 50;
+
+template<class T, bool is_schema>
+static void read_items(benchmark::State &state, const string &data)
+{
+    json::Document doc;
+    doc.Parse(data);
+
+    for (auto _: state)
+    {
+        std::vector<T> items(doc.Size());
+        for (json::SizeType i = 0; i < doc.Size(); ++i)
+        {
+            if constexpr (is_schema)
+                from_json(doc[i], items[i]);
+            else
+                read(doc[i], items[i]);
+        }
+        benchmark::DoNotOptimize(items.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * doc.Size());
+}
+
+static void BM_saved_tracks_handwritten(benchmark::State &state)
+{
+    read_items<bench_items::saved_track_t, false>(state, make_saved_tracks(items_count));
+}
+
+static void BM_saved_tracks_schema(benchmark::State &state)
+{
+    read_items<bench_items::saved_track_t, true>(state, make_saved_tracks(items_count));
+}
+
+static void BM_playback_states_handwritten(benchmark::State &state)
+{
+    read_items<bench_items::playback_state_t, false>(state, make_playback_states(items_count));
+}
+
+static void BM_playback_states_schema(benchmark::State &state)
+{
+    read_items<bench_items::playback_state_t, true>(state, make_playback_states(items_count));
+}
+
+BENCHMARK(BM_saved_tracks_handwritten);
+BENCHMARK(BM_saved_tracks_schema);
+BENCHMARK(BM_playback_states_handwritten);
+BENCHMARK(BM_playback_states_schema);
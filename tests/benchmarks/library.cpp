@@ -0,0 +1,370 @@
+#include <benchmark/benchmark.h>
+#include "spotify/ids.hpp"
+#include "spotify/columns.hpp"
+#include "spotify/items_pool.hpp"
+#include "allocations.hpp"
+
+using namespace spotifar;
+using namespace spotifar::utils;
+using namespace spotifar::spotify;
+
+/// @brief The amount of the tracks in the synthetic saved library
+static const size_t tracks_count = 20000;
+
+/// @brief The library is made of full-length albums by the artists with several albums each
+static const size_t album_tracks_count = 12, artist_albums_count = 3;
+
+/// @brief Light stand-ins for the library's tracks with the counted strings and vectors: the
+/// same track is kept two ways, with its album and artists embedded as copies, and with the
+/// references to the records shared through the interning pool, the way `track_t` is read now
+namespace bench_library
+{
+    struct artist_t
+    {
+        counted_string id;
+        counted_wstring name;
+        counted_string url;
+    };
+
+    struct image_t
+    {
+        counted_string url;
+        size_t width = 0, height = 0;
+    };
+
+    struct album_t
+    {
+        counted_string id;
+        counted_wstring name;
+        size_t total_tracks = 0;
+        counted_string album_type, release_date, href, url;
+        counted_vector<image_t> images;
+        counted_vector<artist_t> artists;
+    };
+
+    struct track_base_t
+    {
+        counted_string id, added_at, url;
+        counted_wstring name;
+        int duration_ms = 0;
+        size_t disc_number = 0, track_number = 0, popularity = 0;
+    };
+
+    struct embedded_track_t: public track_base_t
+    {
+        counted_vector<artist_t> artists;
+        album_t album;
+    };
+
+    template<class T>
+    using shared_t = std::shared_ptr<const T>;
+
+    struct pooled_track_t: public track_base_t
+    {
+        counted_vector<shared_t<artist_t>> artists;
+        shared_t<album_t> album;
+
+        auto get_artist() const -> artist_t { return artists.size() > 0 ? *artists[0] : artist_t{}; }
+    };
+
+    /// @brief The same content checks the plugin makes for its records, the pool calls them
+    /// before sharing a record read again
+    static bool is_same(const image_t &lhs, const image_t &rhs)
+    {
+        return lhs.url == rhs.url && lhs.width == rhs.width && lhs.height == rhs.height;
+    }
+
+    static bool is_same(const artist_t &lhs, const artist_t &rhs)
+    {
+        return lhs.id == rhs.id && lhs.name == rhs.name && lhs.url == rhs.url;
+    }
+
+    static bool is_same(const album_t &lhs, const album_t &rhs)
+    {
+        auto is_same_item = [](const auto &l, const auto &r) { return is_same(l, r); };
+
+        return lhs.id == rhs.id && lhs.name == rhs.name && lhs.total_tracks == rhs.total_tracks &&
+            lhs.album_type == rhs.album_type && lhs.release_date == rhs.release_date &&
+            lhs.href == rhs.href && lhs.url == rhs.url &&
+            std::ranges::equal(lhs.images, rhs.images, is_same_item) &&
+            std::ranges::equal(lhs.artists, rhs.artists, is_same_item);
+    }
+
+    /// @brief The plugin's pool itself, the records and the pool's nodes are allocated with
+    /// the counting allocator, so the memory they take is reported as well
+    template<class T>
+    using pool_t = items_pool_t<T, counting_allocator<T>>;
+
+    template<class S>
+    static auto make_string(const string &s) -> S
+    {
+        return S(s.begin(), s.end());
+    }
+
+    static auto make_artist(size_t idx) -> artist_t
+    {
+        auto id = format("{:022}", idx + 1);
+        return {
+            make_string<counted_string>(id),
+            make_string<counted_wstring>(format("Artist name {}", idx)),
+            make_string<counted_string>(format("https://open.spotify.com/artist/{}", id)),
+        };
+    }
+
+    /// @brief Builds the album, as a page of the saved tracks has it for every track
+    static auto make_album(size_t idx) -> album_t
+    {
+        auto id = format("{:022}", idx + 1);
+
+        album_t album{
+            make_string<counted_string>(id),
+            make_string<counted_wstring>(format("Some long enough album name #{}", idx)),
+            album_tracks_count,
+            make_string<counted_string>("album"),
+            make_string<counted_string>("2001-05-14"),
+            make_string<counted_string>(format("https://api.spotify.com/v1/albums/{}", id)),
+            make_string<counted_string>(format("https://open.spotify.com/album/{}", id)),
+        };
+
+        for (size_t size: { 640, 300, 64 })
+            album.images.push_back({ make_string<counted_string>(
+                format("https://i.scdn.co/image/ab67616d0000b273{:024x}{}", idx, size)), size, size });
+
+        album.artists.push_back(make_artist(idx / artist_albums_count));
+        return album;
+    }
+
+    static void fill_track(track_base_t &t, size_t idx)
+    {
+        auto id = format("{:022}", idx + 1);
+
+        t.id = make_string<counted_string>(id);
+        t.added_at = make_string<counted_string>("2024-02-11T19:24:51Z");
+        t.url = make_string<counted_string>(format("https://open.spotify.com/track/{}", id));
+        t.name = make_string<counted_wstring>(format("Track name #{}", idx));
+        t.duration_ms = 120000 + (int)(idx * 7919 % 240000);
+        t.popularity = idx * 31 % 101;
+        t.track_number = idx % album_tracks_count + 1;
+    }
+}
+
+/// @brief Builds the library the way reading it does: every track comes with its own album
+/// and artists read, the pooled one interns them right away
+template<class T>
+static auto build_library(bench_library::pool_t<bench_library::album_t> *albums,
+    bench_library::pool_t<bench_library::artist_t> *artists, size_t count = tracks_count) -> counted_vector<T>
+{
+    using namespace bench_library;
+
+    counted_vector<T> tracks(count);
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        auto &t = tracks[idx];
+        fill_track(t, idx);
+
+        const auto album_idx = idx / album_tracks_count;
+        if constexpr (std::is_same_v<T, pooled_track_t>)
+        {
+            t.album = albums->intern(make_album(album_idx));
+            t.artists.push_back(artists->intern(make_artist(album_idx / artist_albums_count)));
+        }
+        else
+        {
+            t.album = make_album(album_idx);
+            t.artists.push_back(make_artist(album_idx / artist_albums_count));
+        }
+    }
+    return tracks;
+}
+
+/// @brief Reports the memory the whole library takes per track, together with the pools
+template<class T>
+static void BM_library_memory(benchmark::State &state)
+{
+    size_t bytes = 0;
+    for (auto _: state)
+    {
+        const auto before = allocated_bytes;
+        {
+            bench_library::pool_t<bench_library::album_t> albums;
+            bench_library::pool_t<bench_library::artist_t> artists;
+
+            auto tracks = build_library<T>(&albums, &artists);
+            bytes = allocated_bytes - before;
+
+            benchmark::DoNotOptimize(tracks.data());
+        }
+    }
+
+    state.counters["bytes_per_track"] = (double)bytes / tracks_count;
+    state.counters["library_mb"] = (double)bytes / (1024 * 1024);
+    state.SetItemsProcessed(state.iterations() * tracks_count);
+}
+
+BENCHMARK(BM_library_memory<bench_library::embedded_track_t>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_library_memory<bench_library::pooled_track_t>)->Unit(benchmark::kMillisecond);
+
+using columns_t = tracks_columns_t<bench_library::pooled_track_t>;
+
+/// @brief The amount of the tracks in the sorted list, a very big saved collection
+static const size_t sorted_tracks_count = 50000;
+
+static const char *get_column_name(columns_t::column_t column)
+{
+    static const char *names[] = { "artist", "album", "release_date", "duration", "popularity" };
+    return names[column];
+}
+
+/// @brief Returns the library's tracks in the collection's order, the way the view lists them
+static auto get_sorted_library() -> const std::vector<const bench_library::pooled_track_t*>&
+{
+    using namespace bench_library;
+
+    static pool_t<album_t> albums;
+    static pool_t<artist_t> artists;
+    static const auto tracks = build_library<pooled_track_t>(&albums, &artists, sorted_tracks_count);
+
+    static const auto rows = []
+    {
+        std::vector<const pooled_track_t*> rows;
+        for (const auto &t: tracks)
+            rows.push_back(&t);
+        return rows;
+    }();
+    return rows;
+}
+
+/// @brief The same tracks shuffled, the way the panel has them before sorting
+static auto get_shuffled_library() -> const std::vector<const bench_library::pooled_track_t*>&
+{
+    static const auto shuffled = []
+    {
+        auto shuffled = get_sorted_library();
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+        return shuffled;
+    }();
+    return shuffled;
+}
+
+/// @brief The previous comparison, the same way `tracks_base_view::compare_items` compared
+/// the tracks' fields
+static int compare_fields(columns_t::column_t column, const bench_library::pooled_track_t *t1,
+    const bench_library::pooled_track_t *t2)
+{
+    switch (column)
+    {
+        case columns_t::artist: return t1->get_artist().name.compare(t2->get_artist().name);
+        case columns_t::album: return t1->album->name.compare(t2->album->name);
+        case columns_t::release_date: return t1->album->release_date.compare(t2->album->release_date);
+        case columns_t::duration:
+            return t1->duration_ms == t2->duration_ms ? 0 : t1->duration_ms < t2->duration_ms ? -1 : 1;
+        case columns_t::popularity:
+            return t1->popularity == t2->popularity ? 0 : t1->popularity < t2->popularity ? -1 : 1;
+        case columns_t::columns_count:
+            break;
+    }
+    return 0;
+}
+
+/// @brief Sorting the list comparing the tracks' fields
+static void BM_sort_tracks_fields(benchmark::State &state)
+{
+    const auto column = (columns_t::column_t)state.range(0);
+    const auto &library = get_shuffled_library();
+
+    for (auto _: state)
+    {
+        auto tracks = library;
+        std::sort(tracks.begin(), tracks.end(),
+            [column](auto *t1, auto *t2) { return compare_fields(column, t1, t2) < 0; });
+
+        benchmark::DoNotOptimize(tracks.data());
+    }
+
+    state.SetLabel(get_column_name(column));
+    state.SetItemsProcessed(state.iterations() * library.size());
+}
+
+/// @brief Sorting the same list with the columns, the store and its column are built every
+/// time, the way the view rebuilds them with the list
+static void BM_sort_tracks_columns(benchmark::State &state)
+{
+    const auto column = (columns_t::column_t)state.range(0);
+    const auto &library = get_shuffled_library();
+
+    for (auto _: state)
+    {
+        auto tracks = library;
+        columns_t columns(get_sorted_library());
+        std::sort(tracks.begin(), tracks.end(),
+            [column, &columns](auto *t1, auto *t2) { return columns.compare(column, t1, t2) < 0; });
+
+        benchmark::DoNotOptimize(tracks.data());
+    }
+
+    state.SetLabel(get_column_name(column));
+    state.SetItemsProcessed(state.iterations() * library.size());
+}
+
+BENCHMARK(BM_sort_tracks_fields)->DenseRange(0, columns_t::columns_count - 1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_sort_tracks_columns)->DenseRange(0, columns_t::columns_count - 1)->Unit(benchmark::kMillisecond);
+
+/// @brief The amount of the tracks in the opened playlist, their saving statuses are unknown
+static const size_t playlist_tracks_count = 2000;
+
+/// @brief The panel asks for all the statuses on every redraw, while the queue is being checked
+static const size_t playlist_redraws_count = 10;
+
+static auto get_playlist_ids() -> const item_ids_t&
+{
+    static const auto ids = []
+    {
+        item_ids_t ids;
+        for (size_t idx = 0; idx < playlist_tracks_count; ++idx)
+            ids.push_back(format("{:022}", idx + 1));
+        return ids;
+    }();
+    return ids;
+}
+
+/// @brief Queueing the unknown statuses the previous way, deduplicated by a linear search
+static void BM_saved_queue_vector(benchmark::State &state)
+{
+    const auto &ids = get_playlist_ids();
+
+    for (auto _: state)
+    {
+        item_ids_t ids_to_process;
+        for (size_t redraw = 0; redraw < playlist_redraws_count; ++redraw)
+            for (const auto &id: ids)
+                if (std::find(ids_to_process.begin(), ids_to_process.end(), id) == ids_to_process.end())
+                    ids_to_process.push_back(id);
+
+        benchmark::DoNotOptimize(ids_to_process.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * ids.size() * playlist_redraws_count);
+}
+
+/// @brief The same with the queue and the pending ids, the way `saved_items_cache_t` keeps them
+static void BM_saved_queue_pending(benchmark::State &state)
+{
+    const auto &ids = get_playlist_ids();
+
+    for (auto _: state)
+    {
+        std::deque<item_id_t> ids_to_process;
+        std::unordered_map<spotify_id_t, utils::clock_t::time_point> pending_ids;
+        for (size_t redraw = 0; redraw < playlist_redraws_count; ++redraw)
+            for (const auto &id: ids)
+                if (pending_ids.emplace(spotify_id_t(id), utils::clock_t::now()).second)
+                    ids_to_process.push_back(id);
+
+        benchmark::DoNotOptimize(ids_to_process.size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * ids.size() * playlist_redraws_count);
+}
+
+BENCHMARK(BM_saved_queue_vector)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_saved_queue_pending)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,413 @@
+#include <benchmark/benchmark.h>
+#include "utils.hpp"
+#include "spotify/transport.hpp"
+#include "allocations.hpp"
+
+using namespace spotifar;
+using namespace spotifar::utils;
+
+/// @brief A light stand-in for the `saved_track_t` item, reading the same set of the most
+/// used fields, so the benchmark does not depend on the plugin's items implementation
+struct bench_track_t
+{
+    string id, name, added_at, album_id, album_name;
+    std::vector<string> artists;
+    size_t duration_ms = 0;
+};
+
+static void from_json(const json::Value &j, bench_track_t &t)
+{
+    const auto &track = j["track"];
+
+    t.added_at = j["added_at"].GetString();
+    t.id = track["id"].GetString();
+    t.name = track["name"].GetString();
+    t.duration_ms = track["duration_ms"].GetUint();
+    t.album_id = track["album"]["id"].GetString();
+    t.album_name = track["album"]["name"].GetString();
+
+    for (const auto &artist: track["artists"].GetArray())
+        t.artists.push_back(artist["name"].GetString());
+}
+
+/// @brief Builds a page of `/v1/me/tracks` response with the given amount of items, with
+/// the same structure and the similar fields sizes as the real ones have: the album, artists,
+/// images and the long lists of the available markets
+static string make_saved_tracks_page(size_t items_count)
+{
+    static const std::vector<string> markets = {
+        "AD", "AE", "AG", "AL", "AM", "AO", "AR", "AT", "AU", "AZ", "BA", "BB", "BD", "BE", "BF",
+        "BG", "BH", "BI", "BJ", "BN", "BO", "BR", "BS", "BT", "BW", "BY", "BZ", "CA", "CD", "CG",
+        "CH", "CI", "CL", "CM", "CO", "CR", "CV", "CW", "CY", "CZ", "DE", "DJ", "DK", "DM", "DO",
+        "DZ", "EC", "EE", "EG", "ES", "ET", "FI", "FJ", "FM", "FR", "GA", "GB", "GD", "GE", "GH",
+        "GM", "GN", "GQ", "GR", "GT", "GW", "GY", "HK", "HN", "HR", "HT", "HU", "ID", "IE", "IL",
+        "IN", "IQ", "IS", "IT", "JM", "JO", "JP", "KE", "KG", "KH", "KI", "KM", "KN", "KR", "KW",
+    };
+
+    StringBuffer sb;
+    json::Writer<StringBuffer> w(sb);
+
+    auto write_images = [&w]
+    {
+        w.Key("images");
+        w.StartArray();
+        for (int size: { 640, 300, 64 })
+        {
+            w.StartObject();
+            w.Key("url"); w.String("https://i.scdn.co/image/ab67616d0000b2732c5b24ecfa39523a75c993c4");
+            w.Key("height"); w.Uint(size);
+            w.Key("width"); w.Uint(size);
+            w.EndObject();
+        }
+        w.EndArray();
+    };
+
+    auto write_artists = [&w](size_t idx)
+    {
+        w.Key("artists");
+        w.StartArray();
+        for (size_t a = 0; a < 2; ++a)
+        {
+            auto id = format("{:022}", idx * 10 + a);
+            w.StartObject();
+            w.Key("external_urls"); w.StartObject();
+            w.Key("spotify"); w.String(format("https://open.spotify.com/artist/{}", id));
+            w.EndObject();
+            w.Key("href"); w.String(format("https://api.spotify.com/v1/artists/{}", id));
+            w.Key("id"); w.String(id);
+            w.Key("name"); w.String(format("Artist name {}", a));
+            w.Key("type"); w.String("artist");
+            w.Key("uri"); w.String(format("spotify:artist:{}", id));
+            w.EndObject();
+        }
+        w.EndArray();
+    };
+
+    auto write_markets = [&w]
+    {
+        w.Key("available_markets");
+        w.StartArray();
+        for (const auto &m: markets)
+            w.String(m);
+        w.EndArray();
+    };
+
+    w.StartObject();
+    w.Key("href"); w.String("https://api.spotify.com/v1/me/tracks?offset=0&limit=50");
+    w.Key("items");
+    w.StartArray();
+    for (size_t idx = 0; idx < items_count; ++idx)
+    {
+        auto track_id = format("{:022}", idx), album_id = format("{:022}", idx + 1000);
+
+        w.StartObject();
+        w.Key("added_at"); w.String("2024-11-03T12:09:41Z");
+        w.Key("track"); w.StartObject();
+        {
+            w.Key("album"); w.StartObject();
+            {
+                w.Key("album_type"); w.String("album");
+                write_artists(idx);
+                write_markets();
+                w.Key("href"); w.String(format("https://api.spotify.com/v1/albums/{}", album_id));
+                w.Key("id"); w.String(album_id);
+                write_images();
+                w.Key("name"); w.String(format("Some long enough album name #{}", idx));
+                w.Key("release_date"); w.String("2016-09-23");
+                w.Key("release_date_precision"); w.String("day");
+                w.Key("total_tracks"); w.Uint(12);
+                w.Key("type"); w.String("album");
+                w.Key("uri"); w.String(format("spotify:album:{}", album_id));
+            }
+            w.EndObject();
+            write_artists(idx);
+            write_markets();
+            w.Key("disc_number"); w.Uint(1);
+            w.Key("duration_ms"); w.Uint(215000 + (unsigned)idx);
+            w.Key("explicit"); w.Bool(false);
+            w.Key("external_ids"); w.StartObject();
+            w.Key("isrc"); w.String("USUM71612345");
+            w.EndObject();
+            w.Key("href"); w.String(format("https://api.spotify.com/v1/tracks/{}", track_id));
+            w.Key("id"); w.String(track_id);
+            w.Key("is_local"); w.Bool(false);
+            w.Key("name"); w.String(format("Track name #{}", idx));
+            w.Key("popularity"); w.Uint(54);
+            w.Key("preview_url"); w.Null();
+            w.Key("track_number"); w.Uint((unsigned)idx % 12 + 1);
+            w.Key("type"); w.String("track");
+            w.Key("uri"); w.String(format("spotify:track:{}", track_id));
+        }
+        w.EndObject();
+        w.EndObject();
+    }
+    w.EndArray();
+    w.Key("limit"); w.Uint(50);
+    w.Key("next"); w.String("https://api.spotify.com/v1/me/tracks?offset=50&limit=50");
+    w.Key("offset"); w.Uint(0);
+    w.Key("previous"); w.Null();
+    w.Key("total"); w.Uint(1234);
+    w.EndObject();
+
+    return sb.GetString();
+}
+
+/// @brief The old way: a DOM of the whole page, the items are read from it afterwards
+static void BM_page_dom(benchmark::State &state)
+{
+    const auto page = make_saved_tracks_page(state.range(0));
+
+    for (auto _: state)
+    {
+        std::vector<bench_track_t> items;
+        size_t total = 0;
+        string next;
+
+        json::Document doc;
+        doc.Parse(page);
+
+        const auto &body = doc;
+        const auto &page_items = body["items"];
+        items.resize(page_items.Size());
+        for (json::SizeType i = 0; i < page_items.Size(); ++i)
+            from_json(page_items[i], items[i]);
+
+        total = body["total"].GetUint();
+        next = body["next"].GetString();
+
+        benchmark::DoNotOptimize(items);
+        benchmark::DoNotOptimize(total);
+    }
+
+    state.SetBytesProcessed(state.iterations() * page.size());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// @brief The streaming reading: only one item at a time is materialized
+static void BM_page_sax(benchmark::State &state)
+{
+    const auto page = make_saved_tracks_page(state.range(0));
+
+    for (auto _: state)
+    {
+        std::vector<bench_track_t> items;
+        size_t total = 0;
+        string next;
+
+        json::read_page(page, "", items, total, next);
+
+        benchmark::DoNotOptimize(items);
+        benchmark::DoNotOptimize(total);
+    }
+
+    state.SetBytesProcessed(state.iterations() * page.size());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_page_dom)->Arg(20)->Arg(50);
+BENCHMARK(BM_page_sax)->Arg(20)->Arg(50);
+
+
+/// @brief The amount of the tracks in the big playlist, fetched by the pages of 50 of them
+static const size_t playlist_tracks_count = 10000, playlist_page_size = 50;
+
+/// @brief A local stand-in for the API server, answering every page of the playlist's
+/// tracks after some delay, the way the real server does it over the network
+class playlist_server
+{
+public:
+    playlist_server(): page(make_saved_tracks_page(playlist_page_size))
+    {
+        server.Get("/v1/playlists/bench/tracks", [this](const httplib::Request &, httplib::Response &res) {
+            std::this_thread::sleep_for(latency);
+            res.set_content(page, "application/json");
+        });
+
+        port = server.bind_to_any_port("127.0.0.1");
+        worker = std::thread([this] { server.listen_after_bind(); });
+        server.wait_until_ready();
+    }
+
+    ~playlist_server()
+    {
+        server.stop();
+        worker.join();
+    }
+
+    string get_host() const { return format("http://127.0.0.1:{}", port); }
+
+    std::chrono::milliseconds latency{ 40 };
+private:
+    httplib::Server server;
+    std::thread worker;
+    string page;
+    int port = 0;
+};
+
+/// @brief Requests and reads the page at the given offset the way the collection's requester does
+static auto get_playlist_page(clients_pool &clients, const string &host, size_t offset) -> std::vector<bench_track_t>
+{
+    auto client = clients.acquire(host);
+    auto res = client->Get(format("/v1/playlists/bench/tracks?limit={}&offset={}", playlist_page_size, offset));
+    if (!res || res->status != httplib::OK_200)
+        throw std::runtime_error("request failed");
+
+    std::vector<bench_track_t> items;
+    size_t total = 0;
+    string next;
+    json::read_page(res->body, "", items, total, next);
+    return items;
+}
+
+/// @brief Fetches the playlist with the same amount of the workers the api has and reports
+/// the time the first row is available to the panel and the time all of them are; the
+/// first page is requested alone, as the collection does it to get the total
+/// @param is_streamed the pages are published once they and all the previous ones are
+/// received, otherwise the rows are there only after all the pages are
+static void BM_playlist_first_row(benchmark::State &state)
+{
+    static playlist_server server;
+    static clients_pool clients(8, 60s);
+
+    const bool is_streamed = state.range(0) != 0;
+    const size_t pages_count = playlist_tracks_count / playlist_page_size;
+
+    double first_row_ms = 0, all_rows_ms = 0;
+    for (auto _: state)
+    {
+        BS::priority_thread_pool pool(5);
+
+        const auto started_at = std::chrono::steady_clock::now();
+        auto elapsed_ms = [&started_at]
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started_at).count();
+        };
+
+        std::vector<std::vector<bench_track_t>> pages(pages_count);
+        std::vector<bool> is_received(pages_count);
+        std::mutex guard;
+        size_t published = 0;
+        double first_row_at = 0;
+
+        auto on_page = [&](size_t idx, std::vector<bench_track_t> items)
+        {
+            std::lock_guard lock(guard);
+            pages[idx] = std::move(items);
+            is_received[idx] = true;
+
+            if (is_streamed)
+                for (; published < pages_count && is_received[published]; ++published)
+                    if (published == 0)
+                        first_row_at = elapsed_ms();
+        };
+
+        on_page(0, get_playlist_page(clients, server.get_host(), 0));
+
+        pool.submit_sequence((size_t)1, pages_count, [&](size_t idx)
+            {
+                on_page(idx, get_playlist_page(clients, server.get_host(), idx * playlist_page_size));
+            }).wait();
+
+        std::vector<bench_track_t> rows;
+        rows.reserve(playlist_tracks_count);
+        for (auto &page: pages)
+            rows.insert(rows.end(), std::make_move_iterator(page.begin()), std::make_move_iterator(page.end()));
+
+        all_rows_ms += elapsed_ms();
+        first_row_ms += is_streamed ? first_row_at : elapsed_ms();
+
+        benchmark::DoNotOptimize(rows.data());
+    }
+
+    state.SetLabel(is_streamed ? "streamed" : "waited");
+    state.counters["first_row_ms"] = first_row_ms / state.iterations();
+    state.counters["all_rows_ms"] = all_rows_ms / state.iterations();
+}
+
+BENCHMARK(BM_playlist_first_row)->Arg(0)->Arg(1)->Iterations(3)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+
+/// @brief A stand-in for the parsed `saved_track_t` with the counted strings, so copying it
+/// is reported the same way as the real one allocates: every string past the small-string
+/// buffer and every vector take an allocation
+struct counted_track_t
+{
+    counted_string id, added_at, url, album_id;
+    counted_wstring name, album_name;
+    counted_vector<counted_wstring> artists;
+    size_t duration_ms = 0;
+};
+
+/// @brief Builds the collection's pages, the way the requesters have them parsed
+static auto make_counted_pages(size_t items_count) -> std::vector<std::vector<counted_track_t>>
+{
+    std::vector<std::vector<counted_track_t>> pages((items_count + playlist_page_size - 1) / playlist_page_size);
+    for (size_t idx = 0; idx < items_count; ++idx)
+    {
+        auto id = format("{:022}", idx);
+        auto &t = pages[idx / playlist_page_size].emplace_back();
+
+        t.id.assign(id.begin(), id.end());
+        t.added_at = "2024-11-03T12:09:41Z";
+        t.url = "https://open.spotify.com/track/";
+        t.url.append(id.begin(), id.end());
+        t.album_id.assign(id.rbegin(), id.rend());
+        t.name = L"Some long enough track name";
+        t.album_name = L"Some long enough album name";
+        t.artists = { L"The first artist's name", L"The second artist's name" };
+        t.duration_ms = 215000 + idx;
+    }
+    return pages;
+}
+
+/// @brief Assembles a 10k items collection from its pages and reports the allocations
+/// it takes; the pages are the requesters' results, they are rebuilt every iteration
+/// @param is_moved the pages are moved out of the requesters and into the collection,
+/// otherwise they are copied into the pages' list and into the collection, as before
+static void BM_collection_assembly(benchmark::State &state)
+{
+    const bool is_moved = state.range(0) != 0;
+
+    size_t allocations = 0, bytes = 0;
+    for (auto _: state)
+    {
+        state.PauseTiming();
+        auto requesters = make_counted_pages(playlist_tracks_count);
+        state.ResumeTiming();
+
+        const auto allocations_before = allocations_count, bytes_before = allocated_bytes;
+        {
+            counted_vector<std::vector<counted_track_t>> result(requesters.size());
+            for (size_t idx = 0; idx < requesters.size(); ++idx)
+                if (is_moved)
+                    result[idx] = std::move(requesters[idx]);
+                else
+                    result[idx] = requesters[idx];
+
+            counted_vector<counted_track_t> collection;
+            collection.reserve(playlist_tracks_count);
+            for (auto &chunk: result)
+                if (is_moved)
+                    collection.insert(collection.end(), std::make_move_iterator(chunk.begin()),
+                        std::make_move_iterator(chunk.end()));
+                else
+                    collection.insert(collection.end(), chunk.begin(), chunk.end());
+
+            allocations = allocations_count - allocations_before;
+            bytes = allocated_bytes - bytes_before;
+
+            benchmark::DoNotOptimize(collection.data());
+        }
+
+        state.PauseTiming();
+        requesters.clear();
+        state.ResumeTiming();
+    }
+
+    state.SetLabel(is_moved ? "moved" : "copied");
+    state.counters["allocations"] = (double)allocations;
+    state.counters["allocated_mb"] = (double)bytes / (1024 * 1024);
+    state.SetItemsProcessed(state.iterations() * playlist_tracks_count);
+}
+
+BENCHMARK(BM_collection_assembly)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,162 @@
+#include <benchmark/benchmark.h>
+#include "spotify/transport.hpp"
+
+using namespace spotifar;
+using namespace spotifar::spotify;
+
+/// @brief A local stand-in for the API server, answering with a small json body. The server
+/// is started over TLS in case the certificate and the key are provided via environment
+/// variables SPOTIFAR_BENCH_CERT and SPOTIFAR_BENCH_KEY, otherwise it is a plain http one
+class stand_in_server
+{
+public:
+    stand_in_server()
+    {
+        const char *cert = std::getenv("SPOTIFAR_BENCH_CERT"), *key = std::getenv("SPOTIFAR_BENCH_KEY");
+
+        if (cert != nullptr && key != nullptr)
+        {
+            server = std::make_unique<httplib::SSLServer>(cert, key);
+            scheme = "https";
+        }
+        else
+        {
+            server = std::make_unique<httplib::Server>();
+            scheme = "http";
+        }
+
+        server->Get("/v1/me/player", [](const httplib::Request &, httplib::Response &res) {
+            res.set_content(R"({"is_playing":true,"progress_ms":1000})", "application/json");
+        });
+
+        // the several items endpoint answers after a network-like delay
+        server->Get("/v1/artists", [](const httplib::Request &req, httplib::Response &res) {
+            std::this_thread::sleep_for(40ms);
+            res.set_content(utils::format(R"({{"artists":[{{"id":"{}"}}]}})", req.get_param_value("ids")),
+                "application/json");
+        });
+
+        port = server->bind_to_any_port("127.0.0.1");
+        worker = std::thread([this] { server->listen_after_bind(); });
+        server->wait_until_ready();
+    }
+
+    ~stand_in_server()
+    {
+        server->stop();
+        worker.join();
+    }
+
+    string get_host() const { return utils::format("{}://127.0.0.1:{}", scheme, port); }
+private:
+    std::unique_ptr<httplib::Server> server;
+    std::thread worker;
+    string scheme;
+    int port = 0;
+};
+
+static void prepare_client(httplib::Client &client)
+{
+    client.enable_server_certificate_verification(false);
+}
+
+template<class F>
+static void run_requests(benchmark::State &state, F get_client)
+{
+    std::vector<double> latencies;
+
+    for (auto _: state)
+    {
+        auto started_at = std::chrono::steady_clock::now();
+
+        auto client = get_client();
+        auto res = client->Get("/v1/me/player");
+        if (!res || res->status != httplib::OK_200)
+            state.SkipWithError("request failed");
+
+        latencies.push_back(std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started_at).count());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty())
+        state.counters["p99_us"] = benchmark::Counter(
+            latencies[latencies.size() * 99 / 100], benchmark::Counter::kAvgThreads);
+
+    state.counters["requests/s"] = benchmark::Counter(
+        (double)state.iterations(), benchmark::Counter::kIsRate);
+}
+
+/// @brief The old behaviour: a new client and connection per each request
+static void BM_client_per_request(benchmark::State &state)
+{
+    static stand_in_server server;
+
+    run_requests(state, [] {
+        auto client = std::make_shared<httplib::Client>(server.get_host());
+        prepare_client(*client);
+        return client;
+    });
+}
+
+/// @brief Keep-alive clients leased from the pool
+static void BM_pooled_clients(benchmark::State &state)
+{
+    static stand_in_server server;
+    static clients_pool pool(8, 60s, prepare_client);
+
+    run_requests(state, [] { return pool.acquire(server.get_host()); });
+}
+
+BENCHMARK(BM_client_per_request)->UseRealTime()->Threads(1)->Threads(5);
+BENCHMARK(BM_pooled_clients)->UseRealTime()->Threads(1)->Threads(5);
+
+
+/// @brief The artists of a 250 entries playing history, the way the recent artists view
+/// requests them, by the chunks of 50 ids
+static const size_t recent_artists_count = 250, artists_chunk_size = 50;
+
+/// @brief Requests the chunks of the artists one by one, as before, or in parallel on
+/// a pool with the same amount of the workers the api has
+static void BM_several_items(benchmark::State &state)
+{
+    static stand_in_server server;
+    static clients_pool pool(8, 60s, prepare_client);
+
+    const bool is_parallel = state.range(0) != 0;
+    const size_t chunks_count = (recent_artists_count + artists_chunk_size - 1) / artists_chunk_size;
+
+    std::vector<string> ids;
+    for (size_t idx = 0; idx < recent_artists_count; ++idx)
+        ids.push_back(utils::format("{:022}", idx));
+
+    BS::priority_thread_pool requests_pool(5);
+
+    for (auto _: state)
+    {
+        std::vector<string> bodies(chunks_count);
+        auto request_chunk = [&](size_t idx)
+        {
+            auto first = ids.begin() + idx * artists_chunk_size;
+            auto last = ids.begin() + std::min(ids.size(), (idx + 1) * artists_chunk_size);
+
+            auto client = pool.acquire(server.get_host());
+            auto res = client->Get(httplib::append_query_params("/v1/artists", {
+                { "ids", utils::string_join(std::vector<string>(first, last), ",") } }));
+            if (res && res->status == httplib::OK_200)
+                bodies[idx] = res->body;
+        };
+
+        if (is_parallel)
+            requests_pool.submit_sequence((size_t)0, chunks_count, request_chunk).wait();
+        else
+            for (size_t idx = 0; idx < chunks_count; ++idx)
+                request_chunk(idx);
+
+        benchmark::DoNotOptimize(bodies.data());
+    }
+
+    state.SetLabel(is_parallel ? "parallel" : "serial");
+}
+
+BENCHMARK(BM_several_items)->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,90 @@
+#include <benchmark/benchmark.h>
+#include "utils.hpp"
+
+using namespace spotifar;
+using namespace spotifar::utils;
+
+/// @brief The names of the items of a typical library: mostly latin, some of them cyrillic
+/// or chinese, a few with emoji
+static auto get_names() -> const std::vector<string>&
+{
+    static const std::vector<string> names = []
+    {
+        std::vector<string> names;
+        for (size_t idx = 0; idx < 1000; ++idx)
+        {
+            if (idx % 10 == 7)
+                names.push_back(format("\xD0\x9A\xD0\xB8\xD0\xBD\xD0\xBE \xE2\x84\x96{}", idx));
+            else if (idx % 50 == 13)
+                names.push_back(format("\xE4\xB8\xAD\xE6\x96\x87\xE6\xAD\x8C {} \xF0\x9F\x98\x80", idx));
+            else
+                names.push_back(format("Some long enough track name #{} (Remastered)", idx));
+        }
+        return names;
+    }();
+    return names;
+}
+
+/// @brief The previous way, the system's conversion
+static void BM_utf8_decode_system(benchmark::State &state)
+{
+    const auto &names = get_names();
+
+    for (auto _: state)
+        for (const auto &s: names)
+        {
+            int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), NULL, 0);
+            wstring out(len, 0);
+            MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), &out[0], len);
+            benchmark::DoNotOptimize(out.data());
+        }
+
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+
+static void BM_utf8_decode(benchmark::State &state)
+{
+    const auto &names = get_names();
+
+    for (auto _: state)
+        for (const auto &s: names)
+            benchmark::DoNotOptimize(utf8_decode(s).data());
+
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+
+static void BM_utf8_encode_system(benchmark::State &state)
+{
+    std::vector<wstring> names;
+    for (const auto &s: get_names())
+        names.push_back(utf8_decode(s));
+
+    for (auto _: state)
+        for (const auto &ws: names)
+        {
+            int len = WideCharToMultiByte(CP_UTF8, 0, ws.c_str(), (int)ws.size(), NULL, 0, NULL, NULL);
+            string out(len, 0);
+            WideCharToMultiByte(CP_UTF8, 0, ws.c_str(), (int)ws.size(), &out[0], len, NULL, NULL);
+            benchmark::DoNotOptimize(out.data());
+        }
+
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+
+static void BM_utf8_encode(benchmark::State &state)
+{
+    std::vector<wstring> names;
+    for (const auto &s: get_names())
+        names.push_back(utf8_decode(s));
+
+    for (auto _: state)
+        for (const auto &ws: names)
+            benchmark::DoNotOptimize(utf8_encode(ws).data());
+
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+
+BENCHMARK(BM_utf8_decode_system);
+BENCHMARK(BM_utf8_decode);
+BENCHMARK(BM_utf8_encode_system);
+BENCHMARK(BM_utf8_encode);
@@ -0,0 +1,420 @@
+#include <gtest/gtest.h>
+#include "spotify/cache.hpp"
+
+using namespace spotifar;
+using namespace spotifar::spotify;
+
+static auto get_url(size_t idx) -> string
+{
+    return utils::format("/v1/albums/{:022}/tracks?limit=50&offset=0", idx);
+}
+
+TEST(http_cache, snapshot_is_immutable)
+{
+    http_cache cache;
+    cache.store(get_url(0), "first", "v1", 1h);
+
+    auto snapshot = cache.get(get_url(0));
+    ASSERT_NE(snapshot, nullptr);
+
+    cache.store(get_url(0), "second", "v2", 1h);
+    cache.invalidate(get_url(0));
+
+    EXPECT_EQ(snapshot->get_body(), "first");
+    EXPECT_EQ(snapshot->etag, "v1");
+    EXPECT_TRUE(snapshot->is_valid());
+
+    EXPECT_EQ(cache.get(get_url(0))->get_body(), "second");
+    EXPECT_EQ(cache.get_etag(get_url(0)), "v2");
+    EXPECT_FALSE(cache.is_valid(get_url(0)));
+
+    EXPECT_EQ(cache.get(get_url(1)), nullptr);
+    EXPECT_FALSE(cache.is_cached(get_url(1)));
+}
+
+TEST(http_cache, invalidates_by_url_prefix)
+{
+    http_cache cache;
+    for (const auto &url: { "/v1/me/tracks?offset=0", "/v1/me/tracks/contains?ids=1", "/v1/me/albums?offset=0" })
+        cache.store(url, "{}", "", 1h);
+
+    cache.invalidate("/v1/me/tracks?ids=1");
+    EXPECT_FALSE(cache.is_valid("/v1/me/tracks?offset=0"));
+    EXPECT_FALSE(cache.is_valid("/v1/me/tracks/contains?ids=1"));
+    EXPECT_TRUE(cache.is_valid("/v1/me/albums?offset=0"));
+
+    cache.invalidate("https://api.spotify.com/v1/me/albums?ids=1");
+    EXPECT_FALSE(cache.is_valid("/v1/me/albums?offset=0"));
+}
+
+TEST(http_cache, concurrent_access_stress)
+{
+    const size_t urls_count = 64, iterations = 20000;
+
+    http_cache cache;
+    std::atomic<size_t> inconsistent = 0, hits = 0;
+
+    // each body carries its url and version, which is duplicated in the etag, so
+    // a reader can check the entry it got is not a mix of the different versions
+    auto writer = [&](size_t seed)
+    {
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            auto url = get_url((seed + i * 7) % urls_count);
+            auto version = std::to_string(seed * iterations + i);
+
+            // the long bodies get compressed, the short ones are stored as is
+            auto body = utils::format("{}#{}", url, version);
+            if (i % 2)
+                body += string(1024, 'x');
+
+            cache.store(url, body, version, 1h);
+        }
+    };
+
+    auto reader = [&](size_t seed)
+    {
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            auto url = get_url((seed + i * 13) % urls_count);
+            if (!cache.is_cached(url))
+                continue;
+
+            if (auto entry = cache.get(url))
+            {
+                hits++;
+                if (!entry->get_body().starts_with(utils::format("{}#{}", url, entry->etag)))
+                    inconsistent++;
+            }
+        }
+    };
+
+    auto invalidator = [&]
+    {
+        for (size_t i = 0; i < iterations / 100; ++i)
+        {
+            cache.invalidate("/v1/albums/");
+            cache.prolong(get_url(i % urls_count), 1h);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 3; ++t)
+        threads.emplace_back(writer, t);
+    for (size_t t = 0; t < 5; ++t)
+        threads.emplace_back(reader, t);
+    threads.emplace_back(invalidator);
+
+    for (auto &t: threads)
+        t.join();
+
+    EXPECT_EQ(inconsistent, 0);
+    EXPECT_GT(hits, 0);
+
+    for (size_t idx = 0; idx < urls_count; ++idx)
+        EXPECT_TRUE(cache.is_cached(get_url(idx)));
+}
+
+TEST(http_cache, evicts_expired_then_least_recently_used)
+{
+    http_cache cache;
+    cache.set_limits(0, 1000);
+
+    auto store = [&cache](size_t idx, utils::clock_t::time_point cached_until)
+    {
+        cache.store(get_url(idx), http_cache::cache_entry{ "", string(300, 'a'), cached_until });
+    };
+
+    store(0, utils::clock_t::now() + 1h);
+    store(1, {}); // expired
+    store(2, utils::clock_t::now() + 1h);
+
+    // the expired one goes first, regardless of its recency
+    store(3, utils::clock_t::now() + 1h);
+    EXPECT_FALSE(cache.is_cached(get_url(1)));
+    EXPECT_TRUE(cache.is_cached(get_url(0)));
+    EXPECT_TRUE(cache.is_cached(get_url(2)));
+    EXPECT_TRUE(cache.is_cached(get_url(3)));
+
+    // the least recently used one goes next
+    cache.get(get_url(0));
+    store(4, utils::clock_t::now() + 1h);
+    EXPECT_FALSE(cache.is_cached(get_url(2)));
+    EXPECT_TRUE(cache.is_cached(get_url(0)));
+    EXPECT_TRUE(cache.is_cached(get_url(3)));
+    EXPECT_TRUE(cache.is_cached(get_url(4)));
+
+    auto stats = cache.get_stats();
+    EXPECT_EQ(stats.entries, 3);
+    EXPECT_EQ(stats.evicted, 2);
+    EXPECT_EQ(stats.evicted_size, 600);
+    EXPECT_LE(stats.memory_size, 1000);
+}
+
+TEST(objects_cache, goes_away_with_its_response)
+{
+    http_cache responses;
+    objects_cache objects(responses, 10);
+
+    auto parse = [&](size_t idx, int value, uint64_t version)
+    {
+        objects.put(get_url(idx), typeid(int), version, std::make_shared<const int>(value));
+    };
+
+    auto get = [&](size_t idx, std::type_index type = typeid(int)) -> int
+    {
+        auto object = objects.get(get_url(idx), type);
+        return object != nullptr ? *std::static_pointer_cast<const int>(object) : -1;
+    };
+
+    // there is no response to parse the object from
+    parse(0, 1, objects.get_version(get_url(0)));
+    EXPECT_EQ(get(0), -1);
+
+    // the response was replaced while the object was being parsed
+    responses.store(get_url(0), "1", "", 1h);
+    auto version = objects.get_version(get_url(0));
+    responses.store(get_url(0), "1", "", 1h);
+    parse(0, 1, version);
+    EXPECT_EQ(get(0), -1);
+
+    parse(0, 1, objects.get_version(get_url(0)));
+    EXPECT_EQ(get(0), 1);
+    EXPECT_EQ(get(0, typeid(string)), -1);
+
+    // the response stays the same, only its validity is prolonged
+    responses.prolong(get_url(0), 2h);
+    EXPECT_EQ(get(0), 1);
+
+    responses.store(get_url(0), "2", "", 1h);
+    EXPECT_EQ(get(0), -1);
+
+    parse(0, 2, objects.get_version(get_url(0)));
+    responses.invalidate(get_url(0));
+    EXPECT_EQ(get(0), -1);
+
+    // the least recently used ones are dropped above the capacity
+    for (size_t idx = 1; idx <= 11; ++idx)
+    {
+        responses.store(get_url(idx), std::to_string(idx), "", 1h);
+        parse(idx, (int)idx, objects.get_version(get_url(idx)));
+        get(1);
+    }
+    EXPECT_EQ(get(1), 1);
+    EXPECT_EQ(get(2), -1);
+    EXPECT_EQ(get(11), 11);
+    EXPECT_LE(objects.get_stats().objects, 10);
+
+    // the cursor pages are requested by their full urls, the responses are kept by the paths
+    const auto full_url = "https://api.spotify.com" + get_url(11);
+    EXPECT_EQ(objects.get_version(full_url), objects.get_version(get_url(11)));
+    EXPECT_EQ(*std::static_pointer_cast<const int>(objects.get(full_url, typeid(int))), 11);
+
+    objects.put(full_url, typeid(int), objects.get_version(full_url), std::make_shared<const int>(12));
+    EXPECT_EQ(get(11), 12);
+}
+
+TEST(collections_registry, shares_current_snapshots)
+{
+    http_cache responses;
+    collections_registry registry(responses, 1);
+
+    uint64_t version = 0;
+    auto find = [&](size_t idx, std::vector<string> *stale_urls = nullptr) -> int
+    {
+        auto snapshot = registry.find(get_url(idx), typeid(int), version, stale_urls);
+        return snapshot != nullptr ? *std::static_pointer_cast<const int>(snapshot) : -1;
+    };
+
+    auto get_source = [&](size_t idx) -> collections_registry::source_t
+    {
+        auto entry = responses.peek(get_url(idx));
+        return { get_url(idx), entry != nullptr ? entry->version : 0 };
+    };
+
+    // the snapshot made of the not cached pages is not shared
+    auto first = std::make_shared<const int>(1);
+    EXPECT_EQ(registry.publish(get_url(0), typeid(int), { get_source(0) }, first), 0);
+    EXPECT_EQ(find(0), -1);
+
+    responses.store(get_url(0), "page", "", 1h);
+    responses.store(get_url(1), "page", "", 1h);
+
+    auto first_version = registry.publish(get_url(0), typeid(int), { get_source(0), get_source(1) }, first);
+    EXPECT_NE(first_version, 0);
+    EXPECT_EQ(find(0), 1);
+    EXPECT_EQ(version, first_version);
+    EXPECT_EQ(registry.find(get_url(0), typeid(string), version), nullptr);
+
+    // any of the pages is changed, the snapshot is outdated
+    responses.store(get_url(1), "changed page", "", 1h);
+    EXPECT_EQ(find(0), -1);
+
+    auto second = std::make_shared<const int>(2);
+    auto second_version = registry.publish(get_url(0), typeid(int), { get_source(0), get_source(1) }, second);
+    EXPECT_GT(second_version, first_version);
+    EXPECT_EQ(find(0), 2);
+
+    // the expired pages of the same versions are served stale, if the caller allows it
+    std::vector<string> stale_urls;
+    responses.invalidate(get_url(1));
+    EXPECT_EQ(find(0), -1);
+    EXPECT_EQ(find(0, &stale_urls), 2);
+    EXPECT_EQ(version, second_version);
+    EXPECT_EQ(stale_urls, std::vector<string>{ get_url(1) });
+
+    // the snapshot is alive while it is held or retained as the recently used one
+    responses.store(get_url(2), "page", "", 1h);
+    registry.publish(get_url(2), typeid(int), { get_source(2) }, std::make_shared<const int>(3));
+    EXPECT_EQ(find(2), 3);
+
+    second.reset();
+    EXPECT_EQ(find(0, &stale_urls), -1);
+    EXPECT_EQ(registry.get_stats().snapshots, 1);
+}
+
+/// @brief Copies the file as it is on disk at the moment, like the process was killed
+static void copy_crashed_file(const std::filesystem::path &from, const std::filesystem::path &to)
+{
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+}
+
+TEST(cache_storage, recovers_after_crash)
+{
+    auto folder = std::filesystem::temp_directory_path() / "spotifar_tests";
+    std::filesystem::create_directories(folder);
+
+    auto filepath = folder / "responses.dat", crashed_filepath = folder / "responses.crashed.dat";
+    std::filesystem::remove(filepath);
+
+    const size_t checkpointed = 100, unindexed = 50;
+    auto cached_until = utils::clock_t::now() + 1h;
+    {
+        cache_storage storage;
+        ASSERT_TRUE(storage.open(filepath));
+
+        for (size_t idx = 0; idx < checkpointed + unindexed; ++idx)
+        {
+            storage.put(get_url(idx), std::to_string(idx), utils::format("body #{}", idx), cached_until, false);
+
+            if (idx + 1 == checkpointed)
+            {
+                auto offset = storage.append_index();
+                storage.sync();
+                ASSERT_TRUE(storage.commit_index(offset, storage.get_generation()));
+            }
+        }
+        storage.set_cached_until(get_url(0), {});
+
+        // the process is killed here, and the last record is written partially
+        copy_crashed_file(filepath, crashed_filepath);
+    }
+    {
+        std::ofstream out(crashed_filepath, std::ios::binary | std::ios::app);
+        out << "\x52\x43\x52\x44\x01\x00";
+    }
+
+    // nothing is lost, so nothing is to be requested from the server again
+    cache_storage storage;
+    ASSERT_TRUE(storage.open(crashed_filepath));
+    EXPECT_EQ(storage.get_stats().entries, checkpointed + unindexed);
+
+    for (size_t idx = 0; idx < checkpointed + unindexed; ++idx)
+    {
+        const auto *record = storage.find(get_url(idx));
+        ASSERT_NE(record, nullptr);
+        EXPECT_EQ(record->etag, std::to_string(idx));
+        EXPECT_EQ(storage.read_body(*record), utils::format("body #{}", idx));
+    }
+    EXPECT_EQ(storage.find(get_url(0))->cached_until, utils::clock_t::time_point{});
+}
+
+TEST(cache_storage, commits_index_of_same_generation)
+{
+    auto folder = std::filesystem::temp_directory_path() / "spotifar_tests";
+    std::filesystem::create_directories(folder);
+
+    auto filepath = folder / "responses.committed.dat";
+    std::filesystem::remove(filepath);
+
+    auto cached_until = utils::clock_t::now() + 1h;
+
+    cache_storage storage;
+    ASSERT_TRUE(storage.open(filepath));
+    storage.put(get_url(0), "", "body", cached_until, false);
+
+    // the file is started over while the index is being flushed, the same offset is
+    // taken by another index record then, which is not the appended one
+    const auto generation = storage.get_generation();
+    const auto offset = storage.append_index();
+    ASSERT_NE(offset, 0);
+
+    storage.clear();
+    storage.put(get_url(0), "", "body", cached_until, false);
+    ASSERT_EQ(storage.append_index(), offset);
+
+    EXPECT_FALSE(storage.commit_index(offset, generation));
+    EXPECT_TRUE(storage.commit_index(offset, storage.get_generation()));
+}
+
+TEST(cache_storage, compacts_while_being_written)
+{
+    auto folder = std::filesystem::temp_directory_path() / "spotifar_tests";
+    std::filesystem::create_directories(folder);
+
+    auto filepath = folder / "responses.compacted.dat";
+    std::filesystem::remove(filepath);
+
+    const size_t count = 100;
+    auto cached_until = utils::clock_t::now() + 1h;
+
+    cache_storage storage;
+    ASSERT_TRUE(storage.open(filepath));
+
+    // every response is overwritten once, so a half of the file is dead
+    for (size_t round = 0; round < 2; ++round)
+        for (size_t idx = 0; idx < count; ++idx)
+            storage.put(get_url(idx), std::to_string(round), utils::format("body #{}", idx), cached_until, false);
+
+    const auto file_size = storage.get_stats().file_size;
+
+    // the bodies are copied from the snapshot, while the storage is written
+    auto compaction = storage.begin_compaction();
+    ASSERT_TRUE(cache_storage::write_compaction(*compaction));
+
+    storage.put(get_url(0), "new", "the body stored meanwhile", cached_until, false);
+    storage.put(get_url(count), "added", "the response added meanwhile", cached_until, false);
+    storage.remove(get_url(1));
+    storage.set_cached_until(get_url(2), {});
+
+    ASSERT_TRUE(storage.finish_compaction(*compaction));
+
+    auto check_compacted = [&]
+    {
+        EXPECT_EQ(storage.get_stats().entries, count);
+        EXPECT_TRUE(storage.get_stats().file_size < file_size);
+
+        EXPECT_EQ(storage.read_body(*storage.find(get_url(0))), "the body stored meanwhile");
+        EXPECT_EQ(storage.read_body(*storage.find(get_url(count))), "the response added meanwhile");
+        EXPECT_EQ(storage.find(get_url(1)), nullptr);
+        EXPECT_EQ(storage.find(get_url(2))->cached_until, utils::clock_t::time_point{});
+        EXPECT_EQ(storage.read_body(*storage.find(get_url(3))), "body #3");
+        EXPECT_EQ(storage.find(get_url(3))->etag, "1");
+    };
+
+    // the compacted file is checked as is and after being reopened
+    check_compacted();
+    storage.close();
+    ASSERT_TRUE(storage.open(filepath));
+    check_compacted();
+
+    // the file started over meanwhile is not replaced with the stale copy
+    compaction = storage.begin_compaction();
+    ASSERT_TRUE(cache_storage::write_compaction(*compaction));
+    storage.clear();
+    EXPECT_FALSE(storage.finish_compaction(*compaction));
+    EXPECT_EQ(storage.get_stats().entries, 0);
+    EXPECT_FALSE(std::filesystem::exists(compaction->tmp_filepath));
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "spotify/columns.hpp"
+
+using namespace spotifar;
+using namespace spotifar::spotify;
+
+/// @brief A stand-in of the track with the same fields the columns are built from
+struct column_track_t
+{
+    struct artist_t { wstring name = L"Unknown"; };
+    struct album_t { wstring name; string release_date; };
+
+    wstring name;
+    int duration_ms = 0;
+    size_t popularity = 0;
+    std::vector<std::shared_ptr<const artist_t>> artists;
+    std::shared_ptr<const album_t> album;
+
+    auto get_artist() const -> artist_t { return artists.size() > 0 ? *artists[0] : artist_t{}; }
+};
+
+using columns_t = tracks_columns_t<column_track_t>;
+
+static auto make_tracks() -> std::vector<column_track_t>
+{
+    auto artist1 = std::make_shared<const column_track_t::artist_t>(L"Beta");
+    auto artist2 = std::make_shared<const column_track_t::artist_t>(L"Alpha");
+    auto album1 = std::make_shared<const column_track_t::album_t>(L"Zeta", "1999-01-01");
+    auto album2 = std::make_shared<const column_track_t::album_t>(L"Eta", "2011-06-15");
+    auto album3 = std::make_shared<const column_track_t::album_t>(L"Zeta", "");
+
+    return {
+        { L"b", 200, 10, { artist1 }, album1 },
+        { L"a", 100, 30, { artist2 }, album2 },
+        { L"c", 300, 20, {}, album3 },
+        { L"a", 150, 30, { artist1 }, album1 },
+    };
+}
+
+static int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+TEST(tracks_columns, compares_as_fields)
+{
+    const auto tracks = make_tracks();
+
+    std::vector<const column_track_t*> rows;
+    for (const auto &t: tracks)
+        rows.push_back(&t);
+
+    columns_t columns(rows);
+
+    auto compare_fields = [](columns_t::column_t column, const column_track_t &t1, const column_track_t &t2)
+    {
+        switch (column)
+        {
+            case columns_t::artist: return t1.get_artist().name.compare(t2.get_artist().name);
+            case columns_t::album: return t1.album->name.compare(t2.album->name);
+            case columns_t::release_date: return t1.album->release_date.compare(t2.album->release_date);
+            case columns_t::duration: return t1.duration_ms - t2.duration_ms;
+            default: return (int)t1.popularity - (int)t2.popularity;
+        }
+    };
+
+    for (int column = 0; column < columns_t::columns_count; ++column)
+        for (const auto &t1: tracks)
+            for (const auto &t2: tracks)
+                EXPECT_EQ(columns.compare((columns_t::column_t)column, &t1, &t2),
+                    sign(compare_fields((columns_t::column_t)column, t1, t2))) << column;
+}
+
+TEST(tracks_columns, finds_rows)
+{
+    const auto tracks = make_tracks();
+    const column_track_t stranger;
+
+    // the contiguous list is indexed by the offsets
+    columns_t contiguous({ &tracks[0], &tracks[1], &tracks[2], &tracks[3] });
+    for (size_t row = 0; row < tracks.size(); ++row)
+        EXPECT_EQ(contiguous.find_row(&tracks[row]), row);
+
+    EXPECT_EQ(contiguous.find_row(&stranger), columns_t::npos);
+    EXPECT_EQ(contiguous.find_row((const column_track_t*)((const char*)&tracks[1] + 8)), columns_t::npos);
+    EXPECT_EQ(contiguous.compare(columns_t::artist, &stranger, &tracks[0]), -2);
+
+    // the shuffled one by the map
+    columns_t shuffled({ &tracks[2], &tracks[0], &tracks[3], &tracks[1] });
+    EXPECT_EQ(shuffled.find_row(&tracks[2]), 0);
+    EXPECT_EQ(shuffled.find_row(&tracks[1]), 3);
+    EXPECT_EQ(shuffled.find_row(&stranger), columns_t::npos);
+}
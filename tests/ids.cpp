@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "spotify/ids.hpp"
+
+using namespace spotifar;
+using namespace spotifar::spotify;
+
+TEST(spotify_id, roundtrip)
+{
+    for (const auto &id: { "6rqhFgbbKwnb9MLmUQDhG6", "0000000000000000000001", "7n42HYzqZTpyNeSMWxNDTq",
+        "4iV5W9uYEdYUVa79Axb7Rh", "0TnOYISbd1XYRBk9myaseg" })
+    {
+        const auto parsed = spotify_id_t::parse(id);
+
+        ASSERT_TRUE(parsed.has_value()) << id;
+        EXPECT_EQ(parsed->to_string(), id);
+        EXPECT_EQ(*parsed, spotify_id_t(id));
+    }
+
+    EXPECT_NE(spotify_id_t("6rqhFgbbKwnb9MLmUQDhG6"), spotify_id_t("6rqhFgbbKwnb9MLmUQDhG7"));
+}
+
+TEST(spotify_id, invalid)
+{
+    // too short or long, not base62, does not fit 128 bits, the devices' ids
+    for (const auto &id: { "", "6rqhFgbbKwnb9MLmUQDhG", "6rqhFgbbKwnb9MLmUQDhG66", "6rqhFgbbKwnb9MLmUQDh_6",
+        "zzzzzzzzzzzzzzzzzzzzzz", "ed01a3ca8def0a1772eab7be6c4b0bb37b06163e" })
+    {
+        EXPECT_FALSE(spotify_id_t::parse(id).has_value()) << id;
+        EXPECT_FALSE(spotify_id_t(id).is_valid()) << id;
+    }
+
+    EXPECT_EQ(spotify_id_t().to_string(), "");
+}
+
+TEST(spotify_id, hash)
+{
+    // the sequential ids differ in the lowest digit only, all of them must be spread
+    std::unordered_set<size_t> hashes;
+    std::unordered_set<size_t> buckets;
+    for (size_t idx = 1; idx <= 1000; ++idx)
+    {
+        const auto id = spotify_id_t(utils::format("{:022}", idx));
+        hashes.insert(std::hash<spotify_id_t>{}(id));
+        buckets.insert(std::hash<spotify_id_t>{}(id) % 1024);
+    }
+
+    EXPECT_EQ(hashes.size(), 1000);
+    EXPECT_GT(buckets.size(), 550);
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include "spotify/transport.hpp"
+
+using namespace spotifar;
+using namespace spotifar::spotify;
+
+/// @brief A local mock of the API server, which enforces a quota of requests
+/// per one second window and responds with 429 and `retry-after` above it
+class quota_server
+{
+public:
+    quota_server(size_t quota): quota(quota)
+    {
+        server.Get("/v1/me/player", [this](const httplib::Request &, httplib::Response &res)
+        {
+            std::lock_guard lock(guard);
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - window_start >= 1s)
+            {
+                window_start = now;
+                window_requests = 0;
+            }
+
+            if (++window_requests > this->quota)
+            {
+                throttled++;
+                res.status = httplib::TooManyRequests_429;
+                res.set_header("retry-after", "1");
+                return;
+            }
+            res.set_content("{}", "application/json");
+        });
+
+        port = server.bind_to_any_port("127.0.0.1");
+        worker = std::thread([this] { server.listen_after_bind(); });
+        server.wait_until_ready();
+    }
+
+    ~quota_server()
+    {
+        server.stop();
+        worker.join();
+    }
+
+    auto get_host() const -> string { return utils::format("http://127.0.0.1:{}", port); }
+    auto get_throttled() -> size_t { std::lock_guard lock(guard); return throttled; }
+private:
+    httplib::Server server;
+    std::thread worker;
+    int port = 0;
+
+    std::mutex guard;
+    size_t quota;
+    size_t window_requests = 0, throttled = 0;
+    std::chrono::steady_clock::time_point window_start = std::chrono::steady_clock::now();
+};
+
+TEST(token_bucket, gives_burst_then_paces)
+{
+    token_bucket bucket({ .rate = 10., .capacity = 3., .min_rate = 1., .max_rate = 10. });
+
+    utils::clock_t::duration wait_for{};
+    for (int i = 0; i < 3; ++i)
+        EXPECT_TRUE(bucket.try_acquire(wait_for));
+
+    EXPECT_FALSE(bucket.try_acquire(wait_for));
+    EXPECT_GT(wait_for, utils::clock_t::duration::zero());
+    EXPECT_LE(wait_for, 100ms);
+    EXPECT_TRUE(bucket.is_exhausted());
+}
+
+TEST(token_bucket, adapts_rate)
+{
+    token_bucket bucket({ .rate = 8., .capacity = 1., .min_rate = 1., .max_rate = 9., .increase_step = 0.5 });
+
+    bucket.on_throttled(200ms);
+    EXPECT_DOUBLE_EQ(bucket.get_state().rate, 4.);
+    EXPECT_TRUE(bucket.is_exhausted());
+
+    utils::clock_t::duration wait_for{};
+    EXPECT_FALSE(bucket.try_acquire(wait_for));
+    EXPECT_GT(wait_for, 100ms);
+
+    for (int i = 0; i < 100; ++i)
+        bucket.on_success();
+    EXPECT_DOUBLE_EQ(bucket.get_state().rate, 9.);
+
+    for (int i = 0; i < 100; ++i)
+        bucket.on_throttled({});
+    EXPECT_DOUBLE_EQ(bucket.get_state().rate, 1.);
+}
+
+TEST(token_bucket, reserves_budget_for_user_requests)
+{
+    token_bucket bucket({ .rate = .01, .capacity = 4., .min_rate = .01, .max_rate = .01, .reserve = 2. });
+
+    utils::clock_t::duration wait_for{};
+    EXPECT_TRUE(bucket.try_acquire(wait_for, request_priority::background));
+    EXPECT_TRUE(bucket.try_acquire(wait_for, request_priority::background));
+    EXPECT_FALSE(bucket.try_acquire(wait_for, request_priority::background));
+
+    EXPECT_TRUE(bucket.try_acquire(wait_for, request_priority::interactive));
+    EXPECT_TRUE(bucket.try_acquire(wait_for, request_priority::playback));
+    EXPECT_FALSE(bucket.try_acquire(wait_for, request_priority::playback));
+}
+
+TEST(token_bucket, serves_higher_priority_first)
+{
+    token_bucket bucket({ .rate = 20., .capacity = 1., .min_rate = 20., .max_rate = 20. });
+
+    utils::clock_t::duration wait_for{};
+    ASSERT_TRUE(bucket.try_acquire(wait_for));
+
+    // a playback command is waiting for the next token, so the interactive
+    // request cannot take it even when it is refilled
+    std::atomic<bool> is_served = false;
+    std::thread waiter([&] {
+        is_served = bucket.acquire(nullptr, request_priority::playback);
+    });
+
+    std::this_thread::sleep_for(10ms);
+    while (!is_served)
+        if (bucket.try_acquire(wait_for, request_priority::interactive))
+        {
+            ADD_FAILURE() << "the token was given to a lower priority requester";
+            break;
+        }
+
+    waiter.join();
+    EXPECT_TRUE(is_served);
+}
+
+TEST(token_bucket, unpaced_requests_are_throttled)
+{
+    quota_server server(10);
+    httplib::Client client(server.get_host());
+
+    for (int i = 0; i < 20; ++i)
+        client.Get("/v1/me/player");
+
+    EXPECT_GT(server.get_throttled(), 0);
+}
+
+TEST(token_bucket, paced_requests_stay_within_quota)
+{
+    // the quota leaves some room for the fixed window boundaries jitter
+    quota_server server(12);
+    httplib::Client client(server.get_host());
+    token_bucket bucket({ .rate = 8., .capacity = 2., .min_rate = 1., .max_rate = 8. });
+
+    for (int i = 0; i < 20; ++i)
+    {
+        ASSERT_TRUE(bucket.acquire(nullptr));
+
+        if (auto res = client.Get("/v1/me/player"); res && res->status == httplib::TooManyRequests_429)
+            bucket.on_throttled(1s);
+        else
+            bucket.on_success();
+    }
+
+    EXPECT_EQ(server.get_throttled(), 0);
+}
@@ -13,6 +13,33 @@ TEST(utils, utf8_decode)
     EXPECT_EQ(result_wstr, expected_wstr);
 }
 
+TEST(utils, utf8_roundtrip)
+{
+    // the lengths around the vectorised blocks' boundaries, with the multi-byte sequences
+    // in the middle and at the very end of the blocks
+    const std::vector<std::pair<string, wstring>> samples = {
+        { "", L"" },
+        { "Track name", L"Track name" },
+        { "0123456789abcdef", L"0123456789abcdef" },
+        { "0123456789abcdef0", L"0123456789abcdef0" },
+        { "0123456789abcde\xC3\xA9", L"0123456789abcde\u00E9" },
+        { "\xD0\x9A\xD0\xB8\xD0\xBD\xD0\xBE: some long enough ascii tail",
+            L"\u041A\u0438\u043D\u043E: some long enough ascii tail" },
+        { "Some long enough ascii head \xE4\xB8\xAD\xE6\x96\x87", L"Some long enough ascii head \u4E2D\u6587" },
+        { "smile \xF0\x9F\x98\x80 and 0123456789abcdef", L"smile \U0001F600 and 0123456789abcdef" },
+    };
+
+    for (const auto &[utf8, utf16]: samples)
+    {
+        EXPECT_EQ(utils::utf8_decode(utf8), utf16);
+        EXPECT_EQ(utils::utf8_encode(utf16), utf8);
+    }
+
+    // the invalid input is replaced the way the system does it
+    EXPECT_EQ(utils::utf8_decode("0123456789abcdef\xC3("), L"0123456789abcdef\uFFFD(");
+    EXPECT_EQ(utils::utf8_encode(wstring(L"ab") + (wchar_t)0xD800), "ab\xEF\xBF\xBD");
+}
+
 TEST(utils, strip_invalid_filename_chars)
 {
     wstring filename = L"Invalid:Filename*?\\/<>|";
@@ -21,4 +48,146 @@ TEST(utils, strip_invalid_filename_chars)
     wstring result_stripped = spotifar::utils::strip_invalid_filename_chars(filename);
     
     EXPECT_EQ(result_stripped, expected_stripped);
-}
\ No newline at end of file
+}
+
+TEST(utils, page_reader)
+{
+    string page = R"({"artists": {
+        "href": "https://api.spotify.com/v1/me/following",
+        "items": [{"id": "1", "genres": ["rock"], "images": [{"w": 64}]}, null, {"id": "3", "genres": []}],
+        "next": "https://api.spotify.com/v1/me/following?after=3",
+        "cursors": {"after": "3", "total": 100},
+        "total": 42
+    }})";
+
+    std::vector<string> ids;
+    utils::json::page_reader reader;
+    reader.read(page, "artists", [&ids](const utils::json::Value &item)
+    {
+        ids.push_back(item.IsNull() ? "null" : item["id"].GetString());
+    });
+
+    EXPECT_EQ(ids, std::vector<string>({ "1", "null", "3" }));
+    EXPECT_EQ(reader.get_total(), 42);
+    EXPECT_EQ(reader.get_next(), "https://api.spotify.com/v1/me/following?after=3");
+
+    // the total only is read past the items, the nested totals are not taken for it
+    utils::json::page_reader total_reader;
+    total_reader.read_total(page, "artists");
+    EXPECT_EQ(total_reader.get_total(), 42);
+
+    EXPECT_THROW(total_reader.read_total(R"({"items": [{"id": "1"}, {"id": )", ""), std::runtime_error);
+
+    EXPECT_THROW(reader.read(R"({"items": [{"id": "1"}, {"id": )", "", [](const auto&) {}),
+        std::runtime_error);
+}
+
+TEST(utils, page_reader_reports_next)
+{
+    // the cursor-paged responses have the `next` url ahead of the items
+    string page = R"({"artists": {
+        "next": "https://api.spotify.com/v1/me/following?after=2",
+        "cursors": {"after": "2"},
+        "items": [{"id": "1"}, {"id": "2"}],
+        "total": 2
+    }})";
+
+    std::vector<string> events;
+    utils::json::page_reader reader;
+    reader.read(page, "artists",
+        [&events](const utils::json::Value &item) { events.push_back(item["id"].GetString()); },
+        [&events](const string &next) { events.push_back(next); });
+
+    EXPECT_EQ(events, std::vector<string>({ "https://api.spotify.com/v1/me/following?after=2", "1", "2" }));
+
+    // the last page has no next url to report
+    events.clear();
+    reader.read(R"({"items": [{"id": "1"}], "next": null})", "",
+        [&events](const utils::json::Value &item) { events.push_back(item["id"].GetString()); },
+        [&events](const string &next) { events.push_back(next); });
+
+    EXPECT_EQ(events, std::vector<string>({ "1" }));
+}
+
+TEST(utils, gzip_roundtrip)
+{
+    string data;
+    for (int i = 0; i < 1000; ++i)
+        data += utils::format(R"({{"id":"{}","name":"Track name #{}"}},)", i, i);
+
+    auto compressed = utils::gzip_compress(data);
+
+    EXPECT_LT(compressed.size(), data.size());
+    EXPECT_EQ(utils::gzip_decompress(compressed), data);
+    EXPECT_THROW(utils::gzip_decompress(compressed.substr(0, compressed.size() / 2)), std::runtime_error);
+}
+
+/// @brief A small item exercising all the kinds of the schema descriptors
+struct schema_item_t
+{
+    string id;
+    wstring name;
+    size_t total = 0;
+    int duration_ms = 0;
+    int duration = 0;
+    std::vector<string> genres;
+    bool is_playable = true;
+    string owner = "nobody";
+};
+
+static constexpr auto schema_item_fields = std::tuple{
+    utils::json::schema::field("id", &schema_item_t::id),
+    utils::json::schema::field("name", &schema_item_t::name),
+    utils::json::schema::field("duration_ms", &schema_item_t::duration_ms),
+    utils::json::schema::field("genres", &schema_item_t::genres, utils::json::schema::optional),
+    utils::json::schema::object("tracks", std::tuple{
+        utils::json::schema::field("total", &schema_item_t::total),
+    }),
+    utils::json::schema::object("restrictions", std::tuple{
+        utils::json::schema::flag("playing", &schema_item_t::is_playable),
+    }, utils::json::schema::optional),
+    utils::json::schema::field("owner", &schema_item_t::owner, utils::json::schema::nullable),
+    utils::json::schema::then(+[](schema_item_t &i) { i.duration = i.duration_ms / 1000; }),
+};
+
+TEST(utils, json_schema)
+{
+    namespace json = utils::json;
+
+    json::Document doc;
+    doc.Parse(R"({"href": "skipped", "id": "1", "name": "Name", "duration_ms": 61000,
+        "tracks": {"href": "skipped", "total": 12}, "owner": null,
+        "restrictions": {"playing": true}})");
+
+    schema_item_t item;
+    item.genres = { "rock" };
+    json::schema::read(doc, item, schema_item_fields);
+
+    EXPECT_EQ(item.id, "1");
+    EXPECT_EQ(item.name, L"Name");
+    EXPECT_EQ(item.total, 12);
+    EXPECT_EQ(item.duration, 61);
+    EXPECT_TRUE(item.genres.empty()); // absent optional fields are reset
+    EXPECT_TRUE(item.owner.empty()); // null ones as well
+    EXPECT_FALSE(item.is_playable);
+
+    // the written object is read back into the same item
+    json::Document written;
+    json::schema::write(written, item, schema_item_fields, written.GetAllocator());
+
+    schema_item_t read_back;
+    json::schema::read(written, read_back, schema_item_fields);
+
+    EXPECT_EQ(read_back.id, item.id);
+    EXPECT_EQ(read_back.name, item.name);
+    EXPECT_EQ(read_back.total, item.total);
+    EXPECT_EQ(read_back.duration, item.duration);
+    EXPECT_EQ(read_back.is_playable, item.is_playable);
+
+    // the required members must be there, the nested ones as well
+    doc.Parse(R"({"id": "1", "name": "Name", "duration_ms": 0, "owner": "me"})");
+    EXPECT_THROW(json::schema::read(doc, item, schema_item_fields), std::runtime_error);
+
+    doc.Parse(R"({"id": "1", "name": "Name", "duration_ms": 0, "owner": "me", "tracks": {}})");
+    EXPECT_THROW(json::schema::read(doc, item, schema_item_fields), std::runtime_error);
+}